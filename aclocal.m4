@@ -287,6 +287,193 @@ AC_DEFUN([OD_OPENLDAP],[
 	AC_SUBST([LDAP_LIBS])
 ])
 
+#------------------------------------------------------------------------
+# TR_LDAP_SYNC --
+#
+#	Check for the OpenLDAP RFC 4533 content synchronization
+#	(syncrepl) client API
+#
+# Arguments:
+#	None.
+#
+# Requires:
+#	OD_OPENLDAP
+#
+# Depends:
+#	none
+#
+# Results:
+#
+#	Result is cached.
+#
+#	Defines the following preprocessor macros:
+#		HAVE_LDAP_SYNC
+#------------------------------------------------------------------------
+AC_DEFUN([TR_LDAP_SYNC],[
+	AC_REQUIRE([OD_OPENLDAP])
+
+	OLD_LIBS="${LIBS}"
+	OLD_CFLAGS="${CFLAGS}"
+
+	LIBS="${LIBS} ${LDAP_LIBS}"
+	CFLAGS="${CFLAGS} ${LDAP_CFLAGS}"
+
+	AC_MSG_CHECKING([for ldap_sync])
+	AC_CACHE_VAL(tr_cv_ldap_sync, [
+		AC_LINK_IFELSE([
+				AC_LANG_PROGRAM([
+						#include <ldap.h>
+						#include <ldap_sync.h>
+					], [
+						ldap_sync_t ls;
+						ldap_sync_initialize(&ls);
+						ldap_sync_poll(&ls);
+					])
+				], [
+					tr_cv_ldap_sync="yes"
+				], [
+					tr_cv_ldap_sync="no"
+				]
+		)
+	])
+	AC_MSG_RESULT(${tr_cv_ldap_sync})
+
+	if test x"${tr_cv_ldap_sync}" = x"no"; then
+		AC_MSG_WARN([syncrepl support will not be included.])
+	else
+		AC_DEFINE([HAVE_LDAP_SYNC], [1], [Define to enable syncrepl cache invalidation.])
+	fi
+
+	LIBS="${OLD_LIBS}"
+	CFLAGS="${OLD_CFLAGS}"
+])
+
+#------------------------------------------------------------------------
+# TR_LDAP_TLS_RESUMPTION --
+#
+#	Check whether TLS sessions may be resumed across LDAP
+#	connections, which requires libldap's TLS connect callback
+#	and OpenSSL client session caching
+#
+# Arguments:
+#	None.
+#
+# Requires:
+#	OD_OPENLDAP TR_OPENSSL
+#
+# Depends:
+#	none
+#
+# Results:
+#
+#	Result is cached.
+#
+#	Defines the following preprocessor macros:
+#		HAVE_LDAP_TLS_RESUMPTION
+#------------------------------------------------------------------------
+AC_DEFUN([TR_LDAP_TLS_RESUMPTION],[
+	AC_REQUIRE([OD_OPENLDAP])
+	AC_REQUIRE([TR_OPENSSL])
+
+	OLD_LIBS="${LIBS}"
+	OLD_CFLAGS="${CFLAGS}"
+
+	LIBS="${LIBS} ${LDAP_LIBS} ${OPENSSL_LIBS}"
+	CFLAGS="${CFLAGS} ${LDAP_CFLAGS} ${OPENSSL_CFLAGS}"
+
+	AC_MSG_CHECKING([for LDAP TLS session resumption support])
+	AC_CACHE_VAL(tr_cv_ldap_tls_resumption, [
+		AC_LINK_IFELSE([
+				AC_LANG_PROGRAM([
+						#include <ldap.h>
+						#include <openssl/ssl.h>
+					], [
+						int opt = LDAP_OPT_X_TLS_CONNECT_CB;
+						SSL_SESSION *session = SSL_get1_session(NULL);
+						SSL_set_session(NULL, session);
+						SSL_session_reused(NULL);
+						SSL_SESSION_is_resumable(session);
+						SSL_SESSION_up_ref(session);
+					])
+				], [
+					tr_cv_ldap_tls_resumption="yes"
+				], [
+					tr_cv_ldap_tls_resumption="no"
+				]
+		)
+	])
+	AC_MSG_RESULT(${tr_cv_ldap_tls_resumption})
+
+	if test x"${tr_cv_ldap_tls_resumption}" = x"no"; then
+		AC_MSG_WARN([TLS session resumption will not be supported.])
+	else
+		AC_DEFINE([HAVE_LDAP_TLS_RESUMPTION], [1], [Define to enable LDAP TLS session resumption.])
+	fi
+
+	LIBS="${OLD_LIBS}"
+	CFLAGS="${OLD_CFLAGS}"
+])
+
+#------------------------------------------------------------------------
+# TR_LDAP_PAGED_RESULTS --
+#
+#	Check for libldap support for the RFC 2696 simple paged
+#	results control
+#
+# Arguments:
+#	None.
+#
+# Requires:
+#	OD_OPENLDAP
+#
+# Depends:
+#	none
+#
+# Results:
+#
+#	Result is cached.
+#
+#	Defines the following preprocessor macros:
+#		HAVE_LDAP_PAGED_RESULTS
+#------------------------------------------------------------------------
+AC_DEFUN([TR_LDAP_PAGED_RESULTS],[
+	AC_REQUIRE([OD_OPENLDAP])
+
+	OLD_LIBS="${LIBS}"
+	OLD_CFLAGS="${CFLAGS}"
+
+	LIBS="${LIBS} ${LDAP_LIBS}"
+	CFLAGS="${CFLAGS} ${LDAP_CFLAGS}"
+
+	AC_MSG_CHECKING([for LDAP paged results support])
+	AC_CACHE_VAL(tr_cv_ldap_paged_results, [
+		AC_LINK_IFELSE([
+				AC_LANG_PROGRAM([
+						#include <ldap.h>
+					], [
+						LDAPControl *ctrl = ldap_control_find(LDAP_CONTROL_PAGEDRESULTS, NULL, NULL);
+						ldap_create_page_control(NULL, 0, NULL, 0, &ctrl);
+						ldap_parse_pageresponse_control(NULL, ctrl, NULL, NULL);
+					])
+				], [
+					tr_cv_ldap_paged_results="yes"
+				], [
+					tr_cv_ldap_paged_results="no"
+				]
+		)
+	])
+	AC_MSG_RESULT(${tr_cv_ldap_paged_results})
+
+	if test x"${tr_cv_ldap_paged_results}" = x"no"; then
+		AC_MSG_WARN([Paged LDAP searches will not be supported.])
+	else
+		AC_DEFINE([HAVE_LDAP_PAGED_RESULTS], [1], [Define to enable paged LDAP searches.])
+	fi
+
+	LIBS="${OLD_LIBS}"
+	CFLAGS="${OLD_CFLAGS}"
+])
+
 #------------------------------------------------------------------------
 # OD_OPENVPN_HEADER --
 #
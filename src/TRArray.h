@@ -37,14 +37,18 @@
 
 @interface TRArray : TRObject {
 @private
+    /* Objects, in the order they were added */
+    id *_objects;
     unsigned int _count;
-    struct _TRArrayStack *_stack;
-    struct _TRArrayStack *_stackBottom;
+    unsigned int _capacity;
 }
 
+- (id) initWithCapacity: (unsigned int) capacity;
+- (void) reserveCapacity: (unsigned int) capacity;
 - (void) addObject: (id) anObject;
 - (void) removeObject;
 - (id) lastObject;
+- (id) objectAtIndex: (unsigned int) index;
 - (BOOL) containsObject: (id) anObject;
 - (TREnumerator *) objectEnumerator;
 - (TREnumerator *) objectReverseEnumerator;
@@ -37,18 +37,15 @@
 #import "TRArray.h"
 #import "xmalloc.h"
 
-typedef struct _TRArrayStack {
-    id object;
-    struct _TRArrayStack *prev;
-    struct _TRArrayStack *next;
-} TRArrayStack;
+/* Initial capacity of an array, allocated when the first object is added */
+#define TRARRAY_MIN_CAPACITY 4
 
 /**
  * Array enumerator.
  */
 @interface TRArrayObjectEnumerator : TREnumerator {
     TRArray *_array;
-    TRArrayStack *_stack;
+    unsigned int _index;
 }
 - (id) initWithArray: (TRArray *) array;
 @end
@@ -59,47 +56,36 @@ typedef struct _TRArrayStack {
 @interface TRArrayReverseObjectEnumerator : TRArrayObjectEnumerator
 @end
 
-/*
- * We need to declare prototypes for our private methods, as some
- * versions of gcc won't pick them up from the implementation.
- */
-@interface TRArray (TRArrayPrivate)
-- (TRArrayStack *) _privateArrayContext: (BOOL) top;
-@end
-
 /**
  * A simple array implementation, provides forward and reverse
- * enumerators.
+ * enumerators. Objects are stored contiguously, in a buffer that
+ * grows geometrically.
  */
 @implementation TRArray
 
-- (id) init {
-    self = [super init];
+/**
+ * Initialize an array with room for capacity objects.
+ */
+- (id) initWithCapacity: (unsigned int) capacity {
+    self = [self init];
     if (!self)
         return self;
 
-    _count = 0;
-
-    /* Initialize our linked list */
-    _stack = xmalloc(sizeof(TRArrayStack));
-    _stack->object= nil;
-    _stack->next = NULL;
-    _stack->prev= NULL;
-    _stackBottom = _stack;
+    [self reserveCapacity: capacity];
 
     return self;
 }
 
 - (void) dealloc {
-    TRArrayStack *node;
-
-    /* Clean up our stack */
-    for (node = _stack; _stack; node = _stack) {
-        /* Release the associated object */
-        [node->object release];
-        _stack = node->next;
-        free(node);
-    }
+    unsigned int i;
+
+    /* Release all objects */
+    for (i = 0; i < _count; i++)
+        [_objects[i] release];
+
+    if (_objects)
+        free(_objects);
+
     [super dealloc];
 }
 
@@ -107,48 +93,61 @@ typedef struct _TRArrayStack {
     return _count;
 }
 
+/**
+ * Ensure the array can hold at least capacity objects
+ * without further allocation.
+ */
+- (void) reserveCapacity: (unsigned int) capacity {
+    if (capacity <= _capacity)
+        return;
+
+    _objects = xrealloc(_objects, sizeof(id) * capacity);
+    _capacity = capacity;
+}
+
 /**
  * Add anObject to the array.
  * @param anObject: Object to add;
  */
 - (void) addObject: (id) anObject {
-    TRArrayStack *node;
+    /* Double the capacity when full */
+    if (_count == _capacity)
+        [self reserveCapacity: _capacity ? _capacity * 2 : TRARRAY_MIN_CAPACITY];
 
-    /* Allocate, initialize, and push the new node on to the stack */
-    node = xmalloc(sizeof(TRArrayStack));
-    node->object = [anObject retain];
-    node->prev = NULL;
-    node->next = _stack;
-    _stack->prev = node;
-
-    _stack = node;
-    _count++;
+    _objects[_count++] = [anObject retain];
 }
 
 /**
  * Remove top-most object from the array (LIFO).
  */
 - (void) removeObject {
-    TRArrayStack *node;
-
-    /* Pop the stack */
-    node = _stack;
-    _stack = _stack->next;
-    _stack->prev = NULL;
+    if (_count == 0)
+        return;
 
-    /* Dealloc the removed node */
-    [node->object release];
-    free(node);
     _count--;
+    [_objects[_count] release];
 }
 
 /**
  * Return the last object added to the array.
- * @return Last object added to the array.
+ * @return Last object added to the array, or nil if the array is empty.
  */
 - (id) lastObject {
-    /* Return the last object on the stack */
-    return _stack->object;
+    if (_count == 0)
+        return nil;
+
+    return _objects[_count - 1];
+}
+
+/**
+ * Return the object at index, counting from the first object added.
+ * @return The object, or nil if index is beyond the end of the array.
+ */
+- (id) objectAtIndex: (unsigned int) index {
+    if (index >= _count)
+        return nil;
+
+    return _objects[index];
 }
 
 /**
@@ -158,32 +157,21 @@ typedef struct _TRArrayStack {
  * @return YES if the array contains anObject, NO otherwise.
  */
 - (BOOL) containsObject: (id) anObject {
-    TRArrayStack *node;
+    unsigned int i;
 
     /* Anything claim to be equal with anObject? */
-    for (node = _stack; node; node = node->next) {
-        if ([node->object isEqual: anObject])
+    for (i = _count; i > 0; i--) {
+        if ([_objects[i - 1] isEqual: anObject])
             return YES;
     }
 
     return NO;
 }
 
-- (TRArrayStack *) _privateArrayContext: (BOOL) top {
-    if (top)
-        return _stack;
-    else
-        return _stackBottom;
-}
-
 /**
  * Return a object enumerator.
  * This enumerater walks the stack,
  * implementing a LIFO interface.
- *
- * Due to our lack of an autorelease pool,
- * it is the caller's responsibility to release
- * the returned value.
  */
 - (TREnumerator *) objectEnumerator {
         return [[[TRArrayObjectEnumerator alloc] initWithArray: self] autorelease];
@@ -193,17 +181,11 @@ typedef struct _TRArrayStack {
  * Return a object enumerator.
  * This enumerater walks the stack in reverse,
  * implementing a FIFO interface.
- *
- * Due to our lack of an autorelease pool,
- * it is the caller's responsibility to release
- * the returned value.
  */
 - (TREnumerator *) objectReverseEnumerator {
         return [[[TRArrayReverseObjectEnumerator alloc] initWithArray: self] autorelease];
 }
 
-
-
 @end /* TRArray */
 
 @implementation TRArrayObjectEnumerator
@@ -219,23 +201,21 @@ typedef struct _TRArrayStack {
                 return self;
 
         _array = [array retain];
-        _stack = [array _privateArrayContext: YES];
+
+        /* Start from the top of the stack; objects added
+         * while enumerating are not returned */
+        _index = [array count];
 
         return self;
 }
 
 - (id) nextObject {
-    TRArrayStack *next;
-
-    if (!_stack)
+    /* Walk down the stack, stopping early if objects were removed */
+    if (_index == 0 || _index > [_array count])
         return nil;
 
-    /* Pop the next node from the stack */
-    next = _stack;
-    _stack = _stack->next;
-
-    /* Return the next node */
-    return (next->object);
+    _index--;
+    return [_array objectAtIndex: _index];
 }
 
 @end /* TRArrayObjectEnumerator */
@@ -243,29 +223,22 @@ typedef struct _TRArrayStack {
 @implementation TRArrayReverseObjectEnumerator
 
 - (id) initWithArray: (TRArray *) array {
-        self = [super init];
+        self = [super initWithArray: array];
         if (!self)
                 return self;
 
-        /* We want the bottom-most element of the stack,
-         * skipping the NULL terminator */
-        _stack = [array _privateArrayContext: NO]->prev;
+        /* Start from the bottom-most element of the stack */
+        _index = 0;
 
         return self;
 }
 
 - (id) nextObject {
-    TRArrayStack *prev;
-
-    if (!_stack)
-        return nil;
-
     /* Walk the stack in reverse */
-    prev = _stack;
-    _stack = _stack->prev;
+    if (_index >= [_array count])
+        return nil;
 
-    /* Return the previous node */
-    return (prev->object);
+    return [_array objectAtIndex: _index++];
 }
 
-@end /* TRArrayObjectEnumerator */
+@end /* TRArrayReverseObjectEnumerator */
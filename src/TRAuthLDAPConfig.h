@@ -33,6 +33,7 @@
 #import "TRObject.h"
 
 #import "TRLDAPGroupConfig.h"
+#import "TRLDAPSearchFilter.h"
 
 #import "TRConfig.h"
 #import "TRString.h"
@@ -42,9 +43,13 @@
 @private
     /* LDAP Settings */
     TRString *_url;
+    TRArray *_urls;
     BOOL _tlsEnabled;
     BOOL _referralEnabled;
     int _timeout;
+    int _poolSize;
+    int _hedgeDelay;
+    int _maxInFlight;
     TRString *_tlsCACertFile;
     TRString *_tlsCACertDir;
     TRString *_tlsCertFile;
@@ -56,12 +61,31 @@
     /* Authentication / Authorization Settings */
     TRString *_baseDN;
     TRString *_searchFilter;
+    TRLDAPSearchFilter *_userSearchFilter;
+    int _sizeLimit;
+    int _timeLimit;
     BOOL _requireGroup;
+    BOOL _deferredAuth;
+    int _workerThreads;
+    int _queueDepth;
+    BOOL _failFast;
+    BOOL _combinedGroupSearch;
+    int _groupSnapshotRefresh;
+    BOOL _syncRepl;
     TRString *_pfTable;
     TRArray *_ldapGroups;
     BOOL _pfEnabled;
 	BOOL _passwordISCR;
 
+    /* Credential Cache Settings */
+    BOOL _cacheEnabled;
+    int _cacheTTL;
+    int _cacheMaxEntries;
+    int _cacheHashIterations;
+    int _negativeCacheTTL;
+    int _negativeCacheMaxEntries;
+    int _maxFailedBinds;
+
     /* Parser State */
     TRString *_configFileName;
     TRConfig *_configDriver;
@@ -79,10 +103,21 @@
 /* Accessors */
 - (TRString *) url;
 - (void) setURL: (TRString *) newURL;
+- (TRArray *) urls;
+- (void) addURL: (TRString *) newURL;
 
 - (int) timeout;
 - (void) setTimeout: (int) newTimeout;
 
+- (int) poolSize;
+- (void) setPoolSize: (int) newPoolSize;
+
+- (int) hedgeDelay;
+- (void) setHedgeDelay: (int) newHedgeDelay;
+
+- (int) maxInFlight;
+- (void) setMaxInFlight: (int) newMaxInFlight;
+
 - (BOOL) tlsEnabled;
 - (void) setTLSEnabled: (BOOL) newTLSSetting;
 
@@ -112,6 +147,13 @@
 
 - (TRString *) searchFilter;
 - (void) setSearchFilter: (TRString *) searchFilter;
+- (TRLDAPSearchFilter *) userSearchFilter;
+
+- (int) sizeLimit;
+- (void) setSizeLimit: (int) sizeLimit;
+
+- (int) timeLimit;
+- (void) setTimeLimit: (int) timeLimit;
 
 - (BOOL) referralEnabled;
 - (void) setReferralEnabled: (BOOL) newReferralSetting;
@@ -119,6 +161,27 @@
 - (BOOL) requireGroup;
 - (void) setRequireGroup: (BOOL) requireGroup;
 
+- (BOOL) deferredAuth;
+- (void) setDeferredAuth: (BOOL) deferredAuth;
+
+- (int) workerThreads;
+- (void) setWorkerThreads: (int) workerThreads;
+
+- (int) queueDepth;
+- (void) setQueueDepth: (int) queueDepth;
+
+- (BOOL) failFast;
+- (void) setFailFast: (BOOL) failFast;
+
+- (BOOL) combinedGroupSearch;
+- (void) setCombinedGroupSearch: (BOOL) combinedGroupSearch;
+
+- (int) groupSnapshotRefresh;
+- (void) setGroupSnapshotRefresh: (int) groupSnapshotRefresh;
+
+- (BOOL) syncRepl;
+- (void) setSyncRepl: (BOOL) syncRepl;
+
 - (TRString *) pfTable;
 - (void) setPFTable: (TRString *) tableName;
 
@@ -130,4 +193,25 @@
 - (BOOL) passWordIsCR;
 - (void) setPassWordIsCR: (BOOL)newCRSetting;
 
+- (BOOL) cacheEnabled;
+- (void) setCacheEnabled: (BOOL) cacheEnabled;
+
+- (int) cacheTTL;
+- (void) setCacheTTL: (int) seconds;
+
+- (int) cacheMaxEntries;
+- (void) setCacheMaxEntries: (int) maxEntries;
+
+- (int) cacheHashIterations;
+- (void) setCacheHashIterations: (int) iterations;
+
+- (int) negativeCacheTTL;
+- (void) setNegativeCacheTTL: (int) seconds;
+
+- (int) negativeCacheMaxEntries;
+- (void) setNegativeCacheMaxEntries: (int) maxEntries;
+
+- (int) maxFailedBinds;
+- (void) setMaxFailedBinds: (int) maxFailedBinds;
+
 @end
@@ -42,6 +42,32 @@
 
 #import "TRLog.h"
 #import "TRHash.h"
+#import "TRLDAPConnection.h"
+
+/* Default number of idle LDAP connections kept open between requests */
+#define DEFAULT_POOL_SIZE 4
+
+/* Default number of deferred authentication threads */
+#define DEFAULT_WORKER_THREADS 4
+#define DEFAULT_QUEUE_DEPTH 256
+
+/* Default credential cache lifetime, in seconds */
+#define DEFAULT_CACHE_TTL 300
+
+/* Default maximum number of cached credentials */
+#define DEFAULT_CACHE_MAX_ENTRIES 1024
+
+/* Default PBKDF2 iteration count for cached credential digests */
+#define DEFAULT_CACHE_HASH_ITERATIONS 10000
+
+/* Default lifetime of unknown user and failed bind records, in seconds */
+#define DEFAULT_NEGATIVE_CACHE_TTL 60
+
+/* Default maximum number of unknown user and failed bind records */
+#define DEFAULT_NEGATIVE_CACHE_MAX_ENTRIES 4096
+
+/* Default number of failed binds after which a user is rejected from cache */
+#define DEFAULT_MAX_FAILED_BINDS 5
 
 /* All Variables and Section Types */
 typedef enum {
@@ -50,10 +76,13 @@ typedef enum {
     LF_LDAP_SECTION,            /* LDAP Server Settings */
     LF_AUTH_SECTION,            /* LDAP Authorization Settings */
     LF_GROUP_SECTION,           /* LDAP Group Settings */
+    LF_CACHE_SECTION,           /* Credential Cache Settings */
 
     /* Generic LDAP Search Variables */
     LF_LDAP_BASEDN,             /* Base DN for Search */
     LF_LDAP_SEARCH_FILTER,      /* Search Filter */
+    LF_LDAP_SIZE_LIMIT,         /* Maximum Entries Returned by a Search */
+    LF_LDAP_TIME_LIMIT,         /* Maximum Server Time Spent on a Search */
 
     /* Generic PF Variables */
     LF_AUTH_PFTABLE,            /* PF Table Name */
@@ -70,18 +99,37 @@ typedef enum {
     LF_LDAP_TLS_CERTFILE,       /* TLS Client Certificate File */
     LF_LDAP_TLS_KEYFILE,        /* TLS Client Key File */
     LF_LDAP_TLS_CIPHER_SUITE,   /* TLS Cipher Suite */
+    LF_LDAP_POOL_SIZE,          /* Maximum Pooled Connections */
+    LF_LDAP_HEDGE_DELAY,        /* Minimum Delay Before a Hedged Search */
+    LF_LDAP_MAX_IN_FLIGHT,      /* Maximum Outstanding Requests per Server */
 
     /* Authorization Section Variables */
     LF_AUTH_REQUIRE_GROUP,      /* Require Group Membership */
+    LF_AUTH_DEFERRED,           /* Authenticate Asynchronously */
+    LF_AUTH_WORKER_THREADS,     /* Number of Authentication Threads */
+    LF_AUTH_QUEUE_DEPTH,        /* Maximum Queued Deferred Authentications */
+    LF_AUTH_FAIL_FAST,          /* Reject Requests When LDAP is Unavailable */
+    LF_AUTH_COMBINED_GROUP_SEARCH, /* Evaluate Groups With a Single Search */
+    LF_AUTH_GROUP_SNAPSHOT_REFRESH, /* Group Membership Snapshot Interval */
+    LF_AUTH_SYNC_REPL,          /* Invalidate Cached State on Directory Changes */
 
     /* Group Section Variables */
     LF_GROUP_MEMBER_ATTRIBUTE,  /* Group Membership Attribute */
     LF_GROUP_MEMBER_RFC2307BIS,	/* Look for full DN for user in attribute */
     LF_GROUP_MEMBER_USECOMPAREOPERATION, /* Use LDAP Compare operation instead of Search (Search is faster but doesn't work in all LDAP environments) */
+    LF_GROUP_PAGE_SIZE,         /* Entries per Page When Loading Group Members */
 
 	/* OpenVPN Challenge/Response */
     LF_AUTH_PASSWORD_CR,      /* Password is in challenge/repsonse format */
 
+    /* Cache Section Variables */
+    LF_CACHE_TTL,               /* Credential Lifetime */
+    LF_CACHE_MAX_ENTRIES,       /* Maximum Cached Credentials */
+    LF_CACHE_HASH_ITERATIONS,   /* PBKDF2 Iteration Count */
+    LF_CACHE_NEGATIVE_TTL,      /* Unknown User / Failed Bind Lifetime */
+    LF_CACHE_NEGATIVE_MAX_ENTRIES, /* Maximum Unknown User / Failed Bind Records */
+    LF_CACHE_MAX_FAILED_BINDS,  /* Failed Binds Before Rejection */
+
     /* Misc Shared */
     LF_UNKNOWN_OPCODE,          /* Unknown Opcode */
 } ConfigOpcode;
@@ -108,6 +156,7 @@ static OpcodeTable SectionTypes[] = {
     { "LDAP",           LF_LDAP_SECTION,    NO,     YES },
     { "Authorization",  LF_AUTH_SECTION,    NO,     YES },
     { "Group",          LF_GROUP_SECTION,   YES,    NO },
+    { "Cache",          LF_CACHE_SECTION,   NO,     NO },
     { NULL, 0 }
 };
 
@@ -116,6 +165,8 @@ static OpcodeTable GenericLDAPVariables[] = {
     /* name             opcode                  multi   required */
     { "BaseDN",         LF_LDAP_BASEDN,         NO,     YES },
     { "SearchFilter",   LF_LDAP_SEARCH_FILTER,  NO,     YES },
+    { "SizeLimit",      LF_LDAP_SIZE_LIMIT,     NO,     NO },
+    { "TimeLimit",      LF_LDAP_TIME_LIMIT,     NO,     NO },
     { NULL, 0 }
 };
 
@@ -131,7 +182,7 @@ static OpcodeTable GenericPFVariables[] = {
 /* LDAP Section Variables */
 static OpcodeTable LDAPSectionVariables[] = {
     /* name                 opcode                      multi   required */
-    { "URL",                LF_LDAP_URL,                NO,     YES },
+    { "URL",                LF_LDAP_URL,                YES,    YES },
     { "Timeout",            LF_LDAP_TIMEOUT,            NO,     NO },
     { "BindDN",             LF_LDAP_BINDDN,             NO,     NO },
     { "Password",           LF_LDAP_PASSWORD,           NO,     NO },
@@ -142,6 +193,9 @@ static OpcodeTable LDAPSectionVariables[] = {
     { "TLSCertFile",        LF_LDAP_TLS_CERTFILE,       NO,     NO },
     { "TLSKeyFile",         LF_LDAP_TLS_KEYFILE,        NO,     NO },
     { "TLSCipherSuite",     LF_LDAP_TLS_CIPHER_SUITE,   NO,     NO },
+    { "PoolSize",           LF_LDAP_POOL_SIZE,          NO,     NO },
+    { "HedgeDelay",         LF_LDAP_HEDGE_DELAY,        NO,     NO },
+    { "MaxInFlight",        LF_LDAP_MAX_IN_FLIGHT,      NO,     NO },
     { NULL, 0 }
 };
 
@@ -149,6 +203,13 @@ static OpcodeTable LDAPSectionVariables[] = {
 static OpcodeTable AuthSectionVariables[] = {
     /* name             opcode                  multi   required */
     { "RequireGroup",   LF_AUTH_REQUIRE_GROUP,  NO,     NO },
+    { "DeferredAuth",   LF_AUTH_DEFERRED,       NO,     NO },
+    { "WorkerThreads",  LF_AUTH_WORKER_THREADS, NO,     NO },
+    { "QueueDepth",     LF_AUTH_QUEUE_DEPTH,    NO,     NO },
+    { "FailFast",       LF_AUTH_FAIL_FAST,      NO,     NO },
+    { "CombinedGroupSearch", LF_AUTH_COMBINED_GROUP_SEARCH, NO, NO },
+    { "GroupSnapshotRefresh", LF_AUTH_GROUP_SNAPSHOT_REFRESH, NO, NO },
+    { "SyncRepl",       LF_AUTH_SYNC_REPL,      NO,     NO },
     { NULL, 0}
 };
 
@@ -158,6 +219,7 @@ static OpcodeTable GroupSectionVariables[] = {
     { "MemberAttribute",    LF_GROUP_MEMBER_ATTRIBUTE,  NO,     NO },
     { "RFC2307bis",	        LF_GROUP_MEMBER_RFC2307BIS, NO,     NO },
     { "UseCompareOperation", LF_GROUP_MEMBER_USECOMPAREOPERATION, NO, NO },
+    { "PageSize",           LF_GROUP_PAGE_SIZE,         NO,     NO },
     { NULL, 0 }
 };
 
@@ -168,6 +230,18 @@ static OpcodeTable OpenVPNCRVariables[] = {
     { NULL, 0 }
 };
 
+/* Cache Section Variables */
+static OpcodeTable CacheSectionVariables[] = {
+    /* name                 opcode                      multi   required */
+    { "TTL",                LF_CACHE_TTL,               NO,     NO },
+    { "MaxEntries",         LF_CACHE_MAX_ENTRIES,       NO,     NO },
+    { "HashIterations",     LF_CACHE_HASH_ITERATIONS,   NO,     NO },
+    { "NegativeTTL",        LF_CACHE_NEGATIVE_TTL,      NO,     NO },
+    { "NegativeMaxEntries", LF_CACHE_NEGATIVE_MAX_ENTRIES, NO,   NO },
+    { "MaxFailedBinds",     LF_CACHE_MAX_FAILED_BINDS,  NO,     NO },
+    { NULL, 0 }
+};
+
 /* Section Types */
 static OpcodeTable *Sections[] = {
     SectionTypes,
@@ -198,6 +272,12 @@ static OpcodeTable *GroupSection[] = {
     NULL
 };
 
+/* Cache Section Definition */
+static OpcodeTable *CacheSection[] = {
+    CacheSectionVariables,
+    NULL
+};
+
 /* Parse a string, returning the associated entry from the supplied table */
 static OpcodeTable *parse_opcode (TRConfigToken *token, OpcodeTable **tables) {
     const char *cp = [token cString];
@@ -299,6 +379,9 @@ static const char *string_for_opcode(ConfigOpcode opcode, OpcodeTable *tables[])
     if (_url)
         [_url release];
 
+    if (_urls)
+        [_urls release];
+
     if (_bindDN)
         [_bindDN release];
 
@@ -326,6 +409,9 @@ static const char *string_for_opcode(ConfigOpcode opcode, OpcodeTable *tables[])
     if (_searchFilter)
         [_searchFilter release];
 
+    if (_userSearchFilter)
+        [_userSearchFilter release];
+
     if (_ldapGroups)
         [_ldapGroups release];
 
@@ -350,6 +436,18 @@ static const char *string_for_opcode(ConfigOpcode opcode, OpcodeTable *tables[])
     if (self == NULL)
         return (self);
 
+    /* Defaults */
+    _poolSize = DEFAULT_POOL_SIZE;
+    _workerThreads = DEFAULT_WORKER_THREADS;
+    _queueDepth = DEFAULT_QUEUE_DEPTH;
+    _sizeLimit = TRLDAP_DEFAULT_SIZE_LIMIT;
+    _cacheTTL = DEFAULT_CACHE_TTL;
+    _cacheMaxEntries = DEFAULT_CACHE_MAX_ENTRIES;
+    _cacheHashIterations = DEFAULT_CACHE_HASH_ITERATIONS;
+    _negativeCacheTTL = DEFAULT_NEGATIVE_CACHE_TTL;
+    _negativeCacheMaxEntries = DEFAULT_NEGATIVE_CACHE_MAX_ENTRIES;
+    _maxFailedBinds = DEFAULT_MAX_FAILED_BINDS;
+
     /* Initialize the section stack */
     _sectionStack = [[TRArray alloc] init];
     section = [[SectionState alloc] initWithOpcode: LF_NO_SECTION];
@@ -465,6 +563,14 @@ error:
     [_configDriver errorStop];
 }
 
+/**
+ * Report an integer value that must be greater than zero to the user.
+ */
+- (void) errorPositiveIntValue: (TRConfigToken *) value {
+    [TRLog error: "Auth-LDAP Configuration Error: %s value must be greater than zero (%s:%u).", [value cString], [_configFileName cString], [value lineNumber]];
+    [_configDriver errorStop];
+}
+
 /**
  * Report an invalid boolean value to the user.
  */
@@ -534,7 +640,8 @@ error:
     switch([self currentSectionOpcode]) {
         /* Top-level sections supported:
          *     - LDAP (unnamed)
-         *     - Group (named)
+         *     - Authorization (unnamed)
+         *     - Cache (unnamed)
          */
         case LF_NO_SECTION:
             switch (opcodeEntry->opcode) {
@@ -552,6 +659,14 @@ error:
                     }
                     [self pushSection: opcodeEntry->opcode];
                     break;
+                case LF_CACHE_SECTION:
+                    if (name) {
+                        [self errorNamedSection: sectionType withName: name];
+                        return;
+                    }
+                    [self pushSection: opcodeEntry->opcode];
+                    [self setCacheEnabled: YES];
+                    break;
                 default:
                     [self errorUnknownSection: sectionType];
                     return;
@@ -612,12 +727,15 @@ error:
             }
             switch (opcodeEntry->opcode) {
                 int timeout;
+                int poolSize;
+                int hedgeDelay;
+                int maxInFlight;
                 BOOL enableTLS;
                 BOOL enableReferral;
 
                 /* LDAP URL */
                 case LF_LDAP_URL:
-                    [self setURL: [value string]];
+                    [self addURL: [value string]];
                     break;
 
                 /* LDAP Bind DN */
@@ -682,6 +800,43 @@ error:
                     [self setTLSCipherSuite: [value string]];
                     break;
 
+                /* Connection Pool Size */
+                case LF_LDAP_POOL_SIZE:
+                    if (![value intValue: &poolSize]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (poolSize < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setPoolSize: poolSize];
+                    break;
+
+                case LF_LDAP_HEDGE_DELAY:
+                    if (![value intValue: &hedgeDelay]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (hedgeDelay < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setHedgeDelay: hedgeDelay];
+                    break;
+
+                case LF_LDAP_MAX_IN_FLIGHT:
+                    if (![value intValue: &maxInFlight]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (maxInFlight < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setMaxInFlight: maxInFlight];
+                    break;
+
                 /* Unknown Setting */
                 default:
                     [self errorUnknownKey: key];
@@ -699,6 +854,15 @@ error:
             switch(opcodeEntry->opcode) {
                 BOOL requireGroup;
 				BOOL passWordCR;
+                BOOL deferredAuth;
+                int workerThreads;
+                int queueDepth;
+                BOOL failFast;
+                BOOL combinedGroupSearch;
+                int groupSnapshotRefresh;
+                BOOL syncRepl;
+                int sizeLimit;
+                int timeLimit;
 
                 case LF_AUTH_REQUIRE_GROUP:
                     if (![value boolValue: &requireGroup]) {
@@ -708,6 +872,74 @@ error:
                     [self setRequireGroup: requireGroup];
                     break;
 
+                case LF_AUTH_DEFERRED:
+                    if (![value boolValue: &deferredAuth]) {
+                        [self errorBoolValue: value];
+                        return;
+                    }
+                    [self setDeferredAuth: deferredAuth];
+                    break;
+
+                case LF_AUTH_WORKER_THREADS:
+                    if (![value intValue: &workerThreads]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (workerThreads < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setWorkerThreads: workerThreads];
+                    break;
+
+                case LF_AUTH_QUEUE_DEPTH:
+                    if (![value intValue: &queueDepth]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (queueDepth < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setQueueDepth: queueDepth];
+                    break;
+
+                case LF_AUTH_FAIL_FAST:
+                    if (![value boolValue: &failFast]) {
+                        [self errorBoolValue: value];
+                        return;
+                    }
+                    [self setFailFast: failFast];
+                    break;
+
+                case LF_AUTH_COMBINED_GROUP_SEARCH:
+                    if (![value boolValue: &combinedGroupSearch]) {
+                        [self errorBoolValue: value];
+                        return;
+                    }
+                    [self setCombinedGroupSearch: combinedGroupSearch];
+                    break;
+
+                case LF_AUTH_GROUP_SNAPSHOT_REFRESH:
+                    if (![value intValue: &groupSnapshotRefresh]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (groupSnapshotRefresh < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setGroupSnapshotRefresh: groupSnapshotRefresh];
+                    break;
+
+                case LF_AUTH_SYNC_REPL:
+                    if (![value boolValue: &syncRepl]) {
+                        [self errorBoolValue: value];
+                        return;
+                    }
+                    [self setSyncRepl: syncRepl];
+                    break;
+
                 case LF_LDAP_BASEDN:
                     [self setBaseDN: [value string]];
                     break;
@@ -716,6 +948,30 @@ error:
                     [self setSearchFilter: [value string]];
                     break;
 
+                case LF_LDAP_SIZE_LIMIT:
+                    if (![value intValue: &sizeLimit]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (sizeLimit < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setSizeLimit: sizeLimit];
+                    break;
+
+                case LF_LDAP_TIME_LIMIT:
+                    if (![value intValue: &timeLimit]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (timeLimit < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setTimeLimit: timeLimit];
+                    break;
+
                 case LF_AUTH_PFTABLE:
                     [self setPFTable: [value string]];
                     [self setPFEnabled: YES];
@@ -746,6 +1002,9 @@ error:
                 TRLDAPGroupConfig *config;
                 BOOL memberRFC2307BIS;
                 BOOL useCompareOperation;
+                int sizeLimit;
+                int timeLimit;
+                int pageSize;
 
                 case LF_GROUP_MEMBER_ATTRIBUTE:
                     config = [self currentSectionContext];
@@ -770,6 +1029,22 @@ error:
                     [config setUseCompareOperation: useCompareOperation];
                     break;
 
+                case LF_GROUP_PAGE_SIZE:
+                    config = [self currentSectionContext];
+                    if (![value intValue: &pageSize]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (pageSize < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+#ifndef HAVE_LDAP_PAGED_RESULTS
+                    [TRLog warning: "Auth-LDAP Configuration Warning: paged searches are not supported by the LDAP library; %s is ignored (%s:%u).", [key cString], [_configFileName cString], [key lineNumber]];
+#endif
+                    [config setPageSize: pageSize];
+                    break;
+
                 case LF_LDAP_BASEDN:
                     config = [self currentSectionContext];
                     [config setBaseDN: [value string]];
@@ -780,6 +1055,32 @@ error:
                     [config setSearchFilter: [value string]];
                     break;
 
+                case LF_LDAP_SIZE_LIMIT:
+                    config = [self currentSectionContext];
+                    if (![value intValue: &sizeLimit]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (sizeLimit < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [config setSizeLimit: sizeLimit];
+                    break;
+
+                case LF_LDAP_TIME_LIMIT:
+                    config = [self currentSectionContext];
+                    if (![value intValue: &timeLimit]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (timeLimit < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [config setTimeLimit: timeLimit];
+                    break;
+
                 case LF_AUTH_PFTABLE:
                     config = [self currentSectionContext];
                     [config setPFTable: [value string]];
@@ -791,6 +1092,97 @@ error:
                     [self errorUnknownKey: key];
             }
             break;
+        case LF_CACHE_SECTION:
+            opcodeEntry = parse_opcode(key, CacheSection);
+            if (!opcodeEntry) {
+                [self errorUnknownKey: key];
+                return;
+            }
+
+            switch(opcodeEntry->opcode) {
+                int cacheTTL;
+                int maxEntries;
+                int iterations;
+                int maxFailedBinds;
+
+                case LF_CACHE_TTL:
+                    if (![value intValue: &cacheTTL]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (cacheTTL < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setCacheTTL: cacheTTL];
+                    break;
+
+                case LF_CACHE_MAX_ENTRIES:
+                    if (![value intValue: &maxEntries]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (maxEntries < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setCacheMaxEntries: maxEntries];
+                    break;
+
+                case LF_CACHE_HASH_ITERATIONS:
+                    if (![value intValue: &iterations]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (iterations < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setCacheHashIterations: iterations];
+                    break;
+
+                case LF_CACHE_NEGATIVE_TTL:
+                    if (![value intValue: &cacheTTL]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (cacheTTL < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setNegativeCacheTTL: cacheTTL];
+                    break;
+
+                case LF_CACHE_NEGATIVE_MAX_ENTRIES:
+                    if (![value intValue: &maxEntries]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (maxEntries < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setNegativeCacheMaxEntries: maxEntries];
+                    break;
+
+                case LF_CACHE_MAX_FAILED_BINDS:
+                    if (![value intValue: &maxFailedBinds]) {
+                        [self errorIntValue: value];
+                        return;
+                    }
+                    if (maxFailedBinds < 1) {
+                        [self errorPositiveIntValue: value];
+                        return;
+                    }
+                    [self setMaxFailedBinds: maxFailedBinds];
+                    break;
+
+                /* Unknown Setting */
+                default:
+                    [self errorUnknownKey: key];
+                    return;
+            }
+            break;
         default:
             /* Must be unreachable! */
             [TRLog error: "Unhandled section type in setKey!\n"];
@@ -798,12 +1190,14 @@ error:
             break;
     }
 
-    /* Lastly, prevent multiple occurances of a single-use key */
-    if (!opcodeEntry->multi) {
-        if ([hashTable valueForKey: [key string]]) {
+    /* Lastly, prevent multiple occurances of a single-use key. Multi-use
+     * keys are recorded once, so that required keys may be validated. */
+    if ([hashTable valueForKey: [key string]]) {
+        if (!opcodeEntry->multi) {
             [self errorMultiKey: key];
             return;
         }
+    } else {
         [hashTable setObject: value forKey: [key string]];
     }
 }
@@ -835,6 +1229,9 @@ error:
                 break;
             [_ldapGroups addObject: [self currentSectionContext]];
             break;
+        case LF_CACHE_SECTION:
+            [self validateRequiredVariables: CacheSection withSectionEnd: sectionEnd];
+            break;
         default:
             /* Must be unreachable! */
             [TRLog error: "Unhandled section type in endSection!\n"];
@@ -895,6 +1292,27 @@ error:
     _url = [newURL retain];
 }
 
+/**
+ * Return all configured server URLs, in configuration order, or nil if
+ * none were configured. -url returns the first.
+ */
+- (TRArray *) urls {
+    return (_urls);
+}
+
+/**
+ * Add an additional server URL. The first URL added also becomes the
+ * value returned by -url.
+ */
+- (void) addURL: (TRString *) newURL {
+    if (!_urls)
+        _urls = [[TRArray alloc] init];
+    [_urls addObject: newURL];
+
+    if (!_url)
+        [self setURL: newURL];
+}
+
 - (TRString *) baseDN {
     return (_baseDN);
 }
@@ -909,6 +1327,14 @@ error:
     return (_searchFilter);
 }
 
+/**
+ * Returns the user search filter, compiled for substitution
+ * of the %u specifier.
+ */
+- (TRLDAPSearchFilter *) userSearchFilter {
+    return (_userSearchFilter);
+}
+
 - (BOOL) requireGroup {
     return (_requireGroup);
 }
@@ -917,10 +1343,109 @@ error:
     _requireGroup = requireGroup;
 }
 
+- (BOOL) deferredAuth {
+    return (_deferredAuth);
+}
+
+- (void) setDeferredAuth: (BOOL) deferredAuth {
+    _deferredAuth = deferredAuth;
+}
+
+- (int) workerThreads {
+    return (_workerThreads);
+}
+
+- (void) setWorkerThreads: (int) workerThreads {
+    _workerThreads = workerThreads;
+}
+
+/**
+ * Maximum number of deferred authentication requests waiting
+ * for a worker thread.
+ */
+- (int) queueDepth {
+    return (_queueDepth);
+}
+
+- (void) setQueueDepth: (int) queueDepth {
+    _queueDepth = queueDepth;
+}
+
+/**
+ * Whether to reject requests immediately, rather than wait on
+ * servers that are known to be failing.
+ */
+- (BOOL) failFast {
+    return (_failFast);
+}
+
+- (void) setFailFast: (BOOL) failFast {
+    _failFast = failFast;
+}
+
+/**
+ * Maximum number of entries returned by a user search.
+ */
+- (int) sizeLimit {
+    return (_sizeLimit);
+}
+
+- (void) setSizeLimit: (int) sizeLimit {
+    _sizeLimit = sizeLimit;
+}
+
+/**
+ * Maximum number of seconds the server may spend on a user search,
+ * or 0 for no limit beyond the LDAP timeout.
+ */
+- (int) timeLimit {
+    return (_timeLimit);
+}
+
+- (void) setTimeLimit: (int) timeLimit {
+    _timeLimit = timeLimit;
+}
+
+- (BOOL) combinedGroupSearch {
+    return (_combinedGroupSearch);
+}
+
+- (void) setCombinedGroupSearch: (BOOL) combinedGroupSearch {
+    _combinedGroupSearch = combinedGroupSearch;
+}
+
+/**
+ * Interval, in seconds, between refreshes of the group membership
+ * snapshot, or 0 if group membership is checked at each login.
+ */
+- (int) groupSnapshotRefresh {
+    return (_groupSnapshotRefresh);
+}
+
+- (void) setGroupSnapshotRefresh: (int) groupSnapshotRefresh {
+    _groupSnapshotRefresh = groupSnapshotRefresh;
+}
+
+/**
+ * Whether to follow directory changes with a syncrepl session,
+ * invalidating cached credentials and group membership as entries change.
+ */
+- (BOOL) syncRepl {
+    return (_syncRepl);
+}
+
+- (void) setSyncRepl: (BOOL) syncRepl {
+    _syncRepl = syncRepl;
+}
+
 - (void) setSearchFilter: (TRString *) searchFilter {
     if (_searchFilter)
         [_searchFilter release];
     _searchFilter = [searchFilter retain];
+
+    if (_userSearchFilter)
+        [_userSearchFilter release];
+    _userSearchFilter = [[TRLDAPSearchFilter alloc] initWithFormat: searchFilter specifier: "%u"];
 }
 
 - (BOOL) referralEnabled {
@@ -939,6 +1464,38 @@ error:
     _timeout = newTimeout;
 }
 
+- (int) poolSize {
+    return (_poolSize);
+}
+
+- (void) setPoolSize: (int) newPoolSize {
+    _poolSize = newPoolSize;
+}
+
+/**
+ * Minimum delay, in milliseconds, before a slow search is repeated
+ * against a second server, or 0 if hedging is disabled.
+ */
+- (int) hedgeDelay {
+    return (_hedgeDelay);
+}
+
+- (void) setHedgeDelay: (int) newHedgeDelay {
+    _hedgeDelay = newHedgeDelay;
+}
+
+/**
+ * Maximum number of requests outstanding to any one server, or 0
+ * if unlimited.
+ */
+- (int) maxInFlight {
+    return (_maxInFlight);
+}
+
+- (void) setMaxInFlight: (int) newMaxInFlight {
+    _maxInFlight = newMaxInFlight;
+}
+
 - (TRString *) tlsCACertFile {
     return (_tlsCACertFile);
 }
@@ -1019,4 +1576,60 @@ error:
 - (void) setPassWordIsCR: (BOOL) newCRSetting {
     _passwordISCR = newCRSetting;
 }
+
+- (BOOL) cacheEnabled {
+    return (_cacheEnabled);
+}
+
+- (void) setCacheEnabled: (BOOL) cacheEnabled {
+    _cacheEnabled = cacheEnabled;
+}
+
+- (int) cacheTTL {
+    return (_cacheTTL);
+}
+
+- (void) setCacheTTL: (int) seconds {
+    _cacheTTL = seconds;
+}
+
+- (int) cacheMaxEntries {
+    return (_cacheMaxEntries);
+}
+
+- (void) setCacheMaxEntries: (int) maxEntries {
+    _cacheMaxEntries = maxEntries;
+}
+
+- (int) cacheHashIterations {
+    return (_cacheHashIterations);
+}
+
+- (void) setCacheHashIterations: (int) iterations {
+    _cacheHashIterations = iterations;
+}
+
+- (int) negativeCacheTTL {
+    return (_negativeCacheTTL);
+}
+
+- (void) setNegativeCacheTTL: (int) seconds {
+    _negativeCacheTTL = seconds;
+}
+
+- (int) negativeCacheMaxEntries {
+    return (_negativeCacheMaxEntries);
+}
+
+- (void) setNegativeCacheMaxEntries: (int) maxEntries {
+    _negativeCacheMaxEntries = maxEntries;
+}
+
+- (int) maxFailedBinds {
+    return (_maxFailedBinds);
+}
+
+- (void) setMaxFailedBinds: (int) maxFailedBinds {
+    _maxFailedBinds = maxFailedBinds;
+}
 @end
@@ -0,0 +1,73 @@
+/*
+ * TRCredentialCache.h vi:ts=4:sw=4:expandtab:
+ * Cache of recently verified user credentials
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "TRObject.h"
+#import "TRString.h"
+#import "TRLRUCache.h"
+#import "TRLDAPGroupConfig.h"
+
+/* Length of the per-credential random salt */
+#define TR_CREDENTIAL_SALT_LENGTH 16
+
+/* Length of the derived password digest */
+#define TR_CREDENTIAL_DIGEST_LENGTH 32
+
+@interface TRCachedCredential : TRObject {
+@private
+    TRString *_dn;
+    TRLDAPGroupConfig *_groupConfig;
+    unsigned char _salt[TR_CREDENTIAL_SALT_LENGTH];
+    unsigned char _digest[TR_CREDENTIAL_DIGEST_LENGTH];
+    unsigned int _iterations;
+}
+
+- (id) initWithDN: (TRString *) dn groupConfig: (TRLDAPGroupConfig *) groupConfig password: (const char *) password iterations: (unsigned int) iterations;
+- (BOOL) matchesPassword: (const char *) password;
+- (TRString *) dn;
+- (TRLDAPGroupConfig *) groupConfig;
+
+@end
+
+@interface TRCredentialCache : TRObject {
+@private
+    TRLRUCache *_cache;
+    unsigned int _iterations;
+}
+
+- (id) initWithCapacity: (unsigned int) capacity ttl: (unsigned int) seconds iterations: (unsigned int) iterations;
+- (TRCachedCredential *) credentialForUser: (TRString *) username password: (const char *) password;
+- (void) setCredentialForUser: (TRString *) username dn: (TRString *) dn groupConfig: (TRLDAPGroupConfig *) groupConfig password: (const char *) password;
+- (void) removeCredentialForUser: (TRString *) username;
+- (void) removeCredentialsForDN: (TRString *) dn;
+- (void) removeAllCredentials;
+
+@end
@@ -0,0 +1,216 @@
+/*
+ * TRCredentialCache.m vi:ts=4:sw=4:expandtab:
+ * Cache of recently verified user credentials
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <string.h>
+
+#import <openssl/evp.h>
+#import <openssl/rand.h>
+#import <openssl/crypto.h>
+
+#import "TRCredentialCache.h"
+#import "TRLog.h"
+
+/**
+ * Derive a digest of password with PBKDF2-HMAC-SHA256. The iteration count
+ * makes brute-forcing the cached digests expensive.
+ */
+static BOOL derive_digest (const char *password, const unsigned char *salt, unsigned int iterations, unsigned char *digest) {
+    if (PKCS5_PBKDF2_HMAC(password, strlen(password),
+            salt, TR_CREDENTIAL_SALT_LENGTH,
+            iterations, EVP_sha256(),
+            TR_CREDENTIAL_DIGEST_LENGTH, digest) != 1)
+        return NO;
+
+    return YES;
+}
+
+/**
+ * A successfully verified credential. Only a salted digest of the
+ * password is retained; the plaintext is never stored.
+ */
+@implementation TRCachedCredential
+
+/**
+ * Initialize a new credential. Returns nil if the digest
+ * could not be computed.
+ */
+- (id) initWithDN: (TRString *) dn groupConfig: (TRLDAPGroupConfig *) groupConfig password: (const char *) password iterations: (unsigned int) iterations {
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _dn = [dn retain];
+    _groupConfig = [groupConfig retain];
+    _iterations = iterations;
+
+    if (RAND_bytes(_salt, sizeof(_salt)) != 1) {
+        [TRLog error: "Unable to generate a random credential cache salt."];
+        [self release];
+        return nil;
+    }
+
+    if (!derive_digest(password, _salt, _iterations, _digest)) {
+        [TRLog error: "Unable to compute a credential cache digest."];
+        [self release];
+        return nil;
+    }
+
+    return self;
+}
+
+- (void) dealloc {
+    [_dn release];
+    [_groupConfig release];
+    [super dealloc];
+}
+
+/**
+ * Returns YES if password matches the cached credential.
+ */
+- (BOOL) matchesPassword: (const char *) password {
+    unsigned char digest[TR_CREDENTIAL_DIGEST_LENGTH];
+    BOOL result;
+
+    if (!derive_digest(password, _salt, _iterations, digest))
+        return NO;
+
+    /* Constant time comparison */
+    result = (CRYPTO_memcmp(digest, _digest, sizeof(digest)) == 0);
+    memset(digest, 0, sizeof(digest));
+
+    return result;
+}
+
+/** The user's LDAP DN. */
+- (TRString *) dn {
+    return (_dn);
+}
+
+/** The group configuration matched when the credential was verified, if any. */
+- (TRLDAPGroupConfig *) groupConfig {
+    return (_groupConfig);
+}
+
+@end
+
+
+/**
+ * Caches the most recent successfully verified password for each user,
+ * along with their resolved DN and group, for a limited time.
+ */
+/* Match credentials for the given DN, compared case-insensitively */
+static BOOL credential_has_dn (id object, void *context) {
+    TRCachedCredential *credential = object;
+    TRString *dn = context;
+
+    return (strcasecmp([[credential dn] cString], [dn cString]) == 0);
+}
+
+@implementation TRCredentialCache
+
+/**
+ * Initialize a new credential cache.
+ * @param capacity Maximum number of cached users.
+ * @param seconds Time, in seconds, for which a credential remains valid.
+ * @param iterations PBKDF2 iteration count used to derive password digests.
+ */
+- (id) initWithCapacity: (unsigned int) capacity ttl: (unsigned int) seconds iterations: (unsigned int) iterations {
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _cache = [[TRLRUCache alloc] initWithCapacity: capacity ttl: seconds];
+    _iterations = iterations;
+
+    return self;
+}
+
+- (void) dealloc {
+    [_cache release];
+    [super dealloc];
+}
+
+/**
+ * Returns the cached credential for username, if present, unexpired,
+ * and matching password. Otherwise, returns nil.
+ */
+- (TRCachedCredential *) credentialForUser: (TRString *) username password: (const char *) password {
+    TRCachedCredential *credential;
+
+    credential = [_cache objectForKey: username];
+    if (!credential)
+        return nil;
+
+    if (![credential matchesPassword: password])
+        return nil;
+
+    return credential;
+}
+
+/**
+ * Cache a successfully verified password for username, replacing any
+ * existing credential.
+ */
+- (void) setCredentialForUser: (TRString *) username dn: (TRString *) dn groupConfig: (TRLDAPGroupConfig *) groupConfig password: (const char *) password {
+    TRCachedCredential *credential;
+
+    credential = [[TRCachedCredential alloc] initWithDN: dn groupConfig: groupConfig password: password iterations: _iterations];
+    if (!credential)
+        return;
+
+    [_cache setObject: credential forKey: username];
+    [credential release];
+}
+
+/**
+ * Remove any cached credential for username.
+ */
+- (void) removeCredentialForUser: (TRString *) username {
+    [_cache removeObjectForKey: username];
+}
+
+/**
+ * Remove any cached credentials for the user with the given DN,
+ * eg, after the user's directory entry has changed.
+ */
+- (void) removeCredentialsForDN: (TRString *) dn {
+    [_cache removeObjectsMatching: credential_has_dn context: dn];
+}
+
+/**
+ * Remove all cached credentials.
+ */
+- (void) removeAllCredentials {
+    [_cache removeAllObjects];
+}
+
+@end
@@ -0,0 +1,65 @@
+/*
+ * TRLDAPChangeMonitor.h vi:ts=4:sw=4:expandtab:
+ * Directory Change Notification via syncrepl
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <pthread.h>
+
+#import "TRObject.h"
+#import "TRArray.h"
+#import "TRString.h"
+#import "TRLDAPConnection.h"
+#import "TRLDAPConnectionPool.h"
+
+@interface TRLDAPChangeMonitor : TRObject {
+@private
+    TRLDAPConnectionPool *_pool;
+    TRArray *_baseDNs;
+    id <TRLDAPSyncDelegate> _delegate;
+    unsigned int _retryInterval;
+
+    /* Monitor thread */
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+    pthread_t _thread;
+    BOOL _running;
+    BOOL _shutdown;
+}
+
++ (BOOL) isDN: (TRString *) dn withinBaseDN: (TRString *) base;
+
+- (id) initWithConnectionPool: (TRLDAPConnectionPool *) pool baseDNs: (TRArray *) baseDNs delegate: (id <TRLDAPSyncDelegate>) delegate retryInterval: (unsigned int) seconds;
+
+- (TRArray *) baseDNs;
+
+- (BOOL) start;
+- (void) shutdown;
+
+@end
@@ -0,0 +1,334 @@
+/*
+ * TRLDAPChangeMonitor.m vi:ts=4:sw=4:expandtab:
+ * Directory Change Notification via syncrepl
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import <stdlib.h>
+#import <string.h>
+#import <errno.h>
+#import <time.h>
+
+#import "TRLDAPChangeMonitor.h"
+#import "TRAutoreleasePool.h"
+#import "TRLog.h"
+
+#import "xmalloc.h"
+
+/* Time, in seconds, to wait for changes on each session before checking for shutdown */
+#define POLL_INTERVAL 1
+
+static time_t monitor_now (void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+/*
+ * Private Methods
+ */
+@interface TRLDAPChangeMonitor (Private)
+- (void) runMonitor;
+- (BOOL) isShutdown;
+@end
+
+/* Monitor thread entry point */
+static void *change_monitor_thread (void *arg) {
+    TRLDAPChangeMonitor *monitor = arg;
+    [monitor runMonitor];
+    return NULL;
+}
+
+@implementation TRLDAPChangeMonitor (Private)
+
+- (BOOL) isShutdown {
+    BOOL shutdown;
+
+    pthread_mutex_lock(&_lock);
+    shutdown = _shutdown;
+    pthread_mutex_unlock(&_lock);
+
+    return shutdown;
+}
+
+/**
+ * Monitor thread main loop. Keeps a syncrepl session open for each base
+ * DN, resuming from the last cookie after a failure, until shut down.
+ */
+- (void) runMonitor {
+    TRAutoreleasePool *pool;
+    TRLDAPConnection **sessions;
+    TRString **cookies;
+    TRString **bases;
+    time_t *retryAt;
+    TREnumerator *iter;
+    struct timespec deadline;
+    unsigned int numBases;
+    unsigned int active;
+    unsigned int i;
+
+    numBases = [_baseDNs count];
+    sessions = xmalloc(sizeof(TRLDAPConnection *) * numBases);
+    cookies = xmalloc(sizeof(TRString *) * numBases);
+    bases = xmalloc(sizeof(TRString *) * numBases);
+    retryAt = xmalloc(sizeof(time_t) * numBases);
+
+    iter = [_baseDNs objectReverseEnumerator];
+    for (i = 0; i < numBases; i++) {
+        bases[i] = [iter nextObject];
+        sessions[i] = nil;
+        cookies[i] = nil;
+        retryAt[i] = 0;
+    }
+
+    while (![self isShutdown]) {
+        pool = [[TRAutoreleasePool alloc] init];
+        active = 0;
+
+        for (i = 0; i < numBases && ![self isShutdown]; i++) {
+            /* (Re)start the session */
+            if (!sessions[i]) {
+                if (monitor_now() < retryAt[i])
+                    continue;
+
+                sessions[i] = [_pool openConnection];
+                if (!sessions[i] || ![sessions[i] startSyncWithBaseDN: bases[i] cookie: cookies[i] delegate: _delegate]) {
+                    [TRLog warning: "Unable to follow changes under \"%s\"; retrying in %u seconds.", [bases[i] cString], _retryInterval];
+                    [sessions[i] release];
+                    sessions[i] = nil;
+                    retryAt[i] = monitor_now() + _retryInterval;
+                    continue;
+                }
+
+                [TRLog debug: "Following changes under \"%s\".", [bases[i] cString]];
+            }
+
+            /* Wait for changes */
+            if (![sessions[i] pollSyncWithTimeout: POLL_INTERVAL]) {
+                /* Resume from the last cookie */
+                [cookies[i] release];
+                cookies[i] = [[sessions[i] syncCookie] retain];
+
+                [sessions[i] endSync];
+                [sessions[i] release];
+                sessions[i] = nil;
+                retryAt[i] = monitor_now() + _retryInterval;
+                continue;
+            }
+
+            active++;
+        }
+
+        [pool release];
+
+        /* Nothing to poll; sleep until the next retry, or shutdown */
+        if (active == 0) {
+            pthread_mutex_lock(&_lock);
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += POLL_INTERVAL;
+            while (!_shutdown) {
+                if (pthread_cond_timedwait(&_cond, &_lock, &deadline) == ETIMEDOUT)
+                    break;
+            }
+            pthread_mutex_unlock(&_lock);
+        }
+    }
+
+    for (i = 0; i < numBases; i++) {
+        if (sessions[i]) {
+            [sessions[i] endSync];
+            [sessions[i] release];
+        }
+        [cookies[i] release];
+    }
+
+    free(retryAt);
+    free(bases);
+    free(cookies);
+    free(sessions);
+}
+
+@end
+
+
+/**
+ * Follows changes to the directory with RFC 4533 syncrepl sessions,
+ * one per base DN, reporting them to a delegate from a background thread.
+ *
+ * Each session runs on its own connection, opened from the pool but not
+ * returned to it. A failed session is restarted after the retry interval,
+ * resuming from its last cookie, so that changes made in the meantime
+ * are still reported.
+ */
+@implementation TRLDAPChangeMonitor
+
+/**
+ * Returns YES if dn is base, or is an entry in the subtree under base.
+ * DNs are compared case-insensitively, without normalization.
+ */
++ (BOOL) isDN: (TRString *) dn withinBaseDN: (TRString *) base {
+    size_t dnLength;
+    size_t baseLength;
+    const char *suffix;
+
+    if (!dn || !base)
+        return NO;
+
+    dnLength = [dn length] - 1;
+    baseLength = [base length] - 1;
+
+    /* The root DSE contains everything */
+    if (baseLength == 0)
+        return YES;
+
+    if (dnLength < baseLength)
+        return NO;
+
+    suffix = [dn cString] + (dnLength - baseLength);
+    if (strcasecmp(suffix, [base cString]) != 0)
+        return NO;
+
+    /* The suffix must start at an RDN boundary */
+    return (dnLength == baseLength || suffix[-1] == ',');
+}
+
+/**
+ * Initialize a new change monitor.
+ * @param pool Pool from which session connections are opened.
+ * @param baseDNs Base DNs of the subtrees to follow. Bases within
+ * another base are followed by the enclosing base's session.
+ * @param delegate Receives changes, on the monitor thread.
+ * @param seconds Time to wait before restarting a failed session.
+ */
+- (id) initWithConnectionPool: (TRLDAPConnectionPool *) pool baseDNs: (TRArray *) baseDNs delegate: (id <TRLDAPSyncDelegate>) delegate retryInterval: (unsigned int) seconds {
+    TREnumerator *iter;
+    TREnumerator *otherIter;
+    TRString *base;
+    TRString *other;
+    BOOL covered;
+
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _pool = [pool retain];
+    _delegate = [delegate retain];
+    _retryInterval = seconds;
+
+    /* Drop bases within another base, and duplicates */
+    _baseDNs = [[TRArray alloc] init];
+    iter = [baseDNs objectReverseEnumerator];
+    while ((base = [iter nextObject]) != nil) {
+        covered = NO;
+
+        otherIter = [baseDNs objectReverseEnumerator];
+        while ((other = [otherIter nextObject]) != nil) {
+            if ([TRLDAPChangeMonitor isDN: base withinBaseDN: other] && ![TRLDAPChangeMonitor isDN: other withinBaseDN: base]) {
+                covered = YES;
+                break;
+            }
+        }
+
+        otherIter = [_baseDNs objectEnumerator];
+        while (!covered && (other = [otherIter nextObject]) != nil) {
+            if ([TRLDAPChangeMonitor isDN: base withinBaseDN: other])
+                covered = YES;
+        }
+
+        if (!covered)
+            [_baseDNs addObject: base];
+    }
+
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_cond, NULL);
+
+    return self;
+}
+
+- (void) dealloc {
+    [self shutdown];
+
+    [_baseDNs release];
+    [_delegate release];
+    [_pool release];
+
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_lock);
+
+    [super dealloc];
+}
+
+/**
+ * Returns the base DNs followed, one per session.
+ */
+- (TRArray *) baseDNs {
+    return _baseDNs;
+}
+
+/**
+ * Start the monitor thread.
+ * @return NO if the thread could not be started, or syncrepl is not
+ * supported by this build.
+ */
+- (BOOL) start {
+#ifdef HAVE_LDAP_SYNC
+    if (pthread_create(&_thread, NULL, change_monitor_thread, self) != 0) {
+        [TRLog error: "Unable to start the LDAP change monitor thread."];
+        return NO;
+    }
+
+    _running = YES;
+    return YES;
+#else
+    [TRLog error: "LDAP syncrepl is not supported by this build."];
+    return NO;
+#endif
+}
+
+/**
+ * Stop the monitor thread, ending all sessions.
+ */
+- (void) shutdown {
+    pthread_mutex_lock(&_lock);
+    _shutdown = YES;
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_lock);
+
+    if (_running) {
+        pthread_join(_thread, NULL);
+        _running = NO;
+    }
+}
+
+@end
@@ -31,22 +31,67 @@
  */
 
 #import <ldap.h>
+#import <sys/time.h>
 
 #import "TRObject.h"
 
 #import "TRLDAPEntry.h"
+#import "TRLDAPServer.h"
 
 #import "TRString.h"
 #import "TRArray.h"
+#import "TRHash.h"
+
+@class TRLDAPSearchEnumerator;
+
+/* Maximum number of entries returned by a search, unless otherwise specified */
+#define TRLDAP_DEFAULT_SIZE_LIMIT 1024
+
+/**
+ * Receives the directory changes reported by a syncrepl session.
+ */
+@protocol TRLDAPSyncDelegate
+/**
+ * The entry with the given DN was added, modified, renamed or deleted.
+ */
+- (void) ldapSyncEntryChanged: (TRString *) dn;
+
+/**
+ * Changes may have been missed, or can not be attributed to individual
+ * entries. Any state derived from the directory should be discarded.
+ */
+- (void) ldapSyncLostTrack;
+@end
 
 @interface TRLDAPConnection : TRObject {
 @private
     LDAP *ldapConn;
     int _timeout;
+    BOOL _valid;
+    BOOL _abandoned;
+    unsigned long _operationCount;
+
+    /* The server this connection was opened to, if known, and
+     * the time at which the connection was last leased */
+    TRLDAPServer *_server;
+    struct timeval _leaseStart;
+
+    /* TLS session offered for resumption (an SSL_SESSION), if any */
+    void *_tlsResumeSession;
+    BOOL _tlsHandshakeRecorded;
+
+    /* syncrepl session state (an ldap_sync_t), if any */
+    void *_sync;
+    id <TRLDAPSyncDelegate> _syncDelegate;
+    BOOL _syncSuppressEntries;
+    BOOL _syncLostTrack;
+    BOOL _syncEnded;
 }
 
 - (id) initWithURL: (TRString *) url timeout: (int) timeout;
 - (BOOL) startTLS;
+- (BOOL) isValid;
+- (void) invalidate;
 
 - (BOOL) bindWithDN: (TRString *) bindDN password: (TRString *) password;
 
@@ -54,14 +99,87 @@
               scope: (int) scope
               baseDN: (TRString *) base
               attributes: (TRArray *) attributes;
+- (TRArray *) searchWithFilter: (TRString *) filter
+              scope: (int) scope
+              baseDN: (TRString *) base
+              attributes: (TRArray *) attributes
+              sizeLimit: (int) sizeLimit
+              timeLimit: (int) timeLimit;
+- (TRArray *) searchWithFilter: (TRString *) filter
+              scope: (int) scope
+              baseDN: (TRString *) base
+              attributes: (TRArray *) attributes
+              sizeLimit: (int) sizeLimit
+              timeLimit: (int) timeLimit
+              succeeded: (BOOL *) succeeded;
 - (BOOL) compare: (TRString *) dn withAttribute: (TRString *) attribute value: (TRString *) value;
 - (BOOL) compareDN: (TRString *) dn withAttribute: (TRString *) attribute value: (TRString *) value;
 
+/* Asynchronous requests */
+- (int) sendSearchWithFilter: (TRString *) filter
+        scope: (int) scope
+        baseDN: (TRString *) base
+        attributes: (TRArray *) attributes;
+- (int) sendSearchWithFilter: (TRString *) filter
+        scope: (int) scope
+        baseDN: (TRString *) base
+        attributes: (TRArray *) attributes
+        sizeLimit: (int) sizeLimit
+        timeLimit: (int) timeLimit;
+- (int) sendSearchWithFilter: (TRString *) filter
+        scope: (int) scope
+        baseDN: (TRString *) base
+        attributes: (TRArray *) attributes
+        sizeLimit: (int) sizeLimit
+        timeLimit: (int) timeLimit
+        pageSize: (int) pageSize
+        cookie: (struct berval *) cookie;
+- (int) sendCompareDN: (TRString *) dn withAttribute: (TRString *) attribute value: (TRString *) value;
+- (LDAPMessage *) receiveResult: (int *) msgid;
+- (int) pollResult: (LDAPMessage **) result waitMilliseconds: (int) milliseconds;
+- (TRArray *) entriesFromSearchResult: (LDAPMessage *) result;
+- (TRArray *) entriesFromSearchResult: (LDAPMessage *) result succeeded: (BOOL *) succeeded;
+- (BOOL) compareResult: (LDAPMessage *) result;
+- (TRLDAPSearchEnumerator *) enumerateSearchWithFilter: (TRString *) filter
+        scope: (int) scope
+        baseDN: (TRString *) base
+        attributes: (TRArray *) attributes;
+- (TRLDAPSearchEnumerator *) enumerateSearchWithFilter: (TRString *) filter
+        scope: (int) scope
+        baseDN: (TRString *) base
+        attributes: (TRArray *) attributes
+        sizeLimit: (int) sizeLimit
+        timeLimit: (int) timeLimit
+        pageSize: (int) pageSize;
+- (TRLDAPEntry *) nextEntryForSearch: (int) msgid finished: (BOOL *) finished succeeded: (BOOL *) succeeded;
+- (TRLDAPEntry *) nextEntryForSearch: (int) msgid cookie: (struct berval *) cookie finished: (BOOL *) finished succeeded: (BOOL *) succeeded;
+- (TRString *) dnOfEntry: (LDAPMessage *) entry;
+- (TRArray *) attributesOfEntry: (LDAPMessage *) entry;
+- (void) abandon: (int) msgid;
+- (int) descriptor;
+
+- (unsigned long) operationCount;
+
+- (TRLDAPServer *) server;
+- (void) setServer: (TRLDAPServer *) server;
+- (void) beginLease;
+- (double) leaseMilliseconds;
+
+/* syncrepl */
+- (BOOL) startSyncWithBaseDN: (TRString *) base cookie: (TRString *) cookie delegate: (id <TRLDAPSyncDelegate>) delegate;
+- (BOOL) pollSyncWithTimeout: (int) seconds;
+- (TRString *) syncCookie;
+- (void) endSync;
+
 - (BOOL) setReferralEnabled: (BOOL) enabled;
 - (BOOL) setTLSCACertFile: (TRString *) fileName;
 - (BOOL) setTLSCACertDir: (TRString *) directory;
 - (BOOL) setTLSClientCert: (TRString *) certFile keyFile: (TRString *) keyFile;
 - (BOOL) setTLSCipherSuite: (TRString *) cipherSuite;
+- (BOOL) createTLSContext;
+
+- (void) enableTLSResumption;
+- (void) saveTLSSession;
 
 @end
 
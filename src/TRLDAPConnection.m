@@ -30,17 +30,28 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
 #import <stdlib.h>
 #import <string.h>
 #import <sys/time.h>
+#import <poll.h>
 
 #import "TRLDAPConnection.h"
+#import "TRLDAPSearchEnumerator.h"
 #import "TRLog.h"
 
-#import "xmalloc.h"
+#ifdef HAVE_LDAP_SYNC
+#import <ldap_sync.h>
+#endif
 
-/* Maximum number of unique attributes returned for a given entry. */
-#define MAX_ATTRIBUTES 2048
+#ifdef HAVE_LDAP_TLS_RESUMPTION
+#import <openssl/ssl.h>
+#endif
+
+#import "xmalloc.h"
 
 static int ldap_get_errno(LDAP *ld) {
     int err;
@@ -56,8 +67,77 @@ static int ldap_get_errno(LDAP *ld) {
 - (void) log: (loglevel_t) level withLDAPError: (int) error message: (char *) message;
 - (BOOL) setLDAPOption: (int) opt value: (const char *) value connection: (LDAP *) ldapConn;
 - (BOOL) setTLSRequireCert;
+- (void) checkConnectionError: (int) error;
+- (BOOL) discardAbandonedResults;
+- (char **) attributeArray: (TRArray *) attributes;
+- (TRArray *) entriesFromMessage: (LDAPMessage *) res;
+- (void) syncEntry: (LDAPMessage *) entry phase: (int) phase;
+- (void) syncLostTrack;
+- (void) syncEndedWithResult: (LDAPMessage *) result;
+- (void) deliverSyncLostTrack;
 @end
 
+#ifdef HAVE_LDAP_SYNC
+
+/* syncrepl callbacks; ls_private is the connection */
+static int sync_search_entry (ldap_sync_t *ls, LDAPMessage *msg, struct berval *entryUUID, ldap_sync_refresh_t phase) {
+    [(TRLDAPConnection *) ls->ls_private syncEntry: msg phase: phase];
+    return LDAP_SUCCESS;
+}
+
+static int sync_search_reference (ldap_sync_t *ls, LDAPMessage *msg) {
+    return LDAP_SUCCESS;
+}
+
+static int sync_intermediate (ldap_sync_t *ls, LDAPMessage *msg, BerVarray syncUUIDs, ldap_sync_refresh_t phase) {
+    switch (phase) {
+        case LDAP_SYNC_CAPI_DELETES_IDSET:
+        case LDAP_SYNC_CAPI_PRESENTS:
+        case LDAP_SYNC_CAPI_PRESENTS_IDSET:
+            /* Deleted entries are identified only by UUID, or only by
+             * their absence from the set of present entries */
+            [(TRLDAPConnection *) ls->ls_private syncLostTrack];
+            break;
+        default:
+            break;
+    }
+    return LDAP_SUCCESS;
+}
+
+static int sync_search_result (ldap_sync_t *ls, LDAPMessage *msg, int refreshDeletes) {
+    [(TRLDAPConnection *) ls->ls_private syncEndedWithResult: msg];
+    return LDAP_SUCCESS;
+}
+
+#endif /* HAVE_LDAP_SYNC */
+
+#ifdef HAVE_LDAP_TLS_RESUMPTION
+
+/* Called by libldap before each TLS handshake; offers the saved session */
+static int tls_connect_callback (LDAP *ld, void *ssl, void *ctx, void *arg) {
+    if (arg)
+        SSL_set_session(ssl, arg);
+    return 0;
+}
+
+/* Sessions may only be resumed with libldap's OpenSSL TLS backend */
+static BOOL tls_backend_is_openssl (void) {
+#ifdef LDAP_OPT_X_TLS_PACKAGE
+    char *package = NULL;
+    BOOL openssl = NO;
+
+    if (ldap_get_option(NULL, LDAP_OPT_X_TLS_PACKAGE, &package) == LDAP_OPT_SUCCESS && package) {
+        openssl = (strcmp(package, "OpenSSL") == 0);
+        ldap_memfree(package);
+    }
+    return openssl;
+#else
+    return YES;
+#endif
+}
+
+#endif /* HAVE_LDAP_TLS_RESUMPTION */
+
 @implementation TRLDAPConnection (Private)
 
 /**
@@ -105,6 +185,195 @@ static int ldap_get_errno(LDAP *ld) {
     return (true);
 }
 
+/**
+ * Mark the connection as unusable if the given error indicates that the
+ * session with the server has been lost or is otherwise suspect.
+ */
+- (void) checkConnectionError: (int) error {
+    switch (error) {
+        case LDAP_SERVER_DOWN:
+        case LDAP_CONNECT_ERROR:
+        case LDAP_TIMEOUT:
+        case LDAP_UNAVAILABLE:
+        case LDAP_BUSY:
+        case LDAP_ENCODING_ERROR:
+        case LDAP_DECODING_ERROR:
+            _valid = NO;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Read and discard any results that have arrived for abandoned requests.
+ * @return: YES if no other data is pending on the connection.
+ */
+- (BOOL) discardAbandonedResults {
+    struct timeval timeout;
+    struct pollfd pfd;
+    LDAPMessage *res = NULL;
+
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 0;
+
+    /* libldap drops results for abandoned requests as they are read */
+    if (ldap_result(ldapConn, LDAP_RES_ANY, 1, &timeout, &res) != 0) {
+        /* An unexpected result, or an error */
+        if (res)
+            ldap_msgfree(res);
+        return NO;
+    }
+
+    pfd.fd = [self descriptor];
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return (pfd.fd >= 0 && poll(&pfd, 1, 0) == 0);
+}
+
+/**
+ * Build a NULL-terminated array of attribute names suitable for
+ * ldap_search_ext(). Returns NULL (all attributes) if attributes is nil.
+ * The caller is responsible for freeing the returned array.
+ */
+- (char **) attributeArray: (TRArray *) attributes {
+    TREnumerator *iter;
+    TRString *attrString;
+    char **attrArray;
+    int count = 0;
+
+    if (!attributes)
+        return NULL;
+
+    attrArray = xmalloc(sizeof(char *) * ([attributes count] + 1));
+    iter = [attributes objectEnumerator];
+    while ((attrString = [iter nextObject]) != nil) {
+        attrArray[count] = (char *) [attrString cString];
+        count++;
+    }
+    attrArray[count] = NULL;
+
+    return attrArray;
+}
+
+/**
+ * Load the entries contained in a search result chain.
+ * The result chain is not freed.
+ * @return: An array of TRLDAPEntry instances, or nil if no entries were returned.
+ */
+- (TRArray *) entriesFromMessage: (LDAPMessage *) res {
+    LDAPMessage *entry;
+    TRArray *entries;
+    int numEntries;
+
+    /* Get the number of returned entries */
+    if ((numEntries = ldap_count_entries(ldapConn, res)) == -1) {
+        [TRLog debug: "ldap_count_entries failed: %d: %s", numEntries, ldap_err2string(numEntries)];
+        return nil;
+    }
+
+    /* If 0, return nil */
+    if (numEntries == 0)
+        return nil;
+
+    /* Allocate an array to hold entries */
+    entries = [[TRArray alloc] initWithCapacity: numEntries];
+    /* Grab attributes and values for each entry */
+    for (entry = ldap_first_entry(ldapConn, res); entry != NULL; entry = ldap_next_entry(ldapConn, entry)) {
+        TRLDAPEntry *ldapEntry;
+        TRArray *ldapAttributes;
+        TRString *dn;
+
+        dn = [self dnOfEntry: entry];
+        ldapAttributes = [self attributesOfEntry: entry];
+
+        /* Instantiate our entry */
+        ldapEntry = [[TRLDAPEntry alloc] initWithDN: dn attributePairs: ldapAttributes];
+
+        /* Pass our entry off to the entries array */
+        [entries addObject: ldapEntry];
+        [ldapEntry release];
+    }
+
+    return [entries autorelease];
+}
+
+/**
+ * Report an entry changed by a syncrepl session to the delegate.
+ */
+- (void) syncEntry: (LDAPMessage *) entry phase: (int) phase {
+#ifdef HAVE_LDAP_SYNC
+    TRString *dn;
+    char *dnCString;
+
+    /* Unchanged */
+    if (phase == LDAP_SYNC_CAPI_PRESENT)
+        return;
+
+    if (_syncSuppressEntries)
+        return;
+
+    dnCString = ldap_get_dn(ldapConn, entry);
+    if (!dnCString)
+        return;
+
+    dn = [[TRString alloc] initWithCString: dnCString];
+    ldap_memfree(dnCString);
+
+    [_syncDelegate ldapSyncEntryChanged: dn];
+    [dn release];
+#endif
+}
+
+/**
+ * Note that changes reported by a syncrepl session can not be attributed
+ * to individual entries. The delegate is told once the current
+ * operation completes.
+ */
+- (void) syncLostTrack {
+    if (!_syncSuppressEntries)
+        _syncLostTrack = YES;
+}
+
+/**
+ * Note the end of a syncrepl session, which persists until abandoned
+ * unless the server ends it.
+ */
+- (void) syncEndedWithResult: (LDAPMessage *) result {
+#ifdef HAVE_LDAP_SYNC
+    ldap_sync_t *ls = _sync;
+    int err;
+
+    _syncEnded = YES;
+
+    if (ldap_parse_result(ldapConn, result, &err, NULL, NULL, NULL, NULL, 0) != LDAP_SUCCESS)
+        err = LDAP_OTHER;
+
+    if (err == LDAP_SYNC_REFRESH_REQUIRED) {
+        /* The server can not resume from our cookie; start afresh */
+        if (ls->ls_cookie.bv_val) {
+            ldap_memfree(ls->ls_cookie.bv_val);
+            ls->ls_cookie.bv_val = NULL;
+            ls->ls_cookie.bv_len = 0;
+        }
+    } else {
+        [self log: TRLOG_WARNING withLDAPError: err message: "LDAP syncrepl session ended"];
+    }
+
+    _syncLostTrack = YES;
+#endif
+}
+
+/**
+ * Tell the delegate of any lost changes.
+ */
+- (void) deliverSyncLostTrack {
+    if (_syncLostTrack) {
+        _syncLostTrack = NO;
+        [_syncDelegate ldapSyncLostTrack];
+    }
+}
+
 @end
 
 /*
@@ -129,6 +398,7 @@ static int ldap_get_errno(LDAP *ld) {
     }
 
     _timeout = timeout;
+    _valid = YES;
 
     ldapTimeout.tv_sec = _timeout;
     ldapTimeout.tv_usec = 0;
@@ -148,10 +418,19 @@ static int ldap_get_errno(LDAP *ld) {
 
 - (void) dealloc {
     int err;
+
+    [self endSync];
+    [_server release];
+
     err = ldap_unbind_ext_s(ldapConn, NULL, NULL);
     if (err != LDAP_SUCCESS) {
         [self log: TRLOG_WARNING withLDAPError: err message: "Unable to unbind from LDAP server"];
     }
+
+#ifdef HAVE_LDAP_TLS_RESUMPTION
+    if (_tlsResumeSession)
+        SSL_SESSION_free(_tlsResumeSession);
+#endif
     [super dealloc];
 }
 
@@ -162,6 +441,7 @@ static int ldap_get_errno(LDAP *ld) {
     int err;
     err = ldap_start_tls_s(ldapConn, NULL, NULL);
     if (err != LDAP_SUCCESS) {
+        _valid = NO;
         [self log: TRLOG_ERR withLDAPError: err message: "Unable to enable STARTTLS"];
         return (NO);
     }
@@ -169,6 +449,49 @@ static int ldap_get_errno(LDAP *ld) {
     return (YES);
 }
 
+/**
+ * Cheaply determine whether the connection may be reused, without
+ * issuing a request to the server.
+ *
+ * A connection is considered invalid if a prior operation failed with a
+ * connection-level error, or if the server has closed (or sent a notice of
+ * disconnection over) the otherwise idle socket.
+ */
+- (BOOL) isValid {
+    struct pollfd pfd;
+    int fd = -1;
+
+    if (!_valid)
+        return (NO);
+
+    /* Not yet connected; nothing to validate */
+    if (ldap_get_option(ldapConn, LDAP_OPT_DESC, &fd) != LDAP_OPT_SUCCESS || fd < 0)
+        return (YES);
+
+    /* An idle LDAP connection should never have data pending */
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 0) != 0) {
+        /* Unless it is the late result of an abandoned request */
+        if (_abandoned && [self discardAbandonedResults])
+            return (YES);
+
+        _valid = NO;
+        return (NO);
+    }
+
+    return (YES);
+}
+
+/**
+ * Mark the connection as unusable, eg, after a request went
+ * unanswered. The connection will be discarded on checkin.
+ */
+- (void) invalidate {
+    _valid = NO;
+}
+
 - (BOOL) bindWithDN: (TRString *) bindDN password: (TRString *) password {
     int msgid, err;
     LDAPMessage *res;
@@ -192,6 +515,7 @@ static int ldap_get_errno(LDAP *ld) {
         return (false);
     }
 
+    _operationCount++;
     if ((err = ldap_sasl_bind(ldapConn,
                     [bindDN cString],
                     LDAP_SASL_SIMPLE,
@@ -199,6 +523,7 @@ static int ldap_get_errno(LDAP *ld) {
                     NULL,
                     NULL,
                     &msgid)) != LDAP_SUCCESS) {
+        [self checkConnectionError: err];
         [self log: TRLOG_ERR withLDAPError: err message: "LDAP bind failed immediately"];
         return (false);
     }
@@ -210,6 +535,7 @@ static int ldap_get_errno(LDAP *ld) {
         err = ldap_get_errno(ldapConn);
         if (err == LDAP_TIMEOUT)
             ldap_abandon_ext(ldapConn, msgid, NULL, NULL);
+        [self checkConnectionError: err];
         [self log: TRLOG_ERR withLDAPError: err message: "LDAP bind failed"];
         return (false);
     }
@@ -242,12 +568,33 @@ static int ldap_get_errno(LDAP *ld) {
     return (false);
 }
 
+/**
+ * Run an LDAP search, returning at most TRLDAP_DEFAULT_SIZE_LIMIT entries.
+ * @param filter: LDAP search filter.
+ * @param scope: LDAP scope (LDAP_SCOPE_BASE, LDAP_SCOPE_ONE, or LDAP_SCOPE_SUBTREE)
+ * @param base: LDAP search base DN.
+ * @param attributes: Attributes to return. If nil, returns all attributes.
+ * @return: An array of TRLDAPEntry instances.
+ */
+- (TRArray *)
+    searchWithFilter: (TRString *) filter
+    scope: (int) scope
+    baseDN: (TRString *) base
+    attributes: (TRArray *) attributes
+{
+    return [self searchWithFilter: filter scope: scope baseDN: base attributes: attributes sizeLimit: TRLDAP_DEFAULT_SIZE_LIMIT timeLimit: 0];
+}
+
 /**
  * Run an LDAP search.
  * @param filter: LDAP search filter.
  * @param scope: LDAP scope (LDAP_SCOPE_BASE, LDAP_SCOPE_ONE, or LDAP_SCOPE_SUBTREE)
  * @param base: LDAP search base DN.
  * @param attributes: Attributes to return. If nil, returns all attributes.
+ * @param sizeLimit: Maximum number of entries the server may return; 0 for
+ * the server's own limit.
+ * @param timeLimit: Maximum number of seconds the server may spend on the
+ * search; 0 to use the connection timeout.
  * @return: An array of TRLDAPEntry instances.
  */
 - (TRArray *)
@@ -255,142 +602,578 @@ static int ldap_get_errno(LDAP *ld) {
     scope: (int) scope
     baseDN: (TRString *) base
     attributes: (TRArray *) attributes
+    sizeLimit: (int) sizeLimit
+    timeLimit: (int) timeLimit
 {
-    TREnumerator *iter;
-    LDAPMessage *res;
-    LDAPMessage *entry;
-    char *attr;
-    struct berval **vals;
+    return [self searchWithFilter: filter scope: scope baseDN: base attributes: attributes sizeLimit: sizeLimit timeLimit: timeLimit succeeded: NULL];
+}
 
+/**
+ * Run an LDAP search, distinguishing a failed search from one that
+ * found no entries.
+ * @param succeeded: If not NULL, set to YES if the search succeeded.
+ * @return: An array of TRLDAPEntry instances, or nil if the search
+ * failed or returned no entries.
+ */
+- (TRArray *)
+    searchWithFilter: (TRString *) filter
+    scope: (int) scope
+    baseDN: (TRString *) base
+    attributes: (TRArray *) attributes
+    sizeLimit: (int) sizeLimit
+    timeLimit: (int) timeLimit
+    succeeded: (BOOL *) succeeded
+{
+    LDAPMessage *res;
     TRArray *entries;
-
     struct timeval timeout;
-
     char **attrArray;
-    TRString *attrString;
-
-    int count;
-    int numEntries;
     int err;
 
-    count = 0;
     entries = nil;
+    if (succeeded)
+        *succeeded = NO;
 
-    /* Build the attrArray */
-    if (attributes) {
-        attrArray = xmalloc(sizeof(char *) * [attributes count]);
-        iter = [attributes objectEnumerator];
-        while ((attrString = [iter nextObject]) != nil) {
-            attrArray[count] = (char *) [attrString cString];
-            count++;
-        }
-    } else {
-        /* Return all attributes */
-        attrArray = NULL;
-    }
+    /* Build the NULL-terminated attrArray */
+    attrArray = [self attributeArray: attributes];
 
-    /* Set up the timeout */
-    timeout.tv_sec = _timeout;
+    /* Set up the timeout. This is also sent to the server as the search
+     * time limit. */
+    timeout.tv_sec = timeLimit > 0 ? timeLimit : _timeout;
     timeout.tv_usec = 0;
 
     /* MISSING:
      * Support for user-specified 'attrOnly' mode.
-     * Non-hardcoded size limit.
      */
-    if ((err = ldap_search_ext_s(ldapConn, [base cString], scope, [filter cString], attrArray, 0, NULL, NULL, &timeout, 1024, &res)) != LDAP_SUCCESS) {
+    _operationCount++;
+    if ((err = ldap_search_ext_s(ldapConn, [base cString], scope, [filter cString], attrArray, 0, NULL, NULL, &timeout, sizeLimit, &res)) != LDAP_SUCCESS) {
+        [self checkConnectionError: err];
         [self log: TRLOG_ERR withLDAPError: err message: "LDAP search failed"];
         goto finish;
     }
 
-    /* Get the number of returned entries */
-    if ((numEntries = ldap_count_entries(ldapConn, res)) == -1) {
-        [TRLog debug: "ldap_count_entries failed: %d: %s", numEntries, ldap_err2string(numEntries)];
+    if (succeeded)
+        *succeeded = YES;
+    entries = [self entriesFromMessage: res];
+
+    /* free memory allocated for search results */
+    ldap_msgfree(res);
+
+finish:
+    if (attrArray)
+        free(attrArray);
+    return entries;
+}
+
+/**
+ * Send an LDAP search without waiting for the result, allowing
+ * multiple requests to be outstanding on the connection at once.
+ * At most TRLDAP_DEFAULT_SIZE_LIMIT entries are returned.
+ * The result must be collected with receiveResult: and
+ * entriesFromSearchResult:, or discarded with abandon:.
+ * @param filter: LDAP search filter.
+ * @param scope: LDAP scope (LDAP_SCOPE_BASE, LDAP_SCOPE_ONE, or LDAP_SCOPE_SUBTREE)
+ * @param base: LDAP search base DN.
+ * @param attributes: Attributes to return. If nil, returns all attributes.
+ * @return: The request's message ID, or -1 if the request could not be sent.
+ */
+- (int)
+    sendSearchWithFilter: (TRString *) filter
+    scope: (int) scope
+    baseDN: (TRString *) base
+    attributes: (TRArray *) attributes
+{
+    return [self sendSearchWithFilter: filter scope: scope baseDN: base attributes: attributes sizeLimit: TRLDAP_DEFAULT_SIZE_LIMIT timeLimit: 0];
+}
+
+/**
+ * Send an LDAP search without waiting for the result.
+ * @param sizeLimit: Maximum number of entries the server may return; 0 for
+ * the server's own limit.
+ * @param timeLimit: Maximum number of seconds the server may spend on the
+ * search; 0 for the server's own limit.
+ * @return: The request's message ID, or -1 if the request could not be sent.
+ */
+- (int)
+    sendSearchWithFilter: (TRString *) filter
+    scope: (int) scope
+    baseDN: (TRString *) base
+    attributes: (TRArray *) attributes
+    sizeLimit: (int) sizeLimit
+    timeLimit: (int) timeLimit
+{
+    return [self sendSearchWithFilter: filter scope: scope baseDN: base attributes: attributes sizeLimit: sizeLimit timeLimit: timeLimit pageSize: 0 cookie: NULL];
+}
+
+/**
+ * Send an LDAP search without waiting for the result, optionally
+ * requesting a single page of results (RFC 2696). The cookie returned
+ * with each page by nextEntryForSearch:cookie:finished:succeeded: must be
+ * supplied to request the following page. When paging is unsupported by
+ * the LDAP library, the page size is ignored and all results are returned
+ * at once.
+ * @param sizeLimit: Maximum number of entries the server may return; 0 for
+ * the server's own limit.
+ * @param timeLimit: Maximum number of seconds the server may spend on the
+ * search; 0 for the server's own limit.
+ * @param pageSize: Number of entries per page, or 0 to disable paging.
+ * @param cookie: The previous page's cookie, or NULL for the first page.
+ * @return: The request's message ID, or -1 if the request could not be sent.
+ */
+- (int)
+    sendSearchWithFilter: (TRString *) filter
+    scope: (int) scope
+    baseDN: (TRString *) base
+    attributes: (TRArray *) attributes
+    sizeLimit: (int) sizeLimit
+    timeLimit: (int) timeLimit
+    pageSize: (int) pageSize
+    cookie: (struct berval *) cookie
+{
+    LDAPControl *serverControls[2] = { NULL, NULL };
+    struct timeval timeout;
+    struct timeval *timeoutp;
+    char **attrArray;
+    int msgid;
+    int err;
+
+#ifdef HAVE_LDAP_PAGED_RESULTS
+    if (pageSize > 0) {
+        if ((err = ldap_create_page_control(ldapConn, pageSize, cookie, 0, &serverControls[0])) != LDAP_SUCCESS) {
+            [self log: TRLOG_ERR withLDAPError: err message: "Unable to create LDAP paged results control"];
+            return -1;
+        }
+    }
+#endif
+
+    /* Only send a time limit when one was requested */
+    timeoutp = NULL;
+    if (timeLimit > 0) {
+        timeout.tv_sec = timeLimit;
+        timeout.tv_usec = 0;
+        timeoutp = &timeout;
+    }
+
+    attrArray = [self attributeArray: attributes];
+
+    _operationCount++;
+    err = ldap_search_ext(ldapConn, [base cString], scope, [filter cString], attrArray, 0, serverControls, NULL, timeoutp, sizeLimit, &msgid);
+
+    if (attrArray)
+        free(attrArray);
+    if (serverControls[0])
+        ldap_control_free(serverControls[0]);
+
+    if (err != LDAP_SUCCESS) {
+        [self checkConnectionError: err];
+        [self log: TRLOG_ERR withLDAPError: err message: "LDAP search failed"];
+        return -1;
+    }
+
+    return msgid;
+}
+
+/**
+ * Send an LDAP compare without waiting for the result.
+ * The result must be collected with receiveResult: and
+ * compareResult:, or discarded with abandon:.
+ * @return: The request's message ID, or -1 if the request could not be sent.
+ */
+- (int) sendCompareDN: (TRString *) dn withAttribute: (TRString *) attribute value: (TRString *) value {
+    struct berval bval;
+    int msgid;
+    int err;
+
+    /* Set up the ber structure for our value */
+    bval.bv_val = (char *) [value cString];
+    bval.bv_len = [value length] - 1; /* Length includes NULL terminator */
+
+    _operationCount++;
+    if ((err = ldap_compare_ext(ldapConn, [dn cString], [attribute cString], &bval, NULL, NULL, &msgid)) != LDAP_SUCCESS) {
+        [self checkConnectionError: err];
+        [TRLog debug: "LDAP compare failed: %d: %s", err, ldap_err2string(err)];
+        return -1;
+    }
+
+    return msgid;
+}
+
+/**
+ * Wait for the next complete result of any outstanding request.
+ * @param msgid: On success, set to the message ID of the completed request.
+ * @return: The result, which must be passed to entriesFromSearchResult:
+ * or compareResult:, or NULL if no result arrived before the timeout or
+ * an error occured. Outstanding requests should then be abandoned.
+ */
+- (LDAPMessage *) receiveResult: (int *) msgid {
+    struct timeval timeout;
+    LDAPMessage *res;
+    int err;
+
+    /* Set up the timeout */
+    timeout.tv_sec = _timeout;
+    timeout.tv_usec = 0;
+
+    if (ldap_result(ldapConn, LDAP_RES_ANY, 1, &timeout, &res) <= 0) {
+        err = ldap_get_errno(ldapConn);
+        [self checkConnectionError: err];
+
+        [TRLog debug: "ldap_result failed: %s", ldap_err2string(err)];
+        return NULL;
+    }
+
+    *msgid = ldap_msgid(res);
+    return res;
+}
+
+/**
+ * Wait up to the given time for the next complete result of any
+ * outstanding request. Unlike receiveResult:, a timeout does not
+ * mark the connection as unusable.
+ * @param result: On success, set to the result, which must be passed to
+ * entriesFromSearchResult: or compareResult:.
+ * @param milliseconds: Maximum time to wait; 0 polls without waiting.
+ * @return: 1 if a result was received, 0 if none arrived in time, or
+ * -1 if an error occured.
+ */
+- (int) pollResult: (LDAPMessage **) result waitMilliseconds: (int) milliseconds {
+    struct timeval timeout;
+    int err;
+
+    timeout.tv_sec = milliseconds / 1000;
+    timeout.tv_usec = (milliseconds % 1000) * 1000;
+
+    switch (ldap_result(ldapConn, LDAP_RES_ANY, 1, &timeout, result)) {
+        case 0:
+            return 0;
+        case -1:
+            err = ldap_get_errno(ldapConn);
+            [self checkConnectionError: err];
+            [TRLog debug: "ldap_result failed: %s", ldap_err2string(err)];
+            return -1;
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Load the entries returned by a search sent with sendSearchWithFilter:.
+ * The result is freed.
+ * @return: An array of TRLDAPEntry instances, or nil if the search
+ * failed or returned no entries.
+ */
+- (TRArray *) entriesFromSearchResult: (LDAPMessage *) result {
+    return [self entriesFromSearchResult: result succeeded: NULL];
+}
+
+/**
+ * Load the entries returned by a search sent with sendSearchWithFilter:,
+ * distinguishing a failed search from one that found no entries.
+ * The result is freed.
+ * @param succeeded: If not NULL, set to YES if the search succeeded.
+ * @return: An array of TRLDAPEntry instances, or nil if the search
+ * failed or returned no entries.
+ */
+- (TRArray *) entriesFromSearchResult: (LDAPMessage *) result succeeded: (BOOL *) succeeded {
+    TRArray *entries = nil;
+    int err;
+
+    if (succeeded)
+        *succeeded = NO;
+
+    if (ldap_parse_result(ldapConn, result, &err, NULL, NULL, NULL, NULL, 0) != LDAP_SUCCESS) {
+        /* Parsing failed */
         goto finish;
     }
 
-    /* If 0, return nil */
-    if (numEntries == 0) {
-        ldap_msgfree(res);
+    if (err != LDAP_SUCCESS) {
+        [self checkConnectionError: err];
+        [self log: TRLOG_ERR withLDAPError: err message: "LDAP search failed"];
         goto finish;
     }
 
-    /* Allocate an array to hold entries */
-    entries = [[TRArray alloc] init];
-    /* Grab attributes and values for each entry */
-    for (entry = ldap_first_entry(ldapConn, res); entry != NULL; entry = ldap_next_entry(ldapConn, entry)) {
-        TRLDAPEntry *ldapEntry;
-        TRHash *ldapAttributes;
-        BerElement *ptr;
-        int maxCapacity = MAX_ATTRIBUTES;
-        TRString *dn;
-        char *dnCString;
-
-        ldapAttributes = [[TRHash alloc] initWithCapacity: maxCapacity];
-
-        /* Grab our entry's DN */
-        dnCString = ldap_get_dn(ldapConn, entry);
-        dn = [[TRString alloc] initWithCString: dnCString];
-        ldap_memfree(dnCString);
-        
-        /* Load all attributes and associated values */
-        for (attr = ldap_first_attribute(ldapConn, entry, &ptr); attr != NULL; attr = ldap_next_attribute(ldapConn, entry, ptr)) {
-            TRString *attrName;
-            TRString *valueString;
-            TRArray *attrValues;
-            int i;
-
-            /* Don't exceed the maximum capacity of the hash table */
-            if(--maxCapacity == 0) {
-                [TRLog error: "Over %d LDAP attributes returned for a single entry. Ignoring any remaining attributes.", MAX_ATTRIBUTES];
-                break;
-            }
+    if (succeeded)
+        *succeeded = YES;
+    entries = [self entriesFromMessage: result];
+
+finish:
+    ldap_msgfree(result);
+    return entries;
+}
+
+/**
+ * Start a search, returning an enumerator that yields each entry as the
+ * server returns it, rather than waiting for the complete result set.
+ * At most TRLDAP_DEFAULT_SIZE_LIMIT entries are returned.
+ * Entry attributes are decoded when first accessed. The connection
+ * should not be used for other requests, or returned to a pool, until
+ * the enumerator has been exhausted or released.
+ * @param filter: LDAP search filter.
+ * @param scope: LDAP scope (LDAP_SCOPE_BASE, LDAP_SCOPE_ONE, or LDAP_SCOPE_SUBTREE)
+ * @param base: LDAP search base DN.
+ * @param attributes: Attributes to return. If nil, returns all attributes.
+ * @return: An autoreleased enumerator of TRLDAPEntry instances, or nil if
+ * the search could not be sent.
+ */
+- (TRLDAPSearchEnumerator *)
+    enumerateSearchWithFilter: (TRString *) filter
+    scope: (int) scope
+    baseDN: (TRString *) base
+    attributes: (TRArray *) attributes
+{
+    return [self enumerateSearchWithFilter: filter scope: scope baseDN: base attributes: attributes sizeLimit: TRLDAP_DEFAULT_SIZE_LIMIT timeLimit: 0 pageSize: 0];
+}
+
+/**
+ * Start a search, returning an enumerator that yields each entry as the
+ * server returns it. If a page size is given, the results are requested
+ * one page at a time (RFC 2696), and the next page is only requested
+ * once the previous page has been consumed.
+ * @param sizeLimit: Maximum number of entries the server may return for
+ * each request; 0 for the server's own limit.
+ * @param timeLimit: Maximum number of seconds the server may spend on each
+ * request; 0 for the server's own limit.
+ * @param pageSize: Number of entries per page, or 0 to disable paging.
+ * @return: An autoreleased enumerator of TRLDAPEntry instances, or nil if
+ * the search could not be sent.
+ */
+- (TRLDAPSearchEnumerator *)
+    enumerateSearchWithFilter: (TRString *) filter
+    scope: (int) scope
+    baseDN: (TRString *) base
+    attributes: (TRArray *) attributes
+    sizeLimit: (int) sizeLimit
+    timeLimit: (int) timeLimit
+    pageSize: (int) pageSize
+{
+    TRLDAPSearchEnumerator *iter;
+
+    iter = [[TRLDAPSearchEnumerator alloc] initWithConnection: self
+        filter: filter
+        scope: scope
+        baseDN: base
+        attributes: attributes
+        sizeLimit: sizeLimit
+        timeLimit: timeLimit
+        pageSize: pageSize];
+
+    return [iter autorelease];
+}
+
+/**
+ * Receive the next entry returned by a search sent with
+ * sendSearchWithFilter:. Search references are skipped.
+ * @param msgid: The search's message ID.
+ * @param finished: Set to YES once the search has completed, failed or
+ * timed out; no further entries will be returned. A search that times
+ * out is abandoned.
+ * @param succeeded: Set to YES if the search completed successfully.
+ * @return: The next entry, or nil if the search has finished. The entry's
+ * attributes are decoded when first accessed.
+ */
+- (TRLDAPEntry *) nextEntryForSearch: (int) msgid finished: (BOOL *) finished succeeded: (BOOL *) succeeded {
+    return [self nextEntryForSearch: msgid cookie: NULL finished: finished succeeded: succeeded];
+}
 
-            attrName = [[TRString alloc] initWithCString: attr];
-            attrValues = [[TRArray alloc] init];
-
-            vals = ldap_get_values_len(ldapConn, entry, attr);
-            if (vals) {
-                for (i = 0; vals[i] != NULL; i++) {
-                    /* XXX: This could be binary. This is not the end of the world, but a braindead
-                     * client of this API could do something dumb. There doesn't seem to be any sane
-                     * way to determine whether data is binary or non-binary. At the very least, we
-                     * enforce NULL termination by turning the data into a string. */
-                    valueString = [[TRString alloc] initWithBytes: vals[i]->bv_val numBytes: vals[i]->bv_len];
-                    /* Pass our value string to the attrValues array */
-                    [attrValues addObject: valueString];
-                    [valueString release];
+/**
+ * Receive the next entry returned by a search, as with
+ * nextEntryForSearch:finished:succeeded:.
+ * @param cookie: If not NULL, set to the paged results cookie returned
+ * when a paged search completes. The cookie is empty once the final page
+ * has been returned. Any previous value is freed.
+ */
+- (TRLDAPEntry *) nextEntryForSearch: (int) msgid cookie: (struct berval *) cookie finished: (BOOL *) finished succeeded: (BOOL *) succeeded {
+    struct timeval timeout;
+    LDAPMessage *res;
+    LDAPControl **controls;
+    TRLDAPEntry *entry;
+    int err;
+
+    *finished = NO;
+    *succeeded = NO;
+
+    timeout.tv_sec = _timeout;
+    timeout.tv_usec = 0;
+
+    while (1) {
+        switch (ldap_result(ldapConn, msgid, LDAP_MSG_ONE, &timeout, &res)) {
+            case -1:
+            case 0:
+                err = ldap_get_errno(ldapConn);
+                [self checkConnectionError: err];
+                [self log: TRLOG_ERR withLDAPError: err message: "LDAP search failed"];
+                [self abandon: msgid];
+                *finished = YES;
+                return nil;
+
+            case LDAP_RES_SEARCH_ENTRY:
+                /* The entry takes ownership of the message */
+                entry = [[TRLDAPEntry alloc] initWithMessage: res connection: self];
+                return [entry autorelease];
+
+            case LDAP_RES_SEARCH_RESULT:
+                *finished = YES;
+                controls = NULL;
+                if (ldap_parse_result(ldapConn, res, &err, NULL, NULL, NULL, cookie ? &controls : NULL, 1) != LDAP_SUCCESS)
+                    return nil;
+
+                if (err != LDAP_SUCCESS) {
+                    if (controls)
+                        ldap_controls_free(controls);
+                    [self checkConnectionError: err];
+                    [self log: TRLOG_ERR withLDAPError: err message: "LDAP search failed"];
+                    return nil;
                 }
-                ldap_value_free_len(vals);
-            }
 
-            /* Pass our attribute string and array of values to the
-             * entryAttributes hash table */
-            [ldapAttributes setObject: attrValues forKey: attrName];
-            [attrName release];
-            [attrValues release];
-            ldap_memfree(attr);
+                if (cookie) {
+                    if (cookie->bv_val)
+                        ber_memfree(cookie->bv_val);
+                    cookie->bv_val = NULL;
+                    cookie->bv_len = 0;
+                }
+
+#ifdef HAVE_LDAP_PAGED_RESULTS
+                /* Save the cookie for the next page, if any */
+                if (controls) {
+                    LDAPControl *pageControl;
+                    ber_int_t estimate;
+
+                    pageControl = ldap_control_find(LDAP_CONTROL_PAGEDRESULTS, controls, NULL);
+                    if (pageControl && ldap_parse_pageresponse_control(ldapConn, pageControl, &estimate, cookie) != LDAP_SUCCESS) {
+                        [TRLog error: "Unable to parse the LDAP paged results control."];
+                        ldap_controls_free(controls);
+                        return nil;
+                    }
+                }
+#endif
+
+                if (controls)
+                    ldap_controls_free(controls);
+                *succeeded = YES;
+                return nil;
+
+            default:
+                /* Search references, and anything else, are ignored */
+                ldap_msgfree(res);
+                break;
         }
+    }
+}
+
+/**
+ * Return the DN of a single entry from a search result.
+ */
+- (TRString *) dnOfEntry: (LDAPMessage *) entry {
+    TRString *dn;
+    char *dnCString;
+
+    dnCString = ldap_get_dn(ldapConn, entry);
+    if (!dnCString)
+        return nil;
+
+    dn = [[TRString alloc] initWithCString: dnCString];
+    ldap_memfree(dnCString);
+
+    return [dn autorelease];
+}
+
+/**
+ * Decode the attributes of a single entry from a search result.
+ * @return: An array of alternating attribute names and arrays of
+ * TRString values, suitable for TRLDAPEntry's initWithDN:attributePairs:.
+ */
+- (TRArray *) attributesOfEntry: (LDAPMessage *) entry {
+    TRArray *ldapAttributes;
+    BerElement *ptr;
+    struct berval **vals;
+    char *attr;
+
+    ldapAttributes = [[TRArray alloc] init];
+
+    /* Load all attributes and associated values */
+    for (attr = ldap_first_attribute(ldapConn, entry, &ptr); attr != NULL; attr = ldap_next_attribute(ldapConn, entry, ptr)) {
+        TRString *attrName;
+        TRString *valueString;
+        TRArray *attrValues;
+        int i;
+
+        attrName = [[TRString alloc] initWithCString: attr];
+        attrValues = [[TRArray alloc] init];
+
+        vals = ldap_get_values_len(ldapConn, entry, attr);
+        if (vals) {
+            for (i = 0; vals[i] != NULL; i++) {
+                /* XXX: This could be binary. This is not the end of the world, but a braindead
+                 * client of this API could do something dumb. There doesn't seem to be any sane
+                 * way to determine whether data is binary or non-binary. At the very least, we
+                 * enforce NULL termination by turning the data into a string. */
+                valueString = [[TRString alloc] initWithBytes: vals[i]->bv_val numBytes: vals[i]->bv_len];
+                /* Pass our value string to the attrValues array */
+                [attrValues addObject: valueString];
+                [valueString release];
+            }
+            ldap_value_free_len(vals);
+        }
+
+        /* Pass our attribute string and array of values to the
+         * attribute list */
+        [ldapAttributes addObject: attrName];
+        [ldapAttributes addObject: attrValues];
+        [attrName release];
+        [attrValues release];
+        ldap_memfree(attr);
+    }
 
-        /* Free ber ptr */
+    /* Free ber ptr */
+    if (ptr)
         ber_free(ptr, 0);
 
-        /* Instantiate our entry */
-        ldapEntry = [[TRLDAPEntry alloc] initWithDN: dn attributes: ldapAttributes];
-        [dn release];
-        [ldapAttributes release];
+    return [ldapAttributes autorelease];
+}
 
-        /* Pass our entry off to the entries array */
-        [entries addObject: ldapEntry];
-        [ldapEntry release];
+/**
+ * Check the result of a compare sent with sendCompareDN:.
+ * The result is freed.
+ * @return: YES if the compare matched.
+ */
+- (BOOL) compareResult: (LDAPMessage *) result {
+    int err;
+
+    if (ldap_parse_result(ldapConn, result, &err, NULL, NULL, NULL, NULL, 1) != LDAP_SUCCESS) {
+        /* Parsing failed */
+        return NO;
     }
 
-    /* free memory allocated for search results */
-    ldap_msgfree(res);
+    if (err == LDAP_COMPARE_TRUE)
+        return YES;
 
-finish:
-    if (attrArray)
-        free(attrArray);
-    return [entries autorelease];
+    if (err != LDAP_COMPARE_FALSE) {
+        [self checkConnectionError: err];
+        [TRLog debug: "LDAP compare failed: %d: %s", err, ldap_err2string(err)];
+    }
+
+    return NO;
+}
+
+/**
+ * Abandon an outstanding request; its result will never be returned
+ * by receiveResult:.
+ */
+- (void) abandon: (int) msgid {
+    _abandoned = YES;
+    ldap_abandon_ext(ldapConn, msgid, NULL, NULL);
+}
+
+/**
+ * Return the connection's socket descriptor, or -1 if the connection
+ * has not yet been established.
+ */
+- (int) descriptor {
+    int fd = -1;
+
+    if (ldap_get_option(ldapConn, LDAP_OPT_DESC, &fd) != LDAP_OPT_SUCCESS)
+        return -1;
+    return fd;
 }
 
 - (BOOL) compare: (TRString *) dn withAttribute: (TRString *) attribute value: (TRString *) value {
@@ -409,7 +1192,9 @@ finish:
     timeout.tv_usec = 0;
 
     /* Perform the compare */
+    _operationCount++;
     if ((err = ldap_compare_ext(ldapConn, [dn cString], [attribute cString], &bval, NULL, NULL, &msgid)) != LDAP_SUCCESS) {
+        [self checkConnectionError: err];
         [TRLog debug: "LDAP compare failed: %d: %s", err, ldap_err2string(err)];
         return NO;
     }
@@ -419,6 +1204,7 @@ finish:
         err = ldap_get_errno(ldapConn);
         if (err == LDAP_TIMEOUT)
             ldap_abandon_ext(ldapConn, msgid, NULL, NULL);
+        [self checkConnectionError: err];
 
         [TRLog debug: "ldap_compare_ext failed: %s", ldap_err2string(err)];
         return NO;
@@ -453,7 +1239,9 @@ finish:
     timeout.tv_usec = 0;
 
     /* Perform the compare */
+    _operationCount++;
     if ((err = ldap_compare_ext(ldapConn, [dn cString], [attribute cString], &bval, NULL, NULL, &msgid)) != LDAP_SUCCESS) {
+        [self checkConnectionError: err];
         [TRLog debug: "LDAP compare failed: %d: %s", err, ldap_err2string(err)];
         return NO;
     }
@@ -463,6 +1251,7 @@ finish:
         err = ldap_get_errno(ldapConn);
         if (err == LDAP_TIMEOUT)
             ldap_abandon_ext(ldapConn, msgid, NULL, NULL);
+        [self checkConnectionError: err];
 
         [TRLog debug: "ldap_compare_ext failed: %s", ldap_err2string(err)];
         return NO;
@@ -481,6 +1270,202 @@ finish:
     return NO;
 }
 
+/**
+ * Returns the number of LDAP requests (binds, searches and compares)
+ * sent on this connection.
+ */
+- (unsigned long) operationCount {
+    return _operationCount;
+}
+
+/**
+ * Returns the server this connection was opened to, or nil.
+ */
+- (TRLDAPServer *) server {
+    return _server;
+}
+
+/**
+ * Set the server this connection was opened to.
+ */
+- (void) setServer: (TRLDAPServer *) server {
+    [server retain];
+    [_server release];
+    _server = server;
+}
+
+/**
+ * Record the start of a lease of this connection, eg, by a pool.
+ */
+- (void) beginLease {
+    gettimeofday(&_leaseStart, NULL);
+}
+
+/**
+ * Returns the time elapsed since -beginLease, in milliseconds.
+ */
+- (double) leaseMilliseconds {
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - _leaseStart.tv_sec) * 1000.0 +
+        (now.tv_usec - _leaseStart.tv_usec) / 1000.0;
+}
+
+/**
+ * Start an RFC 4533 syncrepl session in refreshAndPersist mode, reporting
+ * changes to every entry under base to the delegate. Only one session
+ * may be active on a connection, and the connection should not be used
+ * for other requests until the session is ended.
+ *
+ * Returns once the session's initial refresh has completed. If no cookie
+ * is supplied, the initial refresh lists every entry; rather than report
+ * each of them as changed, the delegate is told that it has lost track.
+ *
+ * @param base: Base DN of the synchronized subtree.
+ * @param cookie: Cookie from a previous session's -syncCookie, or nil.
+ * @param delegate: Receives changes. Retained until the session ends.
+ * @return: NO if the session could not be started.
+ */
+- (BOOL) startSyncWithBaseDN: (TRString *) base cookie: (TRString *) cookie delegate: (id <TRLDAPSyncDelegate>) delegate {
+#ifdef HAVE_LDAP_SYNC
+    ldap_sync_t *ls;
+    struct berval bv;
+    int err;
+
+    [self endSync];
+
+    ls = ldap_sync_initialize(NULL);
+    if (!ls) {
+        [TRLog error: "Unable to allocate an LDAP syncrepl session."];
+        return NO;
+    }
+
+    /* Only the DN of each changed entry is used */
+    ls->ls_base = ldap_strdup([base cString]);
+    ls->ls_scope = LDAP_SCOPE_SUBTREE;
+    ls->ls_filter = ldap_strdup("(objectClass=*)");
+    ls->ls_attrs = ldap_memcalloc(2, sizeof(char *));
+    ls->ls_attrs[0] = ldap_strdup(LDAP_NO_ATTRS);
+
+    ls->ls_search_entry = sync_search_entry;
+    ls->ls_search_reference = sync_search_reference;
+    ls->ls_intermediate = sync_intermediate;
+    ls->ls_search_result = sync_search_result;
+    ls->ls_private = self;
+    ls->ls_ld = ldapConn;
+
+    if (cookie) {
+        bv.bv_val = (char *) [cookie cString];
+        bv.bv_len = [cookie length] - 1; /* Length includes NULL terminator */
+        ber_dupbv(&ls->ls_cookie, &bv);
+    }
+
+    _sync = ls;
+    _syncDelegate = [delegate retain];
+    _syncSuppressEntries = (cookie == nil);
+    _syncLostTrack = NO;
+    _syncEnded = NO;
+
+    _operationCount++;
+    err = ldap_sync_init(ls, LDAP_SYNC_REFRESH_AND_PERSIST);
+
+    _syncSuppressEntries = NO;
+
+    if (err != LDAP_SUCCESS || _syncEnded) {
+        if (err != LDAP_SUCCESS) {
+            [self checkConnectionError: err];
+            [self log: TRLOG_ERR withLDAPError: err message: "LDAP syncrepl session failed"];
+        }
+        [self endSync];
+        return NO;
+    }
+
+    /* Anything cached before a full refresh may be stale */
+    if (!cookie)
+        _syncLostTrack = YES;
+
+    [self deliverSyncLostTrack];
+    return YES;
+#else
+    [TRLog error: "LDAP syncrepl is not supported by this build."];
+    return NO;
+#endif
+}
+
+/**
+ * Wait up to seconds for changes on the syncrepl session, reporting
+ * them to the delegate.
+ * @return: NO if the session has ended or failed, in which case it
+ * should be ended, and may be resumed with its -syncCookie.
+ */
+- (BOOL) pollSyncWithTimeout: (int) seconds {
+#ifdef HAVE_LDAP_SYNC
+    ldap_sync_t *ls = _sync;
+    int err;
+
+    if (!ls)
+        return NO;
+
+    ls->ls_timeout = seconds;
+    err = ldap_sync_poll(ls);
+    if (err == -1)
+        err = ldap_get_errno(ldapConn);
+
+    [self deliverSyncLostTrack];
+
+    if (err != LDAP_SUCCESS) {
+        [self checkConnectionError: err];
+        [self log: TRLOG_WARNING withLDAPError: err message: "LDAP syncrepl session failed"];
+        return NO;
+    }
+
+    return !_syncEnded;
+#else
+    return NO;
+#endif
+}
+
+/**
+ * Returns the syncrepl session's current cookie, from which a later
+ * session may resume, or nil if there is none.
+ */
+- (TRString *) syncCookie {
+#ifdef HAVE_LDAP_SYNC
+    ldap_sync_t *ls = _sync;
+
+    if (!ls || !ls->ls_cookie.bv_val)
+        return nil;
+
+    return [[[TRString alloc] initWithBytes: ls->ls_cookie.bv_val numBytes: ls->ls_cookie.bv_len] autorelease];
+#else
+    return nil;
+#endif
+}
+
+/**
+ * End the syncrepl session, if any.
+ */
+- (void) endSync {
+#ifdef HAVE_LDAP_SYNC
+    ldap_sync_t *ls = _sync;
+
+    if (!ls)
+        return;
+
+    if (!_syncEnded && ls->ls_msgid > 0)
+        ldap_abandon_ext(ldapConn, ls->ls_msgid, NULL, NULL);
+
+    /* The connection remains ours; don't let the session unbind it */
+    ls->ls_ld = NULL;
+    ldap_sync_destroy(ls, 1);
+
+    _sync = NULL;
+    [_syncDelegate release];
+    _syncDelegate = nil;
+#endif
+}
+
 - (BOOL) setReferralEnabled: (BOOL) enabled {
     if (enabled)
         return [self setLDAPOption: LDAP_OPT_REFERRALS value: LDAP_OPT_ON connection: ldapConn];
@@ -513,4 +1498,81 @@ finish:
     return [self setLDAPOption: LDAP_OPT_X_TLS_CIPHER_SUITE value: [cipherSuite cString] connection: ldapConn];
 }
 
+/**
+ * Offer the most recent TLS session saved for this connection's server
+ * (see -saveTLSSession) for resumption when the connection performs its
+ * TLS handshake, either with STARTTLS or for an ldaps:// URL. Must be
+ * called after -setServer:, and before the connection is used.
+ */
+- (void) enableTLSResumption {
+#ifdef HAVE_LDAP_TLS_RESUMPTION
+    if (!_server || !tls_backend_is_openssl())
+        return;
+
+    if (_tlsResumeSession) {
+        SSL_SESSION_free(_tlsResumeSession);
+        _tlsResumeSession = NULL;
+    }
+
+    if (!(_tlsResumeSession = [_server copyTLSSession]))
+        return;
+
+    if (ldap_set_option(ldapConn, LDAP_OPT_X_TLS_CONNECT_ARG, _tlsResumeSession) != LDAP_OPT_SUCCESS ||
+        ldap_set_option(ldapConn, LDAP_OPT_X_TLS_CONNECT_CB, (void *) tls_connect_callback) != LDAP_OPT_SUCCESS)
+    {
+        [TRLog debug: "Unable to enable TLS session resumption."];
+    }
+#endif
+}
+
+/**
+ * Save the connection's TLS session with its server, for resumption by
+ * later connections. The first call after the TLS handshake also records
+ * whether a previous session was resumed. May be called again once the
+ * connection has been used, as TLS 1.3 servers only send resumable
+ * session tickets after the handshake.
+ */
+- (void) saveTLSSession {
+#ifdef HAVE_LDAP_TLS_RESUMPTION
+    SSL_SESSION *session;
+    SSL *ssl = NULL;
+
+    if (!_server || !tls_backend_is_openssl())
+        return;
+
+    if (ldap_get_option(ldapConn, LDAP_OPT_X_TLS_SSL_CTX, &ssl) != LDAP_OPT_SUCCESS || !ssl)
+        return;
+
+    if (!_tlsHandshakeRecorded) {
+        [_server recordTLSHandshake: SSL_session_reused(ssl) ? YES : NO];
+        _tlsHandshakeRecorded = YES;
+    }
+
+    if (!(session = SSL_get1_session(ssl)))
+        return;
+
+    if (SSL_SESSION_is_resumable(session))
+        [_server setTLSSession: session];
+    SSL_SESSION_free(session);
+#endif
+}
+
+/**
+ * Build the shared TLS context from the TLS options set so far, loading
+ * the CA certificates and client key pair. Connections opened afterwards
+ * use the new context; existing sessions are unaffected.
+ */
+- (BOOL) createTLSContext {
+#ifdef LDAP_OPT_X_TLS_NEWCTX
+    int isServer = 0;
+    int err;
+
+    if ((err = ldap_set_option(NULL, LDAP_OPT_X_TLS_NEWCTX, &isServer)) != LDAP_SUCCESS) {
+        [TRLog error: "Unable to create TLS context: %d: %s", err, ldap_err2string(err)];
+        return (NO);
+    }
+#endif
+    return (YES);
+}
+
 @end
@@ -0,0 +1,787 @@
+/*
+ * TRLDAPConnectionPool.m vi:ts=4:sw=4:expandtab:
+ * Pool of reusable LDAP connections
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <string.h>
+#import <sys/time.h>
+#import <poll.h>
+
+#import "TRLDAPConnectionPool.h"
+#import "TRLog.h"
+
+#import "xmalloc.h"
+
+/*
+ * The referral and TLS settings are applied once to libldap's global option
+ * set, and shared by every connection. Connections may be opened
+ * concurrently by worker threads, so serialize access.
+ */
+static pthread_mutex_t global_options_lock = PTHREAD_MUTEX_INITIALIZER;
+static BOOL global_options_applied = NO;
+
+/* Percentile of a server's response times after which a search is hedged */
+#define HEDGE_PERCENTILE 95
+
+/* A search racing against the same search on another server */
+typedef struct hedged_request {
+    TRLDAPConnection *ldap;
+    int msgid;
+    struct timeval sent;
+    BOOL active;
+} hedged_request;
+
+/* Milliseconds elapsed since the given time */
+static double elapsed_ms (struct timeval *since) {
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - since->tv_sec) * 1000.0 +
+        (now.tv_usec - since->tv_usec) / 1000.0;
+}
+
+/*
+ * Private Methods
+ */
+@interface TRLDAPConnectionPool (Private)
+- (int) selectServerExcluding: (BOOL *) tried;
+- (int) indexOfServer: (TRLDAPServer *) server;
+- (TRLDAPConnection *) openConnectionToServer: (TRLDAPServer *) server;
+- (TRLDAPConnection *) popIdleConnection: (unsigned int) index;
+- (BOOL) applyGlobalOptionsWithConnection: (TRLDAPConnection *) ldap;
+- (TRLDAPConnection *) checkoutExcluding: (BOOL *) tried;
+- (TRArray *) raceRequests: (hedged_request *) requests count: (int) count deadline: (struct timeval *) deadline succeeded: (BOOL *) succeeded;
+- (void) discard: (TRLDAPConnection *) ldap;
+@end
+
+@implementation TRLDAPConnectionPool (Private)
+
+/**
+ * Select the server with the lowest load that has not already been tried,
+ * and that admits the request. Ejected servers, and servers with MaxInFlight
+ * requests outstanding, are skipped. If every remaining server has been
+ * ejected, the one whose ejection ends first is selected, unless FailFast
+ * is enabled.
+ * @return The index of the selected server, or -1 if none may be used.
+ */
+- (int) selectServerExcluding: (BOOL *) tried {
+    unsigned int maxInFlight = [_config maxInFlight];
+    unsigned int i;
+    BOOL saturated = NO;
+    int best;
+    double bestLoad = 0;
+    time_t bestUntil = 0;
+
+    do {
+        best = -1;
+        for (i = 0; i < _serverCount; i++) {
+            double load;
+
+            if (tried[i] || ![_servers[i] isAvailable])
+                continue;
+
+            if (maxInFlight > 0 && [_servers[i] outstanding] >= maxInFlight) {
+                saturated = YES;
+                continue;
+            }
+
+            load = [_servers[i] load];
+            if (best < 0 || load < bestLoad) {
+                best = i;
+                bestLoad = load;
+            }
+        }
+
+        if (best >= 0) {
+            if ([_servers[best] admitRequest])
+                return best;
+
+            /* Another request is already checking the server's health */
+            tried[best] = YES;
+        }
+    } while (best >= 0);
+
+    /* Shed load, rather than queue behind a saturated or failing directory */
+    if (saturated || [_config failFast])
+        return -1;
+
+    for (i = 0; i < _serverCount; i++) {
+        time_t until;
+
+        if (tried[i])
+            continue;
+
+        until = [_servers[i] ejectedUntil];
+        if (best < 0 || until < bestUntil) {
+            best = i;
+            bestUntil = until;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Return the index of the given server, or -1 if it does not belong
+ * to this pool.
+ */
+- (int) indexOfServer: (TRLDAPServer *) server {
+    unsigned int i;
+
+    for (i = 0; i < _serverCount; i++) {
+        if (_servers[i] == server)
+            return i;
+    }
+
+    return -1;
+}
+
+/**
+ * Open, configure and bind a new LDAP connection to the given server.
+ * Connection-level failures are recorded against the server.
+ * @return A new connection, or nil on failure. It is the caller's
+ * responsibility to release the returned connection.
+ */
+- (TRLDAPConnection *) openConnectionToServer: (TRLDAPServer *) server {
+    TRLDAPConnection *ldap;
+    BOOL applied;
+
+    /* Initialize our LDAP Connection */
+    ldap = [[TRLDAPConnection alloc] initWithURL: [server url] timeout: [_config timeout]];
+    if (!ldap) {
+        [TRLog error: "Unable to open LDAP connection to %s\n", [[server url] cString]];
+        return nil;
+    }
+    [ldap setServer: server];
+    [ldap enableTLSResumption];
+
+    /* Apply the shared options, unless already done by -applyGlobalOptions */
+    pthread_mutex_lock(&global_options_lock);
+    applied = global_options_applied || [self applyGlobalOptionsWithConnection: ldap];
+    pthread_mutex_unlock(&global_options_lock);
+
+    if (!applied) {
+        [ldap release];
+        return nil;
+    }
+
+    /* Start TLS */
+    if ([_config tlsEnabled])
+        if (![ldap startTLS])
+            goto error;
+
+    /* Bind if requested */
+    if (_serviceBind && [_config bindDN]) {
+        if (![ldap bindWithDN: [_config bindDN] password: [_config bindPassword]]) {
+            [TRLog error: "Unable to bind as %s", [[_config bindDN] cString]];
+            goto error;
+        }
+    }
+
+    [ldap saveTLSSession];
+    return ldap;
+
+    error:
+    /* Only failures to reach the server count against it; an
+     * invalid BindDN or password is not the server's fault */
+    if (![ldap isValid])
+        [server recordFailure];
+    [ldap release];
+    return nil;
+}
+
+/**
+ * Remove and return the most recently used idle connection to the
+ * server at the given index, if any. The caller is responsible for
+ * releasing the returned connection.
+ */
+- (TRLDAPConnection *) popIdleConnection: (unsigned int) index {
+    TRLDAPConnection *ldap = nil;
+
+    pthread_mutex_lock(&_lock);
+    if ([_idle[index] count] > 0) {
+        ldap = [[_idle[index] lastObject] retain];
+        [_idle[index] removeObject];
+        _idleCount--;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    return ldap;
+}
+
+/**
+ * Apply the referral and TLS settings to libldap's global option set, and
+ * build the TLS context shared by all connections. The caller must hold
+ * global_options_lock.
+ * @param ldap Any connection; the options are not specific to it.
+ */
+- (BOOL) applyGlobalOptionsWithConnection: (TRLDAPConnection *) ldap {
+    TRString *value;
+
+    /* Referrals */
+    if ([_config referralEnabled]) {
+        if (![ldap setReferralEnabled: YES])
+            return NO;
+    } else {
+        if (![ldap setReferralEnabled: NO])
+            return NO;
+    }
+
+    /* Certificate file */
+    if ((value = [_config tlsCACertFile]))
+        if (![ldap setTLSCACertFile: value])
+            return NO;
+
+    /* Certificate directory */
+    if ((value = [_config tlsCACertDir]))
+        if (![ldap setTLSCACertDir: value])
+            return NO;
+
+    /* Client Certificate Pair */
+    if ([_config tlsCertFile] && [_config tlsKeyFile])
+        if(![ldap setTLSClientCert: [_config tlsCertFile] keyFile: [_config tlsKeyFile]])
+            return NO;
+
+    /* Cipher suite */
+    if ((value = [_config tlsCipherSuite]))
+        if(![ldap setTLSCipherSuite: value])
+            return NO;
+
+    /* Load the certificates and key once, now, rather than on the
+     * first TLS handshake */
+    if ([_config tlsEnabled])
+        if (![ldap createTLSContext])
+            return NO;
+
+    global_options_applied = YES;
+    return YES;
+}
+
+/**
+ * Acquire a connection to the least loaded server that has not already
+ * been tried, failing over to the remaining servers as necessary.
+ * @return An autoreleased connection, or nil.
+ */
+- (TRLDAPConnection *) checkoutExcluding: (BOOL *) tried {
+    TRLDAPConnection *ldap = nil;
+    int i;
+
+    while ((i = [self selectServerExcluding: tried]) >= 0) {
+        tried[i] = YES;
+
+        /* Prefer an idle connection */
+        while ((ldap = [self popIdleConnection: i]) != nil) {
+            if ([ldap isValid])
+                break;
+
+            [TRLog debug: "Discarding stale pooled LDAP connection."];
+            [ldap release];
+        }
+
+        /* None available, open a new one */
+        if (!ldap)
+            ldap = [self openConnectionToServer: _servers[i]];
+
+        if (ldap)
+            break;
+    }
+
+    if (!ldap)
+        return nil;
+
+    [_servers[i] acquire];
+    [ldap beginLease];
+    return [ldap autorelease];
+}
+
+/**
+ * Drop a connection acquired via -checkout without returning it to the
+ * pool, and without recording a success or failure against its server.
+ */
+- (void) discard: (TRLDAPConnection *) ldap {
+    int i;
+
+    i = [self indexOfServer: [ldap server]];
+    if (i >= 0)
+        [_servers[i] relinquish];
+}
+
+/**
+ * Wait for the first successful answer to any of the given searches,
+ * until the deadline. Requests that fail are dropped from the race;
+ * the losers remain active, and must be abandoned by the caller.
+ * @param succeeded: Set to YES if any of the searches succeeded.
+ * @return The winning search's entries, or nil.
+ */
+- (TRArray *) raceRequests: (hedged_request *) requests count: (int) count deadline: (struct timeval *) deadline succeeded: (BOOL *) succeeded {
+    struct pollfd pfds[2];
+    LDAPMessage *res;
+    TRArray *entries;
+    double remaining;
+    int i, nfds;
+
+    *succeeded = NO;
+
+    while ((remaining = -elapsed_ms(deadline)) > 0) {
+        nfds = 0;
+        for (i = 0; i < count; i++) {
+            hedged_request *req = &requests[i];
+
+            if (!req->active)
+                continue;
+
+            /* libldap may have already read the result */
+            switch ([req->ldap pollResult: &res waitMilliseconds: 0]) {
+                case 0:
+                    pfds[nfds].fd = [req->ldap descriptor];
+                    pfds[nfds].events = POLLIN;
+                    pfds[nfds].revents = 0;
+                    if (pfds[nfds].fd >= 0)
+                        nfds++;
+                    continue;
+                case 1:
+                    req->active = NO;
+                    entries = [req->ldap entriesFromSearchResult: res succeeded: succeeded];
+                    if (*succeeded) {
+                        [[req->ldap server] addResponseTime: elapsed_ms(&req->sent)];
+                        return entries;
+                    }
+                    continue;
+                default:
+                    req->active = NO;
+                    continue;
+            }
+        }
+
+        if (nfds == 0)
+            break;
+
+        poll(pfds, nfds, (int) remaining + 1);
+    }
+
+    return nil;
+}
+
+@end
+
+/**
+ * Maintains a set of configured, bound LDAP connections that are kept
+ * open across plugin requests.
+ *
+ * Connections are handed out with -checkout and returned with -checkin:.
+ * Idle connections are validated before reuse; stale connections are
+ * discarded and replaced with a freshly opened connection.
+ *
+ * When several server URLs are configured, each checkout is directed to
+ * the server with the fewest outstanding requests, weighted by its
+ * observed latency. A server that can not be reached is ejected for a
+ * time (see TRLDAPServer), and the request fails over to the next best
+ * server.
+ */
+@implementation TRLDAPConnectionPool
+
+/**
+ * Initialize a new pool of connections bound with the configured
+ * service account (BindDN), if any.
+ * @param config Plugin configuration used to open new connections.
+ * @param maxIdle Maximum number of idle connections held by the pool.
+ */
+- (id) initWithConfig: (TRAuthLDAPConfig *) config maxIdleConnections: (unsigned int) maxIdle {
+    return [self initWithConfig: config maxIdleConnections: maxIdle serviceBind: YES];
+}
+
+/**
+ * Initialize a new pool.
+ * @param config Plugin configuration used to open new connections.
+ * @param maxIdle Maximum number of idle connections held by the pool.
+ * @param serviceBind If YES, new connections are bound with the configured
+ * BindDN. Pools used solely to verify user credentials should pass NO, as
+ * every checkout is immediately re-bound as the user.
+ */
+- (id) initWithConfig: (TRAuthLDAPConfig *) config maxIdleConnections: (unsigned int) maxIdle serviceBind: (BOOL) serviceBind {
+    TREnumerator *iter;
+    TRString *url;
+    unsigned int i;
+
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _config = [config retain];
+    _maxIdle = maxIdle;
+    _serviceBind = serviceBind;
+    pthread_mutex_init(&_lock, NULL);
+
+    /* One server per configured URL, in configuration order */
+    _serverCount = [[config urls] count];
+    if (_serverCount == 0) {
+        [TRLog error: "No LDAP server URL configured."];
+        [self release];
+        return nil;
+    }
+
+    _servers = xmalloc(sizeof(TRLDAPServer *) * _serverCount);
+    _idle = xmalloc(sizeof(TRArray *) * _serverCount);
+
+    iter = [[config urls] objectReverseEnumerator];
+    for (i = 0; i < _serverCount && (url = [iter nextObject]) != nil; i++) {
+        _servers[i] = [[TRLDAPServer alloc] initWithURL: url];
+        _idle[i] = [[TRArray alloc] init];
+    }
+
+    return self;
+}
+
+- (void) dealloc {
+    unsigned int i;
+
+    for (i = 0; i < _serverCount; i++) {
+        [_servers[i] release];
+        [_idle[i] release];
+    }
+    if (_servers)
+        free(_servers);
+    if (_idle)
+        free(_idle);
+
+    [_config release];
+    pthread_mutex_destroy(&_lock);
+    [super dealloc];
+}
+
+/**
+ * Open, configure and bind a new LDAP connection to the least loaded
+ * available server, failing over to the remaining servers as necessary.
+ * The connection is not tracked by the pool.
+ * @return A new connection, or nil on failure. It is the caller's
+ * responsibility to release the returned connection.
+ */
+- (TRLDAPConnection *) openConnection {
+    TRLDAPConnection *ldap = nil;
+    BOOL *tried;
+    int i;
+
+    tried = xmalloc(sizeof(BOOL) * _serverCount);
+    memset(tried, 0, sizeof(BOOL) * _serverCount);
+
+    while (!ldap && (i = [self selectServerExcluding: tried]) >= 0) {
+        tried[i] = YES;
+        ldap = [self openConnectionToServer: _servers[i]];
+    }
+
+    free(tried);
+    return ldap;
+}
+
+/**
+ * Acquire a connection from the pool, opening a new connection if no
+ * valid idle connection is available.
+ * @return An autoreleased connection, or nil if a new connection could
+ * not be established. Return the connection to the pool with -checkin:.
+ */
+- (TRLDAPConnection *) checkout {
+    TRLDAPConnection *ldap;
+    BOOL *tried;
+
+    tried = xmalloc(sizeof(BOOL) * _serverCount);
+    memset(tried, 0, sizeof(BOOL) * _serverCount);
+
+    ldap = [self checkoutExcluding: tried];
+
+    free(tried);
+    return ldap;
+}
+
+/**
+ * Return a connection acquired via -checkout to the pool. Connections that
+ * are no longer valid, or that exceed the pool's idle capacity, are dropped.
+ * The outcome and duration of the lease are recorded against the
+ * connection's server.
+ */
+- (void) checkin: (TRLDAPConnection *) ldap {
+    BOOL valid;
+    int i;
+
+    if (!ldap)
+        return;
+
+    valid = [ldap isValid];
+    i = [self indexOfServer: [ldap server]];
+    if (i < 0)
+        return;
+
+    [_servers[i] relinquish];
+    if (!valid) {
+        [_servers[i] recordFailure];
+        return;
+    }
+    [_servers[i] recordSuccessWithLatency: [ldap leaseMilliseconds]];
+    [ldap saveTLSSession];
+
+    pthread_mutex_lock(&_lock);
+    if (_idleCount < _maxIdle) {
+        [_idle[i] addObject: ldap];
+        _idleCount++;
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Apply the referral and TLS settings shared by all connections, and build
+ * the shared TLS context, loading the configured CA certificates and client
+ * key pair. Called implicitly before the first connection is opened; call
+ * again to reload certificates and keys that have changed on disk.
+ * Connections opened afterwards use the new settings.
+ * @return NO if the settings could not be applied.
+ */
+- (BOOL) applyGlobalOptions {
+    TRLDAPConnection *ldap;
+    BOOL applied;
+
+    /* libldap's option setters require a handle, but no connection is made */
+    ldap = [[TRLDAPConnection alloc] initWithURL: [_servers[0] url] timeout: [_config timeout]];
+    if (!ldap)
+        return NO;
+
+    pthread_mutex_lock(&global_options_lock);
+    global_options_applied = NO;
+    applied = [self applyGlobalOptionsWithConnection: ldap];
+    pthread_mutex_unlock(&global_options_lock);
+
+    [ldap release];
+    return applied;
+}
+
+/**
+ * Search using a connection checked out from this pool.
+ *
+ * If HedgeDelay is configured and the connection's server has not
+ * answered within the 95th percentile of its recent response times (or
+ * HedgeDelay, if greater), the search is repeated against another
+ * available server. The first successful answer is used, and the other
+ * request is abandoned. Hedging is bounded to the slowest few percent
+ * of searches, rather than doubling the load on the directory.
+ *
+ * @param sizeLimit: Maximum number of entries the server may return.
+ * @param timeLimit: Maximum number of seconds the server may spend on the
+ * search; 0 for no limit beyond the LDAP timeout.
+ * @param succeeded: Set to YES if the search succeeded, whether or not
+ * it returned any entries.
+ * @return An array of TRLDAPEntry instances, or nil if the search
+ * failed or returned no entries.
+ */
+- (TRArray *) searchWithConnection: (TRLDAPConnection *) ldap
+              filter: (TRString *) filter
+              scope: (int) scope
+              baseDN: (TRString *) base
+              attributes: (TRArray *) attributes
+              sizeLimit: (int) sizeLimit
+              timeLimit: (int) timeLimit
+              succeeded: (BOOL *) succeeded
+{
+    hedged_request requests[2];
+    TRLDAPConnection *hedge = nil;
+    TRLDAPServer *server = [ldap server];
+    TRArray *entries = nil;
+    struct timeval deadline;
+    LDAPMessage *res;
+    BOOL *tried;
+    BOOL hedgeTimedOut;
+    double delay;
+    unsigned int n;
+    int count = 1;
+    int i;
+
+    *succeeded = NO;
+
+    if ([_config hedgeDelay] == 0 || _serverCount < 2 || [self indexOfServer: server] < 0)
+        return [ldap searchWithFilter: filter scope: scope baseDN: base attributes: attributes sizeLimit: sizeLimit timeLimit: timeLimit succeeded: succeeded];
+
+    /* Send the primary request */
+    requests[0].ldap = ldap;
+    requests[0].active = YES;
+    gettimeofday(&requests[0].sent, NULL);
+    requests[0].msgid = [ldap sendSearchWithFilter: filter scope: scope baseDN: base attributes: attributes sizeLimit: sizeLimit timeLimit: timeLimit];
+    if (requests[0].msgid < 0)
+        return nil;
+
+    deadline = requests[0].sent;
+    deadline.tv_sec += [_config timeout];
+
+    /* Wait for the primary server's usual response time */
+    delay = [server responseTimePercentile: HEDGE_PERCENTILE];
+    if (delay < [_config hedgeDelay])
+        delay = [_config hedgeDelay];
+
+    switch ([ldap pollResult: &res waitMilliseconds: (int) delay]) {
+        case 1:
+            requests[0].active = NO;
+            entries = [ldap entriesFromSearchResult: res succeeded: succeeded];
+            if (*succeeded) {
+                [server addResponseTime: elapsed_ms(&requests[0].sent)];
+                return entries;
+            }
+            break;
+        case 0:
+            break;
+        default:
+            requests[0].active = NO;
+            break;
+    }
+
+    /* Slow (or failed); repeat the search against another available server */
+    tried = xmalloc(sizeof(BOOL) * _serverCount);
+    for (n = 0; n < _serverCount; n++)
+        tried[n] = (_servers[n] == server || ![_servers[n] isAvailable]);
+    hedge = [self checkoutExcluding: tried];
+    free(tried);
+
+    if (hedge) {
+        [TRLog debug: "Hedging LDAP search from %s to %s.", [[server url] cString], [[[hedge server] url] cString]];
+        requests[1].ldap = hedge;
+        requests[1].active = YES;
+        gettimeofday(&requests[1].sent, NULL);
+        requests[1].msgid = [hedge sendSearchWithFilter: filter scope: scope baseDN: base attributes: attributes sizeLimit: sizeLimit timeLimit: timeLimit];
+        if (requests[1].msgid >= 0)
+            count = 2;
+    }
+
+    entries = [self raceRequests: requests count: count deadline: &deadline succeeded: succeeded];
+    hedgeTimedOut = (count == 2 && requests[1].active && !*succeeded);
+
+    /* Abandon the loser */
+    for (i = 0; i < count; i++) {
+        if (!requests[i].active)
+            continue;
+        [requests[i].ldap abandon: requests[i].msgid];
+
+        /* Its response time is at least the time it has waited; without
+         * these samples, a server's percentile would only see its fast
+         * answers, and hedging would fire ever more often */
+        [[requests[i].ldap server] addResponseTime: elapsed_ms(&requests[i].sent)];
+
+        /* Unanswered at the deadline; the connection is dropped on checkin,
+         * and the primary's timeout counted against its server */
+        if (!*succeeded)
+            [requests[i].ldap invalidate];
+    }
+
+    /* The hedge was sent late, and may simply have run out of time;
+     * drop it without counting a failure against its server */
+    if (hedgeTimedOut)
+        [self discard: hedge];
+    else if (hedge)
+        [self checkin: hedge];
+
+    return entries;
+}
+
+/**
+ * Search for a user's entry with the configured SearchFilter and
+ * BaseDN, using a connection checked out from this pool. Only the
+ * entry's DN is requested.
+ * @param username: The user's name, as supplied by the client.
+ * @param notFound: Set to YES if the search succeeded, but found
+ * no such user.
+ * @return The user's entry, or nil. If the search returns more
+ * than one entry, the extras are ignored.
+ */
+- (TRLDAPEntry *) findUser: (const char *) username withConnection: (TRLDAPConnection *) ldap notFound: (BOOL *) notFound {
+    TRArray *ldapEntries;
+    TRArray *attributes;
+    BOOL succeeded;
+
+    *notFound = NO;
+
+    /* Only the DN is used */
+    attributes = [[[TRArray alloc] init] autorelease];
+    [attributes addObject: [TRString stringWithCString: LDAP_NO_ATTRS]];
+
+    /* Search! The search may be hedged against another server */
+    ldapEntries = [self searchWithConnection: ldap
+        filter: [[_config userSearchFilter] getFilterWithCString: username]
+        scope: LDAP_SCOPE_SUBTREE
+        baseDN: [_config baseDN]
+        attributes: attributes
+        sizeLimit: [_config sizeLimit]
+        timeLimit: [_config timeLimit]
+        succeeded: &succeeded];
+
+    if ([ldapEntries count] < 1) {
+        *notFound = succeeded;
+        return nil;
+    }
+
+    return [ldapEntries lastObject];
+}
+
+/**
+ * Return the number of idle connections currently held by the pool.
+ */
+- (unsigned int) idleCount {
+    unsigned int count;
+
+    pthread_mutex_lock(&_lock);
+    count = _idleCount;
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+/**
+ * Returns YES if at least one server has not been ejected, or has
+ * reached the end of its ejection.
+ */
+- (BOOL) hasAvailableServer {
+    unsigned int i;
+
+    for (i = 0; i < _serverCount; i++) {
+        if ([_servers[i] isAvailable])
+            return YES;
+    }
+
+    return NO;
+}
+
+/**
+ * Return the number of configured servers.
+ */
+- (unsigned int) serverCount {
+    return _serverCount;
+}
+
+/**
+ * Return the server at the given index, in configuration order.
+ */
+- (TRLDAPServer *) serverAtIndex: (unsigned int) index {
+    return _servers[index];
+}
+
+@end
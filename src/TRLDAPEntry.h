@@ -32,21 +32,44 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#import <ldap.h>
+
 #import "TRObject.h"
 #import "TRString.h"
+#import "TRArray.h"
 #import "TRHash.h"
 
+@class TRLDAPConnection;
+
 @interface TRLDAPEntry : TRObject {
 @private
     TRString *_dn;
     TRString *_rdn;
-    TRHash *_attributes;
+
+    /* Attributes, sorted case-insensitively by name */
+    struct _TRLDAPEntryAttribute *_attributes;
+    unsigned int _attributeCount;
+
+    /* Dictionary of the attributes, built on request */
+    TRHash *_attributeHash;
+
+    /* Undecoded search result and its connection, until the
+     * attributes are first requested */
+    LDAPMessage *_message;
+    TRLDAPConnection *_connection;
 }
 
++ (TRString *) normalizedDN: (TRString *) dn;
+
 - (id) initWithDN: (TRString *) dn attributes: (TRHash *) attributes;
+- (id) initWithDN: (TRString *) dn attributePairs: (TRArray *) pairs;
+- (id) initWithMessage: (LDAPMessage *) message connection: (TRLDAPConnection *) connection;
 - (TRString *) dn;
 - (TRString *) rdn;
 - (void) setRDN: (TRString *) rdn;
+- (unsigned int) attributeCount;
+- (TRArray *) valuesForAttribute: (TRString *) name;
+- (TRArray *) valuesForAttributeCString: (const char *) name;
 - (TRHash *) attributes;
 
 @end
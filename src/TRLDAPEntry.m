@@ -32,29 +32,194 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#import <stdlib.h>
+#import <strings.h>
+#import <ctype.h>
+
 #import "TRLDAPEntry.h"
+#import "TRLDAPConnection.h"
+
+#import "xmalloc.h"
+
+/* A single attribute, and its values */
+typedef struct _TRLDAPEntryAttribute {
+    TRString *name;
+    id values;
+} TRLDAPEntryAttribute;
+
+static int attribute_compare (const void *a, const void *b) {
+    const TRLDAPEntryAttribute *attrA = a;
+    const TRLDAPEntryAttribute *attrB = b;
+
+    return strcasecmp([attrA->name cString], [attrB->name cString]);
+}
+
+@interface TRLDAPEntry (Private)
+- (void) setAttributePairs: (TRArray *) pairs;
+- (void) decodeAttributes;
+@end
+
+@implementation TRLDAPEntry (Private)
+
+/**
+ * Replace the entry's attributes with the given alternating names and
+ * values. Storage is allocated once, sized to the number of attributes.
+ */
+- (void) setAttributePairs: (TRArray *) pairs {
+    TREnumerator *iter;
+    TRString *name;
+    unsigned int i;
+
+    _attributeCount = [pairs count] / 2;
+    if (_attributeCount == 0)
+        return;
+
+    _attributes = xmalloc(sizeof(TRLDAPEntryAttribute) * _attributeCount);
+
+    /* Walk the pairs in the order they were added */
+    i = 0;
+    iter = [pairs objectReverseEnumerator];
+    while ((name = [iter nextObject]) != nil && i < _attributeCount) {
+        _attributes[i].name = [name retain];
+        _attributes[i].values = [[iter nextObject] retain];
+        i++;
+    }
+
+    qsort(_attributes, _attributeCount, sizeof(TRLDAPEntryAttribute), attribute_compare);
+}
+
+/**
+ * Decode a lazily loaded entry's attributes, and release the message.
+ */
+- (void) decodeAttributes {
+    [self setAttributePairs: [_connection attributesOfEntry: _message]];
+    ldap_msgfree(_message);
+    _message = NULL;
+
+    [_connection release];
+    _connection = nil;
+}
+
+@end
 
 /**
  * An LDAP entry.
  */
 @implementation TRLDAPEntry
 
+/**
+ * Returns an autoreleased, canonical form of a DN, in which DNs that differ
+ * only in spacing, escaping or case are equal. Values that can not be
+ * parsed as a DN are returned in lower case.
+ */
++ (TRString *) normalizedDN: (TRString *) dn {
+    LDAPDN parsed = NULL;
+    TRString *result;
+    char *canonical = NULL;
+    char *p;
+
+    if (ldap_str2dn([dn cString], &parsed, LDAP_DN_FORMAT_LDAP) == LDAP_SUCCESS) {
+        if (ldap_dn2str(parsed, &canonical, LDAP_DN_FORMAT_LDAPV3) != LDAP_SUCCESS)
+            canonical = NULL;
+        ldap_dnfree(parsed);
+    }
+
+    if (canonical) {
+        result = [[TRString alloc] initWithCString: canonical];
+        ldap_memfree(canonical);
+    } else {
+        result = [[TRString alloc] initWithString: dn];
+    }
+
+    /* Attribute types and most values compare case-insensitively */
+    for (p = (char *) [result cString]; *p != '\0'; p++)
+        *p = tolower((unsigned char) *p);
+
+    return [result autorelease];
+}
+
+/**
+ * Initialize an entry with the given attribute dictionary. The
+ * attributes are copied into the entry's own storage.
+ */
 - (id) initWithDN: (TRString *) dn attributes: (TRHash *) attributes {
+    TREnumerator *iter;
+    TRArray *pairs;
+    TRString *name;
+
+    pairs = [[TRArray alloc] init];
+    iter = [attributes keyEnumerator];
+    while ((name = [iter nextObject]) != nil) {
+        [pairs addObject: name];
+        [pairs addObject: [attributes valueForKey: name]];
+    }
+
+    self = [self initWithDN: dn attributePairs: pairs];
+    [pairs release];
+
+    return self;
+}
+
+/**
+ * Initialize an entry with the given attributes.
+ * @param pairs: Alternating attribute names and arrays of values,
+ * as returned by TRLDAPConnection's attributesOfEntry:.
+ */
+- (id) initWithDN: (TRString *) dn attributePairs: (TRArray *) pairs {
     self = [self init];
     if (!self)
         return self;
 
     _dn = [dn retain];
     _rdn = nil;
-    _attributes = [attributes retain];
+    [self setAttributePairs: pairs];
+
+    return self;
+}
+
+/**
+ * Initialize an entry from a single search result entry, taking
+ * ownership of the message. Only the DN is decoded immediately; the
+ * attributes are decoded when first requested. Entries should be
+ * decoded before their connection is returned to a pool.
+ */
+- (id) initWithMessage: (LDAPMessage *) message connection: (TRLDAPConnection *) connection {
+    self = [self init];
+    if (!self) {
+        ldap_msgfree(message);
+        return self;
+    }
+
+    _dn = [[connection dnOfEntry: message] retain];
+    if (!_dn) {
+        ldap_msgfree(message);
+        [self release];
+        return nil;
+    }
+
+    _message = message;
+    _connection = [connection retain];
 
     return self;
 }
 
 - (void) dealloc {
+    unsigned int i;
+
+    if (_message)
+        ldap_msgfree(_message);
+
+    for (i = 0; i < _attributeCount; i++) {
+        [_attributes[i].name release];
+        [_attributes[i].values release];
+    }
+    if (_attributes)
+        free(_attributes);
+
+    [_connection release];
     [_dn release];
     [_rdn release];
-    [_attributes release];
+    [_attributeHash release];
     [super dealloc];
 }
 
@@ -70,14 +235,74 @@
 }
 
 - (void) setRDN: (TRString *) rdn {
-    _rdn=rdn;
+    [rdn retain];
+    [_rdn release];
+    _rdn = rdn;
 }
 
 /**
- * Return the entries' attributes as a dictionary.
+ * Returns the number of attributes.
+ */
+- (unsigned int) attributeCount {
+    if (_message)
+        [self decodeAttributes];
+
+    return _attributeCount;
+}
+
+/**
+ * Return the values of the named attribute, or nil if the entry
+ * has no such attribute. Attribute names are case-insensitive.
+ */
+- (TRArray *) valuesForAttribute: (TRString *) name {
+    return [self valuesForAttributeCString: [name cString]];
+}
+
+/**
+ * Return the values of the named attribute, or nil if the entry
+ * has no such attribute. Attribute names are case-insensitive.
+ */
+- (TRArray *) valuesForAttributeCString: (const char *) name {
+    unsigned int low, high, mid;
+    int result;
+
+    if (_message)
+        [self decodeAttributes];
+
+    /* Binary search of the sorted attributes */
+    low = 0;
+    high = _attributeCount;
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        result = strcasecmp(name, [_attributes[mid].name cString]);
+        if (result == 0)
+            return _attributes[mid].values;
+        else if (result < 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+
+    return nil;
+}
+
+/**
+ * Return the entries' attributes as a dictionary. The dictionary is
+ * built on first use; valuesForAttribute: is cheaper for lookups.
  */
 - (TRHash *) attributes {
-    return _attributes;
+    unsigned int i;
+
+    if (_message)
+        [self decodeAttributes];
+
+    if (!_attributeHash) {
+        _attributeHash = [[TRHash alloc] initWithCapacity: _attributeCount + 1];
+        for (i = 0; i < _attributeCount; i++)
+            [_attributeHash setObject: _attributes[i].values forKey: _attributes[i].name];
+    }
+
+    return _attributeHash;
 }
 
 @end
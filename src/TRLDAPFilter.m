@@ -0,0 +1,541 @@
+/*
+ * TRLDAPFilter.m vi:ts=4:sw=4:expandtab:
+ * Parsed RFC 4515 LDAP search filter
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <stdlib.h>
+#import <string.h>
+#import <strings.h>
+#import <ctype.h>
+
+#import "TRLDAPFilter.h"
+#import "TREnumerator.h"
+
+#import "xmalloc.h"
+
+/* Filter expression types */
+typedef enum {
+    FILTER_AND,
+    FILTER_OR,
+    FILTER_NOT,
+    FILTER_EQUALITY,
+    FILTER_APPROX,
+    FILTER_GREATER_OR_EQUAL,
+    FILTER_LESS_OR_EQUAL,
+    FILTER_PRESENT,
+    FILTER_SUBSTRINGS
+} filter_type;
+
+typedef struct tr_ldap_filter_node {
+    filter_type type;
+
+    /* Item filters */
+    char *attribute;
+    char *value;
+
+    /* Substring filters. Any of these may be NULL. */
+    char *initial;
+    char **any;
+    char *final;
+
+    /* AND, OR, and NOT filters */
+    struct tr_ldap_filter_node *children;
+
+    /* Next sibling */
+    struct tr_ldap_filter_node *next;
+} filter_node;
+
+static filter_node *parse_filter (const char **pp);
+
+/* Free a filter node, its children, and its siblings */
+static void free_filter (filter_node *node) {
+    filter_node *next;
+    char **p;
+
+    while (node) {
+        next = node->next;
+
+        free_filter(node->children);
+        free(node->attribute);
+        free(node->value);
+        free(node->initial);
+        free(node->final);
+        if (node->any) {
+            for (p = node->any; *p; p++)
+                free(*p);
+            free(node->any);
+        }
+        free(node);
+
+        node = next;
+    }
+}
+
+static int hex_value (char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* Returns the length of the escape sequence at p: \XX (RFC 4515), or \c (RFC 2254) */
+static size_t escape_length (const char *p, const char *end) {
+    if (end - p >= 3 && hex_value(p[1]) >= 0 && hex_value(p[2]) >= 0)
+        return 3;
+    if (end - p >= 2)
+        return 2;
+    return 1;
+}
+
+/* Return a newly allocated, unescaped copy of the assertion value [start, end) */
+static char *unescape_value (const char *start, const char *end) {
+    char *result = xmalloc(end - start + 1);
+    char *out = result;
+    const char *p = start;
+
+    while (p < end) {
+        if (*p == '\\') {
+            size_t len = escape_length(p, end);
+            if (len == 3)
+                *out++ = (char) (hex_value(p[1]) << 4 | hex_value(p[2]));
+            else if (len == 2)
+                *out++ = p[1];
+            p += len;
+        } else {
+            *out++ = *p++;
+        }
+    }
+    *out = '\0';
+
+    return result;
+}
+
+/* Split a substring assertion value [start, end) on its unescaped '*' characters */
+static void parse_substrings (filter_node *node, const char *start, const char *end) {
+    const char *segment = start;
+    const char *p = start;
+    unsigned int numAny = 0;
+
+    node->any = xmalloc(sizeof(char *) * ((end - start) / 2 + 2));
+
+    while (p <= end) {
+        if (p < end && *p == '\\') {
+            p += escape_length(p, end);
+            continue;
+        }
+
+        if (p == end || *p == '*') {
+            if (p > segment) {
+                char *value = unescape_value(segment, p);
+                if (segment == start)
+                    node->initial = value;
+                else if (p == end)
+                    node->final = value;
+                else
+                    node->any[numAny++] = value;
+            }
+            segment = p + 1;
+        }
+        p++;
+    }
+
+    node->any[numAny] = NULL;
+}
+
+/* Parse a simple item filter -- attr op value -- up to the closing parenthesis */
+static BOOL parse_item (filter_node *node, const char **pp) {
+    const char *p = *pp;
+    const char *attrStart = p;
+    const char *valueStart;
+    BOOL wildcard = NO;
+
+    /* Attribute description */
+    while (*p && !strchr("=~<>:()", *p))
+        p++;
+
+    /* Extensible match filters are not supported */
+    if (p == attrStart || *p == ':' || *p == '\0' || *p == '(' || *p == ')')
+        return NO;
+
+    node->attribute = xmalloc(p - attrStart + 1);
+    memcpy(node->attribute, attrStart, p - attrStart);
+    node->attribute[p - attrStart] = '\0';
+
+    /* Filter type */
+    switch (*p) {
+        case '=':
+            node->type = FILTER_EQUALITY;
+            p++;
+            break;
+        case '~':
+            node->type = FILTER_APPROX;
+            break;
+        case '>':
+            node->type = FILTER_GREATER_OR_EQUAL;
+            break;
+        case '<':
+            node->type = FILTER_LESS_OR_EQUAL;
+            break;
+    }
+    if (node->type != FILTER_EQUALITY) {
+        if (p[1] != '=')
+            return NO;
+        p += 2;
+    }
+
+    /* Assertion value */
+    valueStart = p;
+    while (*p && *p != ')' && *p != '(') {
+        if (*p == '\\') {
+            p += escape_length(p, p + strlen(p));
+            continue;
+        }
+        if (*p == '*')
+            wildcard = YES;
+        p++;
+    }
+    if (*p != ')')
+        return NO;
+
+    if (node->type == FILTER_EQUALITY && wildcard) {
+        if (p - valueStart == 1) {
+            node->type = FILTER_PRESENT;
+        } else {
+            node->type = FILTER_SUBSTRINGS;
+            parse_substrings(node, valueStart, p);
+        }
+    } else if (wildcard) {
+        /* Only equality filters may contain wildcards */
+        return NO;
+    } else {
+        node->value = unescape_value(valueStart, p);
+    }
+
+    *pp = p;
+    return YES;
+}
+
+/* Parse a parenthesized filter, advancing *pp past it. Returns NULL on error. */
+static filter_node *parse_filter (const char **pp) {
+    const char *p = *pp;
+    filter_node *node;
+    filter_node **tail;
+
+    if (*p != '(')
+        return NULL;
+    p++;
+
+    node = xmalloc(sizeof(filter_node));
+    memset(node, 0, sizeof(filter_node));
+
+    switch (*p) {
+        case '&':
+        case '|':
+            node->type = (*p == '&') ? FILTER_AND : FILTER_OR;
+            p++;
+
+            tail = &node->children;
+            while (*p == '(') {
+                if ((*tail = parse_filter(&p)) == NULL)
+                    goto error;
+                tail = &(*tail)->next;
+            }
+            break;
+        case '!':
+            node->type = FILTER_NOT;
+            p++;
+            if ((node->children = parse_filter(&p)) == NULL)
+                goto error;
+            break;
+        default:
+            if (!parse_item(node, &p))
+                goto error;
+            break;
+    }
+
+    if (*p != ')')
+        goto error;
+    p++;
+
+    *pp = p;
+    return node;
+
+error:
+    free_filter(node);
+    return NULL;
+}
+
+/* Compare an attribute value with an ordering assertion; integers are compared numerically */
+static int compare_values (const char *value, const char *assertion) {
+    char *valueEnd, *assertionEnd;
+    long long v, a;
+
+    v = strtoll(value, &valueEnd, 10);
+    a = strtoll(assertion, &assertionEnd, 10);
+    if (*value && *assertion && *valueEnd == '\0' && *assertionEnd == '\0')
+        return (v > a) - (v < a);
+
+    return strcasecmp(value, assertion);
+}
+
+/* Match a value against a substring filter, case-insensitively */
+static BOOL match_substrings (filter_node *node, const char *value) {
+    size_t len = strlen(value);
+    char **any;
+
+    if (node->initial) {
+        size_t initialLen = strlen(node->initial);
+        if (initialLen > len || strncasecmp(value, node->initial, initialLen) != 0)
+            return NO;
+        value += initialLen;
+        len -= initialLen;
+    }
+
+    if (node->final) {
+        size_t finalLen = strlen(node->final);
+        if (finalLen > len || strncasecmp(value + len - finalLen, node->final, finalLen) != 0)
+            return NO;
+        len -= finalLen;
+    }
+
+    for (any = node->any; any && *any; any++) {
+        size_t anyLen = strlen(*any);
+        size_t i;
+        BOOL found = NO;
+
+        for (i = 0; i + anyLen <= len; i++) {
+            if (strncasecmp(value + i, *any, anyLen) == 0) {
+                found = YES;
+                break;
+            }
+        }
+        if (!found)
+            return NO;
+
+        value += i + anyLen;
+        len -= i + anyLen;
+    }
+
+    return YES;
+}
+
+static BOOL match_filter (filter_node *node, TRLDAPEntry *entry) {
+    filter_node *child;
+    TREnumerator *iter;
+    TRArray *values;
+    TRString *value;
+
+    switch (node->type) {
+        case FILTER_AND:
+            for (child = node->children; child; child = child->next)
+                if (!match_filter(child, entry))
+                    return NO;
+            return YES;
+
+        case FILTER_OR:
+            for (child = node->children; child; child = child->next)
+                if (match_filter(child, entry))
+                    return YES;
+            return NO;
+
+        case FILTER_NOT:
+            return !match_filter(node->children, entry);
+
+        default:
+            break;
+    }
+
+    values = [entry valuesForAttributeCString: node->attribute];
+    if (!values)
+        return NO;
+
+    if (node->type == FILTER_PRESENT)
+        return YES;
+
+    iter = [values objectEnumerator];
+    while ((value = [iter nextObject]) != nil) {
+        const char *cString = [value cString];
+
+        switch (node->type) {
+            case FILTER_EQUALITY:
+            case FILTER_APPROX:
+                if (strcasecmp(cString, node->value) == 0)
+                    return YES;
+                break;
+            case FILTER_GREATER_OR_EQUAL:
+                if (compare_values(cString, node->value) >= 0)
+                    return YES;
+                break;
+            case FILTER_LESS_OR_EQUAL:
+                if (compare_values(cString, node->value) <= 0)
+                    return YES;
+                break;
+            case FILTER_SUBSTRINGS:
+                if (match_substrings(node, cString))
+                    return YES;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return NO;
+}
+
+/*
+ * Returns NO if the filter contains a negation or an approximate match.
+ * Local evaluation can only approximate the server's matching rules;
+ * under a negation, a value the server matched but the entry does not
+ * show (eg, under an alias or subtype) turns a miss into a false match.
+ */
+static BOOL filter_is_evaluable (filter_node *node) {
+    for (; node; node = node->next) {
+        if (node->type == FILTER_NOT || node->type == FILTER_APPROX)
+            return NO;
+        if (node->children && !filter_is_evaluable(node->children))
+            return NO;
+    }
+
+    return YES;
+}
+
+/* Add every attribute referenced by the filter to attributes, ignoring duplicates */
+static void collect_attributes (filter_node *node, TRArray *attributes) {
+    TREnumerator *iter;
+    TRString *attribute;
+    BOOL found;
+
+    for (; node; node = node->next) {
+        if (node->children) {
+            collect_attributes(node->children, attributes);
+            continue;
+        }
+
+        found = NO;
+        iter = [attributes objectEnumerator];
+        while ((attribute = [iter nextObject]) != nil) {
+            if (strcasecmp([attribute cString], node->attribute) == 0) {
+                found = YES;
+                break;
+            }
+        }
+
+        if (!found) {
+            attribute = [[TRString alloc] initWithCString: node->attribute];
+            [attributes addObject: attribute];
+            [attribute release];
+        }
+    }
+}
+
+/**
+ * An LDAP search filter, parsed so that it may be evaluated locally
+ * against entries already retrieved from the directory.
+ *
+ * Values are compared case-insensitively, which matches the equality and
+ * substring rules of most attributes used in group filters (cn, ou,
+ * objectClass, ...). Extensible match filters are not supported, and
+ * negations and approximate matches are never trusted locally; see
+ * -canEvaluateEntry:.
+ */
+@implementation TRLDAPFilter
+
+/**
+ * Parse an RFC 4515 search filter. Returns nil if the filter is
+ * malformed or uses unsupported features.
+ */
+- (id) initWithString: (TRString *) filter {
+    const char *p;
+
+    self = [self init];
+    if (!self)
+        return nil;
+
+    p = [filter cString];
+    _root = parse_filter(&p);
+    if (!_root || *p != '\0') {
+        [self release];
+        return nil;
+    }
+
+    _attributes = [[TRArray alloc] init];
+    collect_attributes(_root, _attributes);
+    _evaluable = filter_is_evaluable(_root);
+
+    return self;
+}
+
+- (void) dealloc {
+    free_filter(_root);
+    [_attributes release];
+    [super dealloc];
+}
+
+/**
+ * Returns YES if the entry matches the filter. Only the
+ * entry's retrieved attributes are considered.
+ */
+- (BOOL) matchesEntry: (TRLDAPEntry *) entry {
+    return match_filter(_root, entry);
+}
+
+/**
+ * Returns YES if -matchesEntry: can be trusted for the entry: the filter
+ * contains no negation or approximate match, and the entry includes every
+ * attribute the filter references. Otherwise only the server can tell
+ * whether the entry matches.
+ */
+- (BOOL) canEvaluateEntry: (TRLDAPEntry *) entry {
+    TREnumerator *iter;
+    TRString *attribute;
+
+    if (!_evaluable)
+        return NO;
+
+    iter = [_attributes objectEnumerator];
+    while ((attribute = [iter nextObject]) != nil) {
+        if (![entry valuesForAttribute: attribute])
+            return NO;
+    }
+
+    return YES;
+}
+
+/**
+ * Returns the names of all attributes referenced by the filter.
+ */
+- (TRArray *) attributes {
+    return (_attributes);
+}
+
+@end
@@ -34,15 +34,20 @@
 
 #import "TRObject.h"
 #import "TRString.h"
+#import "TRLDAPFilter.h"
 
 @interface TRLDAPGroupConfig : TRObject {
 @private
     TRString *_baseDN;
     TRString *_searchFilter;
+    TRLDAPFilter *_filter;
     TRString *_memberAttribute;
     BOOL     _memberRFC2307BIS;
     BOOL     _useCompareOperation;
     TRString *_pfTable;
+    int      _sizeLimit;
+    int      _timeLimit;
+    int      _pageSize;
 }
 
 - (TRString *) baseDN;
@@ -50,6 +55,7 @@
 
 - (TRString *) searchFilter;
 - (void) setSearchFilter: (TRString *) searchFilter;
+- (TRLDAPFilter *) filter;
 
 - (TRString *) memberAttribute;
 - (void) setMemberAttribute: (TRString *) memberAttribute;
@@ -63,4 +69,13 @@
 - (TRString *) pfTable;
 - (void) setPFTable: (TRString *) tableName;
 
+- (int) sizeLimit;
+- (void) setSizeLimit: (int) sizeLimit;
+
+- (int) timeLimit;
+- (void) setTimeLimit: (int) timeLimit;
+
+- (int) pageSize;
+- (void) setPageSize: (int) pageSize;
+
 @end
@@ -35,6 +35,7 @@
 #import <stdlib.h>
 
 #import "TRLDAPGroupConfig.h"
+#import "TRLDAPConnection.h"
 
 @implementation TRLDAPGroupConfig
 - (void) dealloc {
@@ -44,6 +45,9 @@
     if (_searchFilter)
         [_searchFilter release];
 
+    if (_filter)
+        [_filter release];
+
     if (_memberAttribute)
         [_memberAttribute release];
 
@@ -60,6 +64,7 @@
 
     _memberRFC2307BIS = YES;
     _useCompareOperation = YES;
+    _sizeLimit = TRLDAP_DEFAULT_SIZE_LIMIT;
     return self;
 }
 
@@ -81,6 +86,19 @@
     if (_searchFilter)
         [_searchFilter release];
     _searchFilter = [searchFilter retain];
+
+    /* Parse the filter for local evaluation, if possible */
+    if (_filter)
+        [_filter release];
+    _filter = [[TRLDAPFilter alloc] initWithString: searchFilter];
+}
+
+/**
+ * Returns the parsed search filter, or nil if the filter
+ * can not be evaluated locally.
+ */
+- (TRLDAPFilter *) filter {
+    return (_filter);
 }
 
 - (TRString *) memberAttribute {
@@ -119,4 +137,39 @@
     return (_pfTable);
 }
 
+/**
+ * Maximum number of entries returned by a search of this group.
+ */
+- (int) sizeLimit {
+    return (_sizeLimit);
+}
+
+- (void) setSizeLimit: (int) sizeLimit {
+    _sizeLimit = sizeLimit;
+}
+
+/**
+ * Maximum number of seconds the server may spend searching this
+ * group, or 0 for no limit beyond the LDAP timeout.
+ */
+- (int) timeLimit {
+    return (_timeLimit);
+}
+
+- (void) setTimeLimit: (int) timeLimit {
+    _timeLimit = timeLimit;
+}
+
+/**
+ * Number of entries requested per page when loading the group's
+ * members, or 0 if paging is disabled.
+ */
+- (int) pageSize {
+    return (_pageSize);
+}
+
+- (void) setPageSize: (int) pageSize {
+    _pageSize = pageSize;
+}
+
 @end
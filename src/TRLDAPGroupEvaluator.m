@@ -0,0 +1,708 @@
+/*
+ * TRLDAPGroupEvaluator.m vi:ts=4:sw=4:expandtab:
+ * LDAP Group Membership Evaluation
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <stdlib.h>
+#import <string.h>
+#import <strings.h>
+
+#import "TRLDAPGroupEvaluator.h"
+#import "TRLDAPSearchFilter.h"
+#import "TRHash.h"
+
+#import "xmalloc.h"
+
+/* Evaluation state of a single group */
+typedef enum {
+    GROUP_PENDING,
+    GROUP_NO_MATCH,
+    GROUP_MATCH,
+    GROUP_ERROR
+} group_state;
+
+/* Type of an outstanding request */
+typedef enum {
+    REQUEST_GROUP_SEARCH,
+    REQUEST_MEMBER_SEARCH,
+    REQUEST_COMPARE
+} request_type;
+
+/* An outstanding request */
+typedef struct group_request {
+    /* LDAP message ID, or -1 once answered or abandoned */
+    int msgid;
+
+    /* Index of the group, in configuration file order */
+    int group;
+
+    request_type type;
+} group_request;
+
+/* State of a single first match evaluation */
+typedef struct group_evaluation {
+    /* Groups, in configuration file order */
+    TRLDAPGroupConfig **groups;
+    group_state *state;
+
+    /* Number of outstanding requests, by group */
+    int *pending;
+    int numGroups;
+
+    /* Index of the first matching or failed group; later groups
+     * can not affect the result. numGroups if there is none yet. */
+    int limit;
+
+    group_request *requests;
+    int numRequests;
+    int capacity;
+
+    /* Attributes requested by every search; only the DN is used */
+    TRArray *attributes;
+} group_evaluation;
+
+/*
+ * Private Methods
+ */
+@interface TRLDAPGroupEvaluator (Private)
+- (void) sendRequestType: (request_type) type msgid: (int) msgid group: (int) group evaluation: (group_evaluation *) eval;
+- (void) sendMemberRequestsForGroup: (int) group entries: (TRArray *) ldapEntries user: (TRLDAPEntry *) ldapUser evaluation: (group_evaluation *) eval;
+- (void) finishRequest: (group_request *) request evaluation: (group_evaluation *) eval;
+- (void) pruneEvaluation: (group_evaluation *) eval;
+@end
+
+@implementation TRLDAPGroupEvaluator (Private)
+
+/**
+ * Record a request sent for the given group.
+ */
+- (void) sendRequestType: (request_type) type msgid: (int) msgid group: (int) group evaluation: (group_evaluation *) eval {
+    if (eval->numRequests == eval->capacity) {
+        eval->capacity *= 2;
+        eval->requests = xrealloc(eval->requests, sizeof(group_request) * eval->capacity);
+    }
+
+    eval->requests[eval->numRequests].msgid = msgid;
+    eval->requests[eval->numRequests].group = group;
+    eval->requests[eval->numRequests].type = type;
+    eval->numRequests++;
+    eval->pending[group]++;
+}
+
+/**
+ * Send a compare or membership search for each of the group entries
+ * returned by a group's search.
+ */
+- (void) sendMemberRequestsForGroup: (int) group entries: (TRArray *) ldapEntries user: (TRLDAPEntry *) ldapUser evaluation: (group_evaluation *) eval {
+    TRLDAPGroupConfig *groupConfig = eval->groups[group];
+    TREnumerator *entryIter;
+    TRLDAPEntry *entry;
+    TRString *searchValue;
+    TRString *searchFilter;
+    int msgid;
+
+    /* If RFC2307BIS flag is true, search for full DN, otherwise just search for uid */
+    searchValue = [groupConfig memberRFC2307BIS] ? [ldapUser dn] : [ldapUser rdn];
+
+    /* This will be used if we're using the "search" operation instead of the "compare" operation */
+    searchFilter = [TRString stringWithFormat: "(%s=%s)", [[groupConfig memberAttribute] cString], [[TRLDAPSearchFilter escapeString: searchValue] cString]];
+
+    entryIter = [ldapEntries objectEnumerator];
+    while ((entry = [entryIter nextObject]) != nil) {
+        if ([groupConfig useCompareOperation]) {
+            msgid = [_ldap sendCompareDN: [entry dn] withAttribute: [groupConfig memberAttribute] value: searchValue];
+            if (msgid != -1)
+                [self sendRequestType: REQUEST_COMPARE msgid: msgid group: group evaluation: eval];
+        } else {
+            msgid = [_ldap sendSearchWithFilter: searchFilter scope: LDAP_SCOPE_SUBTREE baseDN: [entry dn] attributes: eval->attributes sizeLimit: [groupConfig sizeLimit] timeLimit: [groupConfig timeLimit]];
+            if (msgid != -1)
+                [self sendRequestType: REQUEST_MEMBER_SEARCH msgid: msgid group: group evaluation: eval];
+        }
+    }
+}
+
+/**
+ * Mark a request as answered, or abandoned. A group with no remaining
+ * requests, and no match, does not match.
+ */
+- (void) finishRequest: (group_request *) request evaluation: (group_evaluation *) eval {
+    int group = request->group;
+
+    request->msgid = -1;
+    eval->pending[group]--;
+
+    if (eval->pending[group] == 0 && eval->state[group] == GROUP_PENDING)
+        eval->state[group] = GROUP_NO_MATCH;
+}
+
+/**
+ * Abandon every outstanding request that can no longer affect the
+ * result: those for groups after the first matching or failed group,
+ * and the remaining requests of a matching group.
+ */
+- (void) pruneEvaluation: (group_evaluation *) eval {
+    group_request *request;
+    int i;
+
+    for (i = 0; i < eval->limit; i++) {
+        if (eval->state[i] == GROUP_MATCH || eval->state[i] == GROUP_ERROR) {
+            eval->limit = i;
+            break;
+        }
+    }
+
+    for (i = 0; i < eval->numRequests; i++) {
+        request = &eval->requests[i];
+        if (request->msgid == -1 || request->group < eval->limit)
+            continue;
+
+        [_ldap abandon: request->msgid];
+        [self finishRequest: request evaluation: eval];
+    }
+}
+
+@end
+
+/*
+ * Combined Group Search
+ */
+
+/** Returns an attribute list requesting only the DN of each entry. */
+static TRArray *dn_only_attributes(void) {
+    TRArray *attributes;
+
+    attributes = [[[TRArray alloc] init] autorelease];
+    [attributes addObject: [TRString stringWithCString: LDAP_NO_ATTRS]];
+
+    return attributes;
+}
+
+/**
+ * Check the user's membership of a single group, with one search for the
+ * group entries, and one compare or search per returned entry.
+ */
+static group_state check_ldap_group(TRLDAPConnection *ldap, TRLDAPGroupConfig *groupConfig, TRLDAPEntry *ldapUser) {
+    TRArray *ldapEntries;
+    TREnumerator *entryIter;
+    TRLDAPEntry *entry;
+    TRArray *attributes;
+    TRString *searchValue;
+    TRString *searchFilter;
+
+    /* Only the DN of each group entry is used */
+    attributes = dn_only_attributes();
+
+    /* Search for the group */
+    ldapEntries = [ldap searchWithFilter: [groupConfig searchFilter]
+        scope: LDAP_SCOPE_SUBTREE
+        baseDN: [groupConfig baseDN]
+        attributes: attributes
+        sizeLimit: [groupConfig sizeLimit]
+        timeLimit: [groupConfig timeLimit]];
+
+    /* Error occured, all stop */
+    if (!ldapEntries)
+        return GROUP_ERROR;
+
+    /* If RFC2307BIS flag is true, search for full DN, otherwise just search for uid */
+    searchValue = [groupConfig memberRFC2307BIS] ? [ldapUser dn] : [ldapUser rdn];
+
+    /* This will be used if we're using the "search" operation instead of the "compare" operation */
+    searchFilter = [TRString stringWithFormat: "(%s=%s)", [[groupConfig memberAttribute] cString], [[TRLDAPSearchFilter escapeString: searchValue] cString]];
+
+    /* Iterate over the returned entries */
+    entryIter = [ldapEntries objectEnumerator];
+    while ((entry = [entryIter nextObject]) != nil) {
+        if ((![groupConfig useCompareOperation] && [ldap searchWithFilter: searchFilter scope: LDAP_SCOPE_SUBTREE baseDN: [entry dn] attributes: attributes sizeLimit: [groupConfig sizeLimit] timeLimit: [groupConfig timeLimit]]) ||
+            ([groupConfig useCompareOperation] && [ldap compareDN: [entry dn] withAttribute: [groupConfig memberAttribute] value: searchValue])) {
+            /* Group match! */
+            return GROUP_MATCH;
+        }
+    }
+
+    return GROUP_NO_MATCH;
+}
+
+/**
+ * Returns YES if the group's own search returns any entries. As when
+ * each group is checked in turn, a group search that fails or finds
+ * nothing stops evaluation.
+ */
+static BOOL group_has_entries(TRLDAPConnection *ldap, TRLDAPGroupConfig *groupConfig) {
+    return [ldap searchWithFilter: [groupConfig searchFilter]
+        scope: LDAP_SCOPE_SUBTREE
+        baseDN: [groupConfig baseDN]
+        attributes: dn_only_attributes()
+        sizeLimit: [groupConfig sizeLimit]
+        timeLimit: [groupConfig timeLimit]] != nil;
+}
+
+/**
+ * Returns a key identifying the groups whose membership may be
+ * checked with a single combined search.
+ */
+static TRString *group_partition_key(TRLDAPGroupConfig *groupConfig) {
+    return [TRString stringWithFormat: "%s\n%s\n%d\n%d\n%d",
+        [[groupConfig baseDN] cString],
+        [[groupConfig memberAttribute] cString],
+        [groupConfig memberRFC2307BIS],
+        [groupConfig sizeLimit],
+        [groupConfig timeLimit]];
+}
+
+/**
+ * Returns YES if group's membership is checked by the combined search
+ * for the given partition.
+ */
+static BOOL group_in_partition(TRLDAPGroupConfig *group, TRString *partition) {
+    if (![group filter] || ![group memberAttribute])
+        return NO;
+
+    return (strcmp([group_partition_key(group) cString], [partition cString]) == 0);
+}
+
+/** Returns the number of groups checked by a partition's combined search. */
+static unsigned int partition_group_count(TRArray *groups, TRString *partition) {
+    TREnumerator *groupIter;
+    TRLDAPGroupConfig *group;
+    unsigned int count = 0;
+
+    groupIter = [groups objectEnumerator];
+    while ((group = [groupIter nextObject]) != nil) {
+        if (group_in_partition(group, partition))
+            count++;
+    }
+
+    return count;
+}
+
+/**
+ * Returns YES if any of the entries returned by a partition's combined
+ * search can not be attributed to one of the partition's groups locally.
+ * The server matched each entry against one of the filters, but local
+ * evaluation does not know attribute aliases, subtypes or matching rules;
+ * such an entry can not be attributed to a group without asking the server.
+ */
+static BOOL partition_has_unattributed_entries(TRArray *groups, TRString *partition, TRArray *ldapEntries) {
+    TREnumerator *entryIter, *groupIter;
+    TRLDAPGroupConfig *group;
+    TRLDAPEntry *entry;
+    BOOL matched;
+
+    entryIter = [ldapEntries objectEnumerator];
+    while ((entry = [entryIter nextObject]) != nil) {
+        matched = NO;
+        groupIter = [groups objectEnumerator];
+        while ((group = [groupIter nextObject]) != nil) {
+            if (group_in_partition(group, partition) && [[group filter] canEvaluateEntry: entry] && [[group filter] matchesEntry: entry]) {
+                matched = YES;
+                break;
+            }
+        }
+
+        if (!matched)
+            return YES;
+    }
+
+    return NO;
+}
+
+/** Add each attribute in source to dest, ignoring duplicates. */
+static void merge_attributes(TRArray *dest, TRArray *source) {
+    TREnumerator *sourceIter, *destIter;
+    TRString *attribute, *existing;
+    BOOL found;
+
+    sourceIter = [source objectEnumerator];
+    while ((attribute = [sourceIter nextObject]) != nil) {
+        found = NO;
+        destIter = [dest objectEnumerator];
+        while ((existing = [destIter nextObject]) != nil) {
+            if (strcasecmp([existing cString], [attribute cString]) == 0) {
+                found = YES;
+                break;
+            }
+        }
+
+        if (!found)
+            [dest addObject: attribute];
+    }
+}
+
+/**
+ * Search, in one request, for every group in groupConfig's partition of
+ * which the user is a member. The returned entries include the attributes
+ * required to evaluate each group's filter locally.
+ * @return The group entries, or nil if the search failed.
+ */
+static TRArray *search_group_partition(TRLDAPConnection *ldap, TRArray *groups, TRLDAPGroupConfig *groupConfig, TRLDAPEntry *ldapUser) {
+    TREnumerator *groupIter;
+    TRLDAPGroupConfig *group;
+    TRString *partition;
+    TRString *filter;
+    TRString *memberValue;
+    TRArray *attributes;
+    TRArray *ldapEntries;
+    BOOL succeeded;
+
+    partition = group_partition_key(groupConfig);
+    attributes = [[[TRArray alloc] init] autorelease];
+
+    /* (&(|(filter1)(filter2)...)(memberAttribute=member)) */
+    filter = [[TRString alloc] initWithCString: "(&(|"];
+
+    groupIter = [groups objectReverseEnumerator];
+    while ((group = [groupIter nextObject]) != nil) {
+        if (!group_in_partition(group, partition))
+            continue;
+
+        [filter appendString: [group searchFilter]];
+        merge_attributes(attributes, [[group filter] attributes]);
+    }
+
+    memberValue = [TRLDAPSearchFilter escapeString: [groupConfig memberRFC2307BIS] ? [ldapUser dn] : [ldapUser rdn]];
+    [filter appendCString: ")("];
+    [filter appendString: [groupConfig memberAttribute]];
+    [filter appendCString: "="];
+    [filter appendString: memberValue];
+    [filter appendCString: "))"];
+
+    /* Only the DN is needed if the filters reference no attributes */
+    if ([attributes count] == 0)
+        attributes = dn_only_attributes();
+
+    ldapEntries = [ldap searchWithFilter: filter
+        scope: LDAP_SCOPE_SUBTREE
+        baseDN: [groupConfig baseDN]
+        attributes: attributes
+        sizeLimit: [groupConfig sizeLimit]
+        timeLimit: [groupConfig timeLimit]
+        succeeded: &succeeded];
+    [filter release];
+
+    if (!succeeded)
+        return nil;
+
+    /* No groups found */
+    if (!ldapEntries)
+        ldapEntries = [[[TRArray alloc] init] autorelease];
+
+    return ldapEntries;
+}
+
+/**
+ * Check the user's membership of a group with a parsed filter, using its
+ * partition's combined search. The search results are cached in partitions.
+ */
+static group_state check_partition_group(TRLDAPConnection *ldap, TRArray *groups, TRHash *partitions, TRLDAPGroupConfig *groupConfig, TRLDAPEntry *ldapUser) {
+    TRArray *ldapEntries;
+    TREnumerator *entryIter;
+    TRLDAPEntry *entry;
+    TRString *partition;
+    BOOL unknown;
+
+    /* Run the partition's combined search, if not already done */
+    partition = group_partition_key(groupConfig);
+    ldapEntries = [partitions valueForKey: partition];
+    if (!ldapEntries) {
+        /* Error occured, all stop */
+        ldapEntries = search_group_partition(ldap, groups, groupConfig, ldapUser);
+        if (!ldapEntries)
+            return GROUP_ERROR;
+        [partitions setObject: ldapEntries forKey: partition];
+    }
+
+    if (partition_group_count(groups, partition) == 1) {
+        /* The server matched every entry against this group's filter */
+        if ([ldapEntries count] > 0)
+            return GROUP_MATCH;
+    } else {
+        /* Did any of the user's groups match this group's filter? */
+        unknown = NO;
+        entryIter = [ldapEntries objectEnumerator];
+        while ((entry = [entryIter nextObject]) != nil) {
+            if (![[groupConfig filter] canEvaluateEntry: entry]) {
+                unknown = YES;
+                continue;
+            }
+
+            if ([[groupConfig filter] matchesEntry: entry])
+                return GROUP_MATCH;
+        }
+
+        /* Some entries could not be evaluated or attributed; ask the server */
+        if (unknown || partition_has_unattributed_entries(groups, partition, ldapEntries))
+            return check_ldap_group(ldap, groupConfig, ldapUser);
+    }
+
+    /* Not a member; but a group with no entries stops evaluation */
+    if (!group_has_entries(ldap, groupConfig))
+        return GROUP_ERROR;
+
+    return GROUP_NO_MATCH;
+}
+
+
+/**
+ * Finds the first group, in configuration file order, of which a user
+ * is a member.
+ *
+ * All group searches are sent at once, and the compares (or membership
+ * searches) for a group's entries are sent as soon as the group's search
+ * returns, so that requests for every group are outstanding on the
+ * connection together. Evaluation stops as soon as the result is known:
+ * once the first matching group is found, or a group search fails, any
+ * requests that can no longer change the result are abandoned, and no
+ * new requests are sent for later groups.
+ *
+ * The result is the same as checking each group in turn: the first
+ * matching group wins, and a failed group search stops evaluation.
+ */
+@implementation TRLDAPGroupEvaluator
+
+/**
+ * Initialize a new evaluator.
+ * @param ldap Bound LDAP connection used for all requests.
+ */
+- (id) initWithConnection: (TRLDAPConnection *) ldap {
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _ldap = [ldap retain];
+
+    return self;
+}
+
+- (void) dealloc {
+    [_ldap release];
+    [super dealloc];
+}
+
+/**
+ * Find the first of groups of which the user is a member.
+ * @param groups Group configurations, as returned by -[TRAuthLDAPConfig ldapGroups].
+ * @param ldapUser The user's entry.
+ * @return The first matching group, or nil if no group matched or
+ * a group search failed.
+ */
+- (TRLDAPGroupConfig *) firstMatchingGroup: (TRArray *) groups forUser: (TRLDAPEntry *) ldapUser {
+    group_evaluation eval;
+    group_request *request;
+    group_request answered;
+    TREnumerator *groupIter;
+    TRLDAPGroupConfig *result = nil;
+    TRArray *ldapEntries;
+    LDAPMessage *res;
+    BOOL decided;
+    int msgid;
+    int i;
+
+    eval.numGroups = [groups count];
+    if (eval.numGroups == 0)
+        return nil;
+
+    eval.groups = xmalloc(sizeof(TRLDAPGroupConfig *) * eval.numGroups);
+    eval.state = xmalloc(sizeof(group_state) * eval.numGroups);
+    eval.pending = xmalloc(sizeof(int) * eval.numGroups);
+    eval.limit = eval.numGroups;
+
+    eval.capacity = eval.numGroups;
+    eval.numRequests = 0;
+    eval.requests = xmalloc(sizeof(group_request) * eval.capacity);
+
+    /* Groups are loaded into the array in the order that they are listed
+     * in the configuration file; walk the stack from the bottom up. */
+    groupIter = [groups objectReverseEnumerator];
+    for (i = 0; i < eval.numGroups; i++) {
+        eval.groups[i] = [groupIter nextObject];
+        eval.state[i] = GROUP_PENDING;
+        eval.pending[i] = 0;
+    }
+
+    eval.attributes = [[TRArray alloc] init];
+    [eval.attributes addObject: [TRString stringWithCString: LDAP_NO_ATTRS]];
+
+    /* Send every group search */
+    for (i = 0; i < eval.numGroups; i++) {
+        msgid = [_ldap sendSearchWithFilter: [eval.groups[i] searchFilter]
+            scope: LDAP_SCOPE_SUBTREE
+            baseDN: [eval.groups[i] baseDN]
+            attributes: eval.attributes
+            sizeLimit: [eval.groups[i] sizeLimit]
+            timeLimit: [eval.groups[i] timeLimit]];
+
+        /* Error occured; no later group can match */
+        if (msgid == -1) {
+            eval.state[i] = GROUP_ERROR;
+            break;
+        }
+
+        [self sendRequestType: REQUEST_GROUP_SEARCH msgid: msgid group: i evaluation: &eval];
+    }
+
+    while (true) {
+        [self pruneEvaluation: &eval];
+
+        /* Decided once every group before the limit has failed to match */
+        decided = YES;
+        for (i = 0; i < eval.limit; i++) {
+            if (eval.state[i] == GROUP_PENDING) {
+                decided = NO;
+                break;
+            }
+        }
+
+        if (decided) {
+            if (eval.limit < eval.numGroups && eval.state[eval.limit] == GROUP_MATCH)
+                result = eval.groups[eval.limit];
+            break;
+        }
+
+        res = [_ldap receiveResult: &msgid];
+
+        /* Timed out, or the connection failed. Unanswered group searches are
+         * errors, and unanswered membership checks do not match. */
+        if (!res) {
+            for (i = 0; i < eval.numRequests; i++) {
+                request = &eval.requests[i];
+                if (request->msgid == -1)
+                    continue;
+
+                [_ldap abandon: request->msgid];
+                if (request->type == REQUEST_GROUP_SEARCH)
+                    eval.state[request->group] = GROUP_ERROR;
+                [self finishRequest: request evaluation: &eval];
+            }
+            continue;
+        }
+
+        request = NULL;
+        for (i = 0; i < eval.numRequests; i++) {
+            if (eval.requests[i].msgid == msgid) {
+                request = &eval.requests[i];
+                break;
+            }
+        }
+
+        /* Not one of ours */
+        if (!request) {
+            ldap_msgfree(res);
+            continue;
+        }
+
+        /* Sending further requests may reallocate the request list */
+        answered = *request;
+
+        switch (answered.type) {
+            case REQUEST_GROUP_SEARCH:
+                ldapEntries = [_ldap entriesFromSearchResult: res];
+                if (!ldapEntries)
+                    eval.state[answered.group] = GROUP_ERROR;
+                else if (answered.group < eval.limit)
+                    [self sendMemberRequestsForGroup: answered.group entries: ldapEntries user: ldapUser evaluation: &eval];
+                break;
+
+            case REQUEST_MEMBER_SEARCH:
+                if ([_ldap entriesFromSearchResult: res])
+                    eval.state[answered.group] = GROUP_MATCH;
+                break;
+
+            case REQUEST_COMPARE:
+                if ([_ldap compareResult: res])
+                    eval.state[answered.group] = GROUP_MATCH;
+                break;
+        }
+
+        [self finishRequest: &eval.requests[i] evaluation: &eval];
+    }
+
+    [eval.attributes release];
+    free(eval.requests);
+    free(eval.pending);
+    free(eval.state);
+    free(eval.groups);
+
+    return result;
+}
+
+/**
+ * Find the first of groups of which the user is a member, with one
+ * combined search for all groups that share a base DN, membership
+ * attribute and limits, attributing the returned group entries to their
+ * configured group locally.
+ *
+ * Groups with filters that can not be parsed are checked individually,
+ * as is any group whose filter can not be evaluated locally against
+ * every returned entry (see -[TRLDAPFilter canEvaluateEntry:]), and the
+ * groups of a partition whose entries could not all be attributed
+ * locally. A partition of a single group needs no local evaluation;
+ * every returned entry matched its filter.
+ *
+ * The result is the same as that of -firstMatchingGroup:forUser:. So that
+ * a group search that finds nothing stops evaluation here too, each group
+ * the user is not a member of costs one more search, for its entries.
+ * @param groups Group configurations, as returned by -[TRAuthLDAPConfig ldapGroups].
+ * @param ldapUser The user's entry.
+ * @return The first matching group, or nil if no group matched or
+ * a group search failed.
+ */
+- (TRLDAPGroupConfig *) firstMatchingGroupWithCombinedSearch: (TRArray *) groups forUser: (TRLDAPEntry *) ldapUser {
+    TREnumerator *groupIter;
+    TRLDAPGroupConfig *groupConfig;
+    TRLDAPGroupConfig *result = nil;
+    TRHash *partitions;
+    group_state status;
+
+    /* Search results, by partition */
+    partitions = [[TRHash alloc] initWithCapacity: [groups count] + 1];
+
+    /* Walk the groups in configuration file order; first match wins */
+    groupIter = [groups objectReverseEnumerator];
+    while ((groupConfig = [groupIter nextObject]) != nil) {
+        if (![groupConfig filter] || ![groupConfig memberAttribute])
+            status = check_ldap_group(_ldap, groupConfig, ldapUser);
+        else
+            status = check_partition_group(_ldap, groups, partitions, groupConfig, ldapUser);
+
+        if (status == GROUP_MATCH)
+            result = groupConfig;
+
+        /* Error occured, all stop */
+        if (status != GROUP_NO_MATCH)
+            break;
+    }
+
+    [partitions release];
+
+    return result;
+}
+
+@end
@@ -0,0 +1,69 @@
+/*
+ * TRLDAPGroupSnapshot.h vi:ts=4:sw=4:expandtab:
+ * Periodically Refreshed LDAP Group Membership
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <pthread.h>
+
+#import "TRObject.h"
+#import "TRArray.h"
+#import "TRLDAPConnectionPool.h"
+#import "TRLDAPEntry.h"
+#import "TRLDAPGroupConfig.h"
+
+@interface TRLDAPGroupSnapshot : TRObject {
+@private
+    TRLDAPConnectionPool *_pool;
+    TRArray *_groups;
+    unsigned int _interval;
+
+    /* Current membership index, or nil if none has been loaded */
+    id _index;
+
+    /* Refresh thread */
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+    pthread_t _thread;
+    BOOL _running;
+    BOOL _shutdown;
+    BOOL _refreshRequested;
+}
+
+- (id) initWithConnectionPool: (TRLDAPConnectionPool *) pool groups: (TRArray *) groups refreshInterval: (unsigned int) seconds;
+
+- (BOOL) start;
+- (void) shutdown;
+- (BOOL) refresh;
+- (void) refreshSoon;
+
+- (BOOL) isLoaded;
+- (BOOL) findGroupForUser: (TRLDAPEntry *) ldapUser group: (TRLDAPGroupConfig **) group;
+
+@end
@@ -0,0 +1,492 @@
+/*
+ * TRLDAPGroupSnapshot.m vi:ts=4:sw=4:expandtab:
+ * Periodically Refreshed LDAP Group Membership
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <stdlib.h>
+#import <string.h>
+#import <ctype.h>
+#import <errno.h>
+#import <time.h>
+
+#import "TRLDAPGroupSnapshot.h"
+#import "TRLDAPSearchEnumerator.h"
+#import "TRAutoreleasePool.h"
+#import "TRHash.h"
+#import "TRLog.h"
+
+#import "xmalloc.h"
+
+static time_t snapshot_now (void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+/* Return an autoreleased, lower case copy of string */
+static TRString *lowercase_string (TRString *string) {
+    TRString *result;
+    char *copy;
+    char *p;
+
+    copy = xstrdup([string cString]);
+    for (p = copy; *p != '\0'; p++)
+        *p = tolower((unsigned char) *p);
+
+    result = [[TRString alloc] initWithCString: copy];
+    free(copy);
+
+    return [result autorelease];
+}
+
+/**
+ * A configured group, and its position in the configuration file.
+ */
+@interface TRLDAPGroupSnapshotGroup : TRObject {
+@public
+    unsigned int _order;
+    TRLDAPGroupConfig *_group;
+}
+@end
+
+@implementation TRLDAPGroupSnapshotGroup
+
+- (void) dealloc {
+    [_group release];
+    [super dealloc];
+}
+
+@end
+
+
+/**
+ * An immutable index of member DN or uid to the first group, in
+ * configuration file order, listing that member.
+ */
+@interface TRLDAPGroupSnapshotIndex : TRObject {
+@private
+    /* Members of RFC2307bis groups, by normalized DN */
+    TRHash *_byDN;
+
+    /* Members of other groups, by lower case uid */
+    TRHash *_byUID;
+
+    unsigned int _numMembers;
+    time_t _loaded;
+}
+
+- (id) initWithGroups: (TRArray *) groups connection: (TRLDAPConnection *) ldap;
+- (TRLDAPGroupConfig *) groupForUser: (TRLDAPEntry *) ldapUser;
+- (unsigned int) numMembers;
+- (time_t) loaded;
+
+@end
+
+@implementation TRLDAPGroupSnapshotIndex
+
+/**
+ * Load the members of every group, walking the groups in configuration
+ * file order so that each member is indexed by their first group.
+ * @return nil if any group's members could not be loaded.
+ */
+- (id) initWithGroups: (TRArray *) groups connection: (TRLDAPConnection *) ldap {
+    TREnumerator *groupIter;
+    TRLDAPSearchEnumerator *entryIter;
+    TREnumerator *valueIter;
+    TRAutoreleasePool *pool;
+    TRLDAPGroupConfig *groupConfig;
+    TRLDAPGroupSnapshotGroup *group;
+    TRLDAPEntry *entry;
+    TRArray *memberLists;
+    TRArray *members;
+    TRArray *attributes;
+    TRArray *values;
+    TRString *value;
+    TRHash *hash;
+    unsigned int order;
+    unsigned int numEntries;
+
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _loaded = snapshot_now();
+
+    /* Members of each group, in configuration file order */
+    memberLists = [[TRArray alloc] init];
+
+    order = 0;
+    groupIter = [groups objectReverseEnumerator];
+    while ((groupConfig = [groupIter nextObject]) != nil) {
+        if (![groupConfig memberAttribute]) {
+            [TRLog error: "Group \"%s\" has no MemberAttribute, and can not be included in the group membership snapshot.", [[groupConfig searchFilter] cString]];
+            goto error;
+        }
+
+        attributes = [[[TRArray alloc] init] autorelease];
+        [attributes addObject: [groupConfig memberAttribute]];
+
+        /* Stream the group entries rather than loading the complete
+         * result set, so that large groups are never held in memory
+         * twice over. With a PageSize, at most one page is outstanding. */
+        entryIter = [ldap enumerateSearchWithFilter: [groupConfig searchFilter]
+            scope: LDAP_SCOPE_SUBTREE
+            baseDN: [groupConfig baseDN]
+            attributes: attributes
+            sizeLimit: [groupConfig sizeLimit]
+            timeLimit: [groupConfig timeLimit]
+            pageSize: [groupConfig pageSize]];
+        if (!entryIter)
+            goto error;
+
+        members = [[TRArray alloc] init];
+        numEntries = 0;
+        while (1) {
+            pool = [[TRAutoreleasePool alloc] init];
+            if ((entry = [entryIter nextObject]) == nil) {
+                [pool release];
+                break;
+            }
+
+            numEntries++;
+            values = [entry valuesForAttribute: [groupConfig memberAttribute]];
+            valueIter = [values objectEnumerator];
+            while ((value = [valueIter nextObject]) != nil) {
+                if ([groupConfig memberRFC2307BIS])
+                    [members addObject: [TRLDAPEntry normalizedDN: value]];
+                else
+                    [members addObject: lowercase_string(value)];
+            }
+
+            [pool release];
+        }
+
+        /* As when checking membership at login, a failed or empty group
+         * search stops evaluation; keep the previous snapshot instead */
+        if (![entryIter succeeded] || numEntries == 0) {
+            [TRLog warning: "No entries found for group \"%s\".", [[groupConfig searchFilter] cString]];
+            [members release];
+            goto error;
+        }
+
+        group = [[TRLDAPGroupSnapshotGroup alloc] init];
+        group->_order = order++;
+        group->_group = [groupConfig retain];
+
+        [memberLists addObject: group];
+        [memberLists addObject: members];
+        _numMembers += [members count];
+
+        [group release];
+        [members release];
+    }
+
+    _byDN = [[TRHash alloc] initWithCapacity: _numMembers + 1];
+    _byUID = [[TRHash alloc] initWithCapacity: _numMembers + 1];
+
+    /* Index each member by their first group */
+    groupIter = [memberLists objectReverseEnumerator];
+    while ((group = [groupIter nextObject]) != nil) {
+        members = [groupIter nextObject];
+        hash = [group->_group memberRFC2307BIS] ? _byDN : _byUID;
+
+        valueIter = [members objectEnumerator];
+        while ((value = [valueIter nextObject]) != nil) {
+            if (![hash valueForKey: value])
+                [hash setObject: group forKey: value];
+        }
+    }
+
+    [memberLists release];
+    return self;
+
+error:
+    [memberLists release];
+    [self release];
+    return nil;
+}
+
+- (void) dealloc {
+    [_byDN release];
+    [_byUID release];
+    [super dealloc];
+}
+
+/**
+ * Return the first group of which the user is a member, or nil.
+ */
+- (TRLDAPGroupConfig *) groupForUser: (TRLDAPEntry *) ldapUser {
+    TRLDAPGroupSnapshotGroup *byDN = nil;
+    TRLDAPGroupSnapshotGroup *byUID = nil;
+
+    if ([ldapUser dn])
+        byDN = [_byDN valueForKey: [TRLDAPEntry normalizedDN: [ldapUser dn]]];
+    if ([ldapUser rdn])
+        byUID = [_byUID valueForKey: lowercase_string([ldapUser rdn])];
+
+    if (byDN && (!byUID || byDN->_order < byUID->_order))
+        return byDN->_group;
+    if (byUID)
+        return byUID->_group;
+
+    return nil;
+}
+
+- (unsigned int) numMembers {
+    return _numMembers;
+}
+
+- (time_t) loaded {
+    return _loaded;
+}
+
+@end
+
+
+/*
+ * Private Methods
+ */
+@interface TRLDAPGroupSnapshot (Private)
+- (void) runRefresher;
+@end
+
+/* Refresh thread entry point */
+static void *group_snapshot_thread (void *arg) {
+    TRLDAPGroupSnapshot *snapshot = arg;
+    [snapshot runRefresher];
+    return NULL;
+}
+
+@implementation TRLDAPGroupSnapshot (Private)
+
+/**
+ * Refresh thread main loop. Refreshes the snapshot at each interval
+ * until shut down.
+ */
+- (void) runRefresher {
+    TRAutoreleasePool *pool;
+    struct timespec deadline;
+
+    pthread_mutex_lock(&_lock);
+    while (!_shutdown) {
+        _refreshRequested = NO;
+        pthread_mutex_unlock(&_lock);
+
+        pool = [[TRAutoreleasePool alloc] init];
+        [self refresh];
+        [pool release];
+
+        /* Sleep until the next refresh, an early refresh request, or shutdown */
+        pthread_mutex_lock(&_lock);
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += _interval;
+        while (!_shutdown && !_refreshRequested) {
+            if (pthread_cond_timedwait(&_cond, &_lock, &deadline) == ETIMEDOUT)
+                break;
+        }
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+@end
+
+
+/**
+ * An in-memory snapshot of the members of each configured group,
+ * refreshed by a background thread at a fixed interval.
+ *
+ * Each refresh issues one search per group, fetching the group entries'
+ * member attribute values. Members are indexed by the first group, in
+ * configuration file order, that lists them, so a user's group is found
+ * without any LDAP requests. Members of RFC2307bis groups are matched by
+ * DN, and members of other groups by uid; both are compared
+ * case-insensitively, and DNs are normalized (see
+ * +[TRLDAPEntry normalizedDN:]) so that differences in spacing and
+ * escaping do not matter.
+ *
+ * If a refresh fails, the previous snapshot is kept. A snapshot more than
+ * two refresh intervals old is considered stale, and is not used.
+ */
+@implementation TRLDAPGroupSnapshot
+
+/**
+ * Initialize a new, empty group snapshot.
+ * @param pool Pool from which refresh connections are acquired.
+ * @param groups Group configurations, as returned by -[TRAuthLDAPConfig ldapGroups].
+ * @param seconds Interval between refreshes.
+ */
+- (id) initWithConnectionPool: (TRLDAPConnectionPool *) pool groups: (TRArray *) groups refreshInterval: (unsigned int) seconds {
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _pool = [pool retain];
+    _groups = [groups retain];
+    _interval = seconds;
+    _index = nil;
+
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_cond, NULL);
+
+    return self;
+}
+
+- (void) dealloc {
+    [self shutdown];
+
+    [_index release];
+    [_groups release];
+    [_pool release];
+
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_lock);
+
+    [super dealloc];
+}
+
+/**
+ * Start the refresh thread. The first refresh begins immediately;
+ * until it completes, the snapshot is not loaded.
+ * @return NO if the thread could not be started.
+ */
+- (BOOL) start {
+    if (pthread_create(&_thread, NULL, group_snapshot_thread, self) != 0) {
+        [TRLog error: "Unable to start the group membership snapshot thread."];
+        return NO;
+    }
+
+    _running = YES;
+    return YES;
+}
+
+/**
+ * Stop the refresh thread, waiting for any in-progress refresh to finish.
+ */
+- (void) shutdown {
+    pthread_mutex_lock(&_lock);
+    _shutdown = YES;
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_lock);
+
+    if (_running) {
+        pthread_join(_thread, NULL);
+        _running = NO;
+    }
+}
+
+/**
+ * Ask the refresh thread to refresh the snapshot now, rather than at
+ * the end of the current interval, eg, after a group has changed.
+ */
+- (void) refreshSoon {
+    pthread_mutex_lock(&_lock);
+    _refreshRequested = YES;
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Reload the members of every group, replacing the current snapshot.
+ * @return NO if the members could not be loaded; the previous snapshot
+ * is kept.
+ */
+- (BOOL) refresh {
+    TRLDAPConnection *ldap;
+    TRLDAPGroupSnapshotIndex *index;
+    id old;
+
+    if (!(ldap = [_pool checkout])) {
+        [TRLog warning: "Unable to refresh the group membership snapshot: LDAP connect failed."];
+        return NO;
+    }
+
+    index = [[TRLDAPGroupSnapshotIndex alloc] initWithGroups: _groups connection: ldap];
+    [_pool checkin: ldap];
+
+    if (!index) {
+        [TRLog warning: "Unable to refresh the group membership snapshot; the previous snapshot has been kept."];
+        return NO;
+    }
+
+    pthread_mutex_lock(&_lock);
+    old = _index;
+    _index = index;
+    pthread_mutex_unlock(&_lock);
+
+    [old release];
+
+    [TRLog debug: "Refreshed the group membership snapshot with %u members.", [index numMembers]];
+    return YES;
+}
+
+/**
+ * Returns YES if a current snapshot is available.
+ */
+- (BOOL) isLoaded {
+    BOOL loaded;
+
+    pthread_mutex_lock(&_lock);
+    loaded = (_index != nil && snapshot_now() - [_index loaded] <= (time_t) _interval * 2);
+    pthread_mutex_unlock(&_lock);
+
+    return loaded;
+}
+
+/**
+ * Find the first group of which the user is a member.
+ * @param ldapUser The user's entry.
+ * @param group On success, set to the user's first group, or nil if
+ * the user is a member of no group.
+ * @return NO if no current snapshot is available, in which case the
+ * user's membership must be checked against the directory.
+ */
+- (BOOL) findGroupForUser: (TRLDAPEntry *) ldapUser group: (TRLDAPGroupConfig **) group {
+    TRLDAPGroupSnapshotIndex *index;
+
+    pthread_mutex_lock(&_lock);
+    index = [_index retain];
+    pthread_mutex_unlock(&_lock);
+
+    if (!index)
+        return NO;
+
+    if (snapshot_now() - [index loaded] > (time_t) _interval * 2) {
+        [index release];
+        return NO;
+    }
+
+    *group = [index groupForUser: ldapUser];
+    [index release];
+
+    return YES;
+}
+
+@end
@@ -0,0 +1,165 @@
+/*
+ * TRLDAPSearchEnumerator.m vi:ts=4:sw=4:expandtab:
+ * Streaming LDAP search results
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "TRLDAPSearchEnumerator.h"
+
+@interface TRLDAPSearchEnumerator (Private)
+- (BOOL) sendRequest;
+@end
+
+@implementation TRLDAPSearchEnumerator (Private)
+
+/**
+ * Send the search, or request its next page.
+ */
+- (BOOL) sendRequest {
+    _msgid = [_connection sendSearchWithFilter: _filter
+        scope: _scope
+        baseDN: _baseDN
+        attributes: _attributes
+        sizeLimit: _sizeLimit
+        timeLimit: _timeLimit
+        pageSize: _pageSize
+        cookie: _cookie.bv_len > 0 ? &_cookie : NULL];
+
+    if (_msgid < 0) {
+        _finished = YES;
+        _succeeded = NO;
+        return NO;
+    }
+
+    _finished = NO;
+    _succeeded = NO;
+    return YES;
+}
+
+@end
+
+/**
+ * Enumerates the entries returned by a search, receiving each entry
+ * from the server as it is requested. Entries are never accumulated,
+ * so memory use does not grow with the size of the result set. Paged
+ * searches request each page only once the previous page is consumed.
+ */
+@implementation TRLDAPSearchEnumerator
+
+/**
+ * Initialize a new enumerator, and send the search.
+ * @param connection: The connection on which to search.
+ * @param pageSize: Number of entries per page, or 0 to disable paging.
+ * @return: nil if the search could not be sent.
+ */
+- (id) initWithConnection: (TRLDAPConnection *) connection
+       filter: (TRString *) filter
+       scope: (int) scope
+       baseDN: (TRString *) base
+       attributes: (TRArray *) attributes
+       sizeLimit: (int) sizeLimit
+       timeLimit: (int) timeLimit
+       pageSize: (int) pageSize
+{
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _connection = [connection retain];
+    _filter = [filter retain];
+    _scope = scope;
+    _baseDN = [base retain];
+    _attributes = [attributes retain];
+    _sizeLimit = sizeLimit;
+    _timeLimit = timeLimit;
+    _pageSize = pageSize;
+
+    if (![self sendRequest]) {
+        [self release];
+        return nil;
+    }
+
+    return self;
+}
+
+- (void) dealloc {
+    /* Don't leave the rest of the results queued on the connection */
+    if (!_finished)
+        [_connection abandon: _msgid];
+
+    if (_cookie.bv_val)
+        ber_memfree(_cookie.bv_val);
+
+    [_connection release];
+    [_filter release];
+    [_baseDN release];
+    [_attributes release];
+    [super dealloc];
+}
+
+/**
+ * Return the next entry, or nil once the search has finished.
+ */
+- (id) nextObject {
+    TRLDAPEntry *entry;
+
+    while (!_finished) {
+        entry = [_connection nextEntryForSearch: _msgid
+            cookie: _pageSize > 0 ? &_cookie : NULL
+            finished: &_finished
+            succeeded: &_succeeded];
+        if (entry)
+            return entry;
+
+        /* Request the next page, if the server returned a cookie */
+        if (_finished && _succeeded && _cookie.bv_len > 0) {
+            if (![self sendRequest])
+                return nil;
+        }
+    }
+
+    return nil;
+}
+
+/**
+ * Returns YES once all results have been received, or the search failed.
+ */
+- (BOOL) finished {
+    return _finished;
+}
+
+/**
+ * Returns YES if the search ran to completion without error. Entries
+ * returned by a search that did not succeed may be incomplete.
+ */
+- (BOOL) succeeded {
+    return _succeeded;
+}
+
+@end
@@ -38,9 +38,21 @@
 @interface TRLDAPSearchFilter : TRObject {
 @private
     TRString *_format;
+
+    /* The format's literal text, split at each format specifier */
+    struct _TRLDAPSearchFilterSegment *_segments;
+    unsigned int _segmentCount;
+    size_t _literalLength;
 }
 
++ (size_t) escapedLength: (const char *) value length: (size_t) length;
++ (size_t) escape: (const char *) value length: (size_t) length buffer: (char *) buffer;
++ (TRString *) escapeString: (TRString *) string;
+
 - (id) initWithFormat: (TRString *) format;
+- (id) initWithFormat: (TRString *) format specifier: (const char *) specifier;
+- (TRString *) format;
 - (TRString *) getFilter: (TRString *) subString;
+- (TRString *) getFilterWithCString: (const char *) subString;
 
 @end
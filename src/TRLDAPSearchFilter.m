@@ -33,11 +33,68 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#import <string.h>
+
 #import "TRLDAPSearchFilter.h"
-#import "TRAutoreleasePool.h"
+
+#import "xmalloc.h"
+
+/* A run of literal text from the format string */
+typedef struct _TRLDAPSearchFilterSegment {
+    const char *bytes;
+    size_t length;
+} TRLDAPSearchFilterSegment;
+
+/*
+ * Characters that must be escaped in an RFC 4515 assertion value:
+ * NUL, '(', ')', '*' and '\'. Non-zero entries are escaped.
+ */
+static const unsigned char escape_table[256] = {
+    [0x00] = 1,
+    ['('] = 1,
+    [')'] = 1,
+    ['*'] = 1,
+    ['\\'] = 1
+};
+
+static const char hex_digits[] = "0123456789abcdef";
 
 @interface TRLDAPSearchFilter (TRLDAPSearchFilterPrivate)
- - (TRString *) escapeForSearch: (TRString *) string;
+- (TRString *) getFilter: (const char *) subString length: (size_t) length;
+@end
+
+@implementation TRLDAPSearchFilter (TRLDAPSearchFilterPrivate)
+
+/**
+ * Return a search filter string, substituting all format specifiers
+ * with the escaped value. The result is the only allocation.
+ */
+- (TRString *) getFilter: (const char *) subString length: (size_t) length {
+    TRLDAPSearchFilterSegment *segment;
+    size_t quotedLength;
+    size_t filterLength;
+    char *buffer, *p;
+    unsigned int i;
+
+    /* Assemble the filter in a single, exactly sized buffer */
+    quotedLength = [TRLDAPSearchFilter escapedLength: subString length: length];
+    filterLength = _literalLength + quotedLength * (_segmentCount - 1);
+    buffer = xmalloc(filterLength + 1);
+
+    p = buffer;
+    for (i = 0; i < _segmentCount; i++) {
+        segment = &_segments[i];
+        memcpy(p, segment->bytes, segment->length);
+        p += segment->length;
+
+        if (i + 1 < _segmentCount)
+            p += [TRLDAPSearchFilter escape: subString length: length buffer: p];
+    }
+    *p = '\0';
+
+    return [[[TRString alloc] initWithBytesNoCopy: buffer numBytes: filterLength] autorelease];
+}
+
 @end
 
 @implementation TRLDAPSearchFilter
@@ -48,11 +105,48 @@
  * provided substitute string when -[TRLDAPSearchFilter getFilter] is called.
  */
 - (id) initWithFormat: (TRString *) format {
+    return [self initWithFormat: format specifier: "%s"];
+}
+
+/**
+ * Initialize with the given format string and format specifier.
+ * The format is split at each occurrence of the specifier once, here,
+ * so that building a filter requires only a single allocation.
+ */
+- (id) initWithFormat: (TRString *) format specifier: (const char *) specifier {
+    const char *start, *p;
+    size_t specifierLength;
+    unsigned int i;
+
     self = [super init];
     if (self == nil)
         return nil;
 
     _format = [format retain];
+    specifierLength = strlen(specifier);
+
+    /* Count the literal segments; there is one more than the
+     * number of specifiers */
+    _segmentCount = 1;
+    for (p = strstr([_format cString], specifier); p != NULL; p = strstr(p + specifierLength, specifier))
+        _segmentCount++;
+
+    _segments = xmalloc(sizeof(TRLDAPSearchFilterSegment) * _segmentCount);
+
+    /* Record each segment. The segments point into the retained format. */
+    start = [_format cString];
+    i = 0;
+    for (p = strstr(start, specifier); p != NULL; p = strstr(start, specifier)) {
+        _segments[i].bytes = start;
+        _segments[i].length = p - start;
+        _literalLength += _segments[i].length;
+        start = p + specifierLength;
+        i++;
+    }
+
+    _segments[i].bytes = start;
+    _segments[i].length = strlen(start);
+    _literalLength += _segments[i].length;
 
     return self;
 }
@@ -61,108 +155,100 @@
     /* Release our format string */
     [_format release];
 
+    if (_segments)
+        free(_segments);
+
     /* Deallocate superclass */
     [super dealloc];
 }
 
 /**
- * Escape the provided string according to RFC 2254, escaping
- * any special LDAP search characters.
+ * Returns the format string.
  */
-- (TRString *) escapeForSearch: (TRString *) string {
-    const char specialChars[] = "*()\\"; /* RFC 2254. We don't care about NULL */
-    TRString *result = [[TRString alloc] init];
-    TRString *unquotedString, *part;
-    TRAutoreleasePool *pool = [[TRAutoreleasePool alloc] init];
-
-    /* Retain an instance of the string */
-    unquotedString = [string retain];
-
-    /* Initialize the result */
-    result = [[TRString alloc] init];
-
-    /* Quote all occurrences of the special characters */
-    while ((part = [unquotedString substringToCharset: specialChars]) != NULL) {
-        TRString *temp;
-        size_t index;
-        char c;
-
-        /* Append everything until the first special character */
-        [result appendString: part];
-
-        /* Append the backquote */
-        [result appendCString: "\\"];
+- (TRString *) format {
+    return _format;
+}
 
-        /* Get the special character */
-        index = [unquotedString indexToCharset: specialChars];
-        temp = [unquotedString substringFromIndex: index];
-        c = [temp charAtIndex: 0];
+/**
+ * Returns the length of the given value once escaped according to
+ * RFC 4515, not including a NUL terminator.
+ */
++ (size_t) escapedLength: (const char *) value length: (size_t) length {
+    size_t escapedLength;
+    size_t i;
 
-        /* Append it, too! */
-        [result appendChar: c];
+    /* Each special character becomes a three character \XX escape */
+    escapedLength = length;
+    for (i = 0; i < length; i++)
+        escapedLength += escape_table[(unsigned char) value[i]] * 2;
 
-        /* Move unquotedString past the special character */
-        temp = [[unquotedString substringFromCharset: specialChars] retain];
+    return escapedLength;
+}
 
-        [unquotedString release];
-        unquotedString = temp;
+/**
+ * Escape the given value according to RFC 4515, replacing each special
+ * character with a \XX hex escape. The buffer must hold at least
+ * escapedLength:length: bytes; it is not NUL-terminated.
+ * @return: The number of bytes written.
+ */
++ (size_t) escape: (const char *) value length: (size_t) length buffer: (char *) buffer {
+    const char *end = value + length;
+    const char *run;
+    char *p = buffer;
+    unsigned char c;
+
+    while (value < end) {
+        /* Copy the run of characters that need no escaping */
+        run = value;
+        while (value < end && !escape_table[(unsigned char) *value])
+            value++;
+        memcpy(p, run, value - run);
+        p += value - run;
+
+        if (value == end)
+            break;
+
+        /* Escape the special character */
+        c = (unsigned char) *value++;
+        *p++ = '\\';
+        *p++ = hex_digits[c >> 4];
+        *p++ = hex_digits[c & 0xf];
     }
 
-    /* Append the remainder, if any */
-    if (unquotedString) {
-        [result appendString: unquotedString];
-        [unquotedString release];
-    }
+    return p - buffer;
+}
 
-    [pool release];
+/**
+ * Return an autoreleased copy of the given string, escaped
+ * according to RFC 4515 for use as a filter assertion value.
+ */
++ (TRString *) escapeString: (TRString *) string {
+    size_t length, escapedLength;
+    char *buffer;
 
-    return (result);
+    length = [string length] - 1;
+    escapedLength = [self escapedLength: [string cString] length: length];
+    buffer = xmalloc(escapedLength + 1);
+    [self escape: [string cString] length: length buffer: buffer];
+    buffer[escapedLength] = '\0';
+
+    return [[[TRString alloc] initWithBytesNoCopy: buffer numBytes: escapedLength] autorelease];
 }
 
 /**
- * Return a search filter string, substituting all %s format
+ * Return a search filter string, substituting all format
  * specifiers with the provided subString.
  */
 - (TRString *) getFilter: (TRString *) subString {
-    TRString *templateString;
-    TRString *result, *part;
-    TRString *quotedName;
-    const char userFormat[] = "%s";
-    TRAutoreleasePool *pool = [[TRAutoreleasePool alloc] init];
-
-    /* Retain the template */
-    templateString = [[_format retain] autorelease];
-
-    /* Initialize the result */
-    result = [[TRString alloc] init];
-
-    /* Quote the sub string */
-    quotedName = [self escapeForSearch: subString];
-
-    while ((part = [templateString substringToCString: userFormat]) != NULL) {
-        TRString *temp;
-
-        /* Append everything until the first %u */
-        [result appendString: part];
-
-        /* Append the username */
-        [result appendString: quotedName];
-
-        /* Move templateString past the %u */
-        temp = [templateString substringFromCString: userFormat];
-        templateString = temp;
-    }
-
-    [quotedName release];
-
-    /* Append the remainder, if any */
-    if (templateString) {
-        [result appendString: templateString];
-    }
-
-    [pool release];
+    return [self getFilter: [subString cString] length: [subString length] - 1];
+}
 
-    return [result autorelease];
+/**
+ * Return a search filter string, substituting all format
+ * specifiers with the provided C string.
+ */
+- (TRString *) getFilterWithCString: (const char *) subString {
+    return [self getFilter: subString length: strlen(subString)];
 }
 
 @end
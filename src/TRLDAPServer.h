@@ -0,0 +1,97 @@
+/*
+ * TRLDAPServer.h vi:ts=4:sw=4:expandtab:
+ * LDAP replica health and load accounting
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <pthread.h>
+#import <time.h>
+
+#import "TRObject.h"
+#import "TRString.h"
+
+/* Number of recent response times retained for percentile estimates */
+#define TRLDAPSERVER_RESPONSE_SAMPLES 128
+
+/* Consecutive failures after which a server in good health is ejected */
+#define TRLDAPSERVER_EJECTION_THRESHOLD 3
+
+@interface TRLDAPServer : TRObject {
+@private
+    TRString *_url;
+    pthread_mutex_t _lock;
+
+    /* Requests currently leased to this server */
+    unsigned int _outstanding;
+
+    /* Smoothed request latency, in milliseconds; 0 if unknown */
+    double _latency;
+
+    /* Ring of recent search response times, in milliseconds */
+    double _responseTimes[TRLDAPSERVER_RESPONSE_SAMPLES];
+    unsigned int _responseCount;
+    unsigned int _responseNext;
+
+    /* Most recent resumable TLS session (an SSL_SESSION), if any,
+     * and handshake statistics */
+    void *_tlsSession;
+    unsigned long _tlsHandshakes;
+    unsigned long _tlsResumptions;
+
+    /* Ejection state */
+    unsigned int _failures;
+    unsigned int _ejections;
+    time_t _ejectedUntil;
+}
+
+- (id) initWithURL: (TRString *) url;
+- (TRString *) url;
+
+- (BOOL) isAvailable;
+- (BOOL) admitRequest;
+- (time_t) ejectedUntil;
+- (unsigned int) outstanding;
+- (double) latency;
+- (double) load;
+
+- (void) acquire;
+- (void) relinquish;
+- (void) recordSuccessWithLatency: (double) milliseconds;
+- (void) recordFailure;
+
+- (void) addResponseTime: (double) milliseconds;
+- (double) responseTimePercentile: (double) percentile;
+
+- (void *) copyTLSSession;
+- (void) setTLSSession: (void *) session;
+- (void) recordTLSHandshake: (BOOL) resumed;
+- (unsigned long) tlsHandshakes;
+- (unsigned long) tlsResumptions;
+
+@end
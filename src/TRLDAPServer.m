@@ -0,0 +1,390 @@
+/*
+ * TRLDAPServer.m vi:ts=4:sw=4:expandtab:
+ * LDAP replica health and load accounting
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import <stdlib.h>
+#import <string.h>
+
+#ifdef HAVE_LDAP_TLS_RESUMPTION
+#import <openssl/ssl.h>
+#endif
+
+#import "TRLDAPServer.h"
+#import "TRLog.h"
+
+/* Initial ejection period, in seconds. Doubled on each subsequent
+ * ejection, up to EJECTION_MAX */
+#define EJECTION_BASE 5
+#define EJECTION_MAX 300
+
+/* Time, in seconds, allowed for the single request admitted once an
+ * ejection has elapsed, before another request is admitted in its place */
+#define PROBE_WINDOW 30
+
+/* Weight given to each new latency sample */
+#define LATENCY_SMOOTHING 0.2
+
+static int compare_doubles (const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    if (x < y)
+        return -1;
+    return (x > y);
+}
+
+/**
+ * Tracks the load and health of a single LDAP server (replica).
+ *
+ * The server acts as a circuit breaker. TRLDAPSERVER_EJECTION_THRESHOLD
+ * consecutive failures eject the server (open the circuit) for an
+ * exponentially increasing period, during which no requests are admitted;
+ * a single dropped connection does not. Once that period has elapsed a
+ * single request is admitted as a health check (half-open); it either
+ * reinstates the server (closes the circuit) or, on its first failure,
+ * ejects it again for longer.
+ *
+ * All methods are thread-safe.
+ */
+@implementation TRLDAPServer
+
+/**
+ * Initialize a new server.
+ * @param url LDAP URL of the server.
+ */
+- (id) initWithURL: (TRString *) url {
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _url = [url retain];
+    pthread_mutex_init(&_lock, NULL);
+
+    return self;
+}
+
+- (void) dealloc {
+    [self setTLSSession: NULL];
+    [_url release];
+    pthread_mutex_destroy(&_lock);
+    [super dealloc];
+}
+
+/**
+ * Return the server's LDAP URL.
+ */
+- (TRString *) url {
+    return _url;
+}
+
+/**
+ * Returns YES if the server has not been ejected, or its ejection
+ * period has elapsed.
+ */
+- (BOOL) isAvailable {
+    return ([self ejectedUntil] <= time(NULL));
+}
+
+/**
+ * Decide whether a request may be sent to the server. Always YES for
+ * a server in good health. Once an ejection has elapsed, only the first
+ * request is admitted, as a health check; others are refused until it
+ * completes, or until PROBE_WINDOW seconds have passed.
+ */
+- (BOOL) admitRequest {
+    BOOL admit = YES;
+    time_t now;
+
+    now = time(NULL);
+
+    pthread_mutex_lock(&_lock);
+    if (_ejections > 0) {
+        if (now < _ejectedUntil)
+            admit = NO;
+        else
+            _ejectedUntil = now + PROBE_WINDOW;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    return admit;
+}
+
+/**
+ * Return the time at which the server's current ejection ends, or
+ * 0 if it has never been ejected.
+ */
+- (time_t) ejectedUntil {
+    time_t until;
+
+    pthread_mutex_lock(&_lock);
+    until = _ejectedUntil;
+    pthread_mutex_unlock(&_lock);
+
+    return until;
+}
+
+/**
+ * Return the number of requests currently leased to this server.
+ */
+- (unsigned int) outstanding {
+    unsigned int outstanding;
+
+    pthread_mutex_lock(&_lock);
+    outstanding = _outstanding;
+    pthread_mutex_unlock(&_lock);
+
+    return outstanding;
+}
+
+/**
+ * Return the smoothed request latency, in milliseconds, or 0 if no
+ * request has yet completed.
+ */
+- (double) latency {
+    double latency;
+
+    pthread_mutex_lock(&_lock);
+    latency = _latency;
+    pthread_mutex_unlock(&_lock);
+
+    return latency;
+}
+
+/**
+ * Return the expected cost of sending another request to this server:
+ * the number of requests that would be outstanding, weighted by the
+ * server's latency. Servers with lower load are preferred. With no
+ * latency samples, this reduces to least outstanding requests.
+ */
+- (double) load {
+    double load;
+
+    pthread_mutex_lock(&_lock);
+    load = (_outstanding + 1) * (_latency < 1.0 ? 1.0 : _latency);
+    pthread_mutex_unlock(&_lock);
+
+    return load;
+}
+
+/**
+ * Record the start of a request.
+ */
+- (void) acquire {
+    pthread_mutex_lock(&_lock);
+    _outstanding++;
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Record the end of a request started with -acquire.
+ */
+- (void) relinquish {
+    pthread_mutex_lock(&_lock);
+    if (_outstanding > 0)
+        _outstanding--;
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Record a successful request, reinstating the server if it
+ * had been ejected.
+ * @param milliseconds Time taken by the request.
+ */
+- (void) recordSuccessWithLatency: (double) milliseconds {
+    BOOL reinstated = NO;
+
+    pthread_mutex_lock(&_lock);
+    if (_latency == 0)
+        _latency = milliseconds;
+    else
+        _latency += LATENCY_SMOOTHING * (milliseconds - _latency);
+
+    if (_ejections > 0) {
+        reinstated = YES;
+        _ejections = 0;
+        _ejectedUntil = 0;
+    }
+    _failures = 0;
+    pthread_mutex_unlock(&_lock);
+
+    if (reinstated)
+        [TRLog info: "LDAP server %s reinstated.", [_url cString]];
+}
+
+/**
+ * Record a failed request, ejecting the server if the failure
+ * threshold has been reached, or if it has not been reinstated
+ * since its last ejection.
+ */
+- (void) recordFailure {
+    unsigned int period = 0;
+
+    pthread_mutex_lock(&_lock);
+    _failures++;
+    if (_failures >= TRLDAPSERVER_EJECTION_THRESHOLD || _ejections > 0) {
+        period = EJECTION_BASE;
+        if (_ejections < 16)
+            period <<= _ejections;
+        if (period > EJECTION_MAX)
+            period = EJECTION_MAX;
+
+        _ejections++;
+        _ejectedUntil = time(NULL) + period;
+        _failures = 0;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (period)
+        [TRLog warning: "LDAP server %s ejected for %u seconds.", [_url cString], period];
+}
+
+/**
+ * Record the time taken by the server to answer a single request. For a
+ * request abandoned unanswered, record the time it had waited.
+ */
+- (void) addResponseTime: (double) milliseconds {
+    pthread_mutex_lock(&_lock);
+    _responseTimes[_responseNext] = milliseconds;
+    _responseNext = (_responseNext + 1) % TRLDAPSERVER_RESPONSE_SAMPLES;
+    if (_responseCount < TRLDAPSERVER_RESPONSE_SAMPLES)
+        _responseCount++;
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Estimate a percentile of the server's recent response times.
+ * @param percentile Percentile to return, from 0 to 100.
+ * @return The response time, in milliseconds, or 0 if none have
+ * been recorded.
+ */
+- (double) responseTimePercentile: (double) percentile {
+    double samples[TRLDAPSERVER_RESPONSE_SAMPLES];
+    unsigned int count, index;
+
+    pthread_mutex_lock(&_lock);
+    count = _responseCount;
+    memcpy(samples, _responseTimes, sizeof(double) * count);
+    pthread_mutex_unlock(&_lock);
+
+    if (count == 0)
+        return 0;
+
+    qsort(samples, count, sizeof(double), compare_doubles);
+
+    index = (unsigned int) ((count - 1) * percentile / 100.0 + 0.5);
+    if (index >= count)
+        index = count - 1;
+    return samples[index];
+}
+
+/**
+ * Return a new reference to the server's most recent TLS session, for
+ * resumption by a new connection, or NULL. The caller must free the
+ * returned SSL_SESSION.
+ */
+- (void *) copyTLSSession {
+    void *session = NULL;
+
+#ifdef HAVE_LDAP_TLS_RESUMPTION
+    pthread_mutex_lock(&_lock);
+    if (_tlsSession && SSL_SESSION_up_ref(_tlsSession))
+        session = _tlsSession;
+    pthread_mutex_unlock(&_lock);
+#endif
+
+    return session;
+}
+
+/**
+ * Remember a TLS session (an SSL_SESSION) established with the server,
+ * replacing any previous session. A new reference is taken; the caller
+ * retains its own. Pass NULL to forget the current session.
+ */
+- (void) setTLSSession: (void *) session {
+#ifdef HAVE_LDAP_TLS_RESUMPTION
+    void *old;
+
+    if (session && !SSL_SESSION_up_ref(session))
+        session = NULL;
+
+    pthread_mutex_lock(&_lock);
+    old = _tlsSession;
+    _tlsSession = session;
+    pthread_mutex_unlock(&_lock);
+
+    if (old)
+        SSL_SESSION_free(old);
+#endif
+}
+
+/**
+ * Record a completed TLS handshake.
+ * @param resumed YES if a previous session was resumed.
+ */
+- (void) recordTLSHandshake: (BOOL) resumed {
+    pthread_mutex_lock(&_lock);
+    _tlsHandshakes++;
+    if (resumed)
+        _tlsResumptions++;
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Return the number of TLS handshakes completed with the server.
+ */
+- (unsigned long) tlsHandshakes {
+    unsigned long count;
+
+    pthread_mutex_lock(&_lock);
+    count = _tlsHandshakes;
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+/**
+ * Return the number of TLS handshakes that resumed a previous session.
+ */
+- (unsigned long) tlsResumptions {
+    unsigned long count;
+
+    pthread_mutex_lock(&_lock);
+    count = _tlsResumptions;
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+@end
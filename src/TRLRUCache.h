@@ -0,0 +1,74 @@
+/*
+ * TRLRUCache.h vi:ts=4:sw=4:expandtab:
+ * Bounded, expiring least-recently-used cache
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <pthread.h>
+#import <time.h>
+
+#import "TRObject.h"
+#import "TRString.h"
+#import "TRHash.h"
+
+@class TRLRUCacheEntry;
+
+/**
+ * Predicate used to select cached objects for removal.
+ * @param object A cached object.
+ * @param context Caller-supplied context.
+ * @return YES if the object should be removed.
+ */
+typedef BOOL (*TRLRUCachePredicate)(id object, void *context);
+
+@interface TRLRUCache : TRObject {
+@private
+    pthread_mutex_t _lock;
+
+    /* Key to entry index */
+    TRHash *_index;
+
+    /* Entries, ordered from most to least recently used */
+    TRLRUCacheEntry *_head;
+    TRLRUCacheEntry *_tail;
+
+    unsigned int _count;
+    unsigned int _capacity;
+    time_t _ttl;
+}
+
+- (id) initWithCapacity: (unsigned int) capacity ttl: (unsigned int) seconds;
+- (id) objectForKey: (TRString *) key;
+- (void) setObject: (id) object forKey: (TRString *) key;
+- (void) removeObjectForKey: (TRString *) key;
+- (void) removeAllObjects;
+- (void) removeObjectsMatching: (TRLRUCachePredicate) predicate context: (void *) context;
+- (unsigned int) count;
+
+@end
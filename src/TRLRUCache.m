@@ -0,0 +1,292 @@
+/*
+ * TRLRUCache.m vi:ts=4:sw=4:expandtab:
+ * Bounded, expiring least-recently-used cache
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "TRLRUCache.h"
+
+/* Monotonic clock, in seconds, immune to wall clock adjustments */
+static time_t cache_now (void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+/**
+ * A single cache entry, linked into the cache's LRU list.
+ */
+@interface TRLRUCacheEntry : TRObject {
+@public
+    TRString *_key;
+    id _value;
+    time_t _expires;
+    TRLRUCacheEntry *_prev;
+    TRLRUCacheEntry *_next;
+}
+
+- (id) initWithKey: (TRString *) key value: (id) value expires: (time_t) expires;
+
+@end
+
+@implementation TRLRUCacheEntry
+
+- (id) initWithKey: (TRString *) key value: (id) value expires: (time_t) expires {
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _key = [key retain];
+    _value = [value retain];
+    _expires = expires;
+    _prev = nil;
+    _next = nil;
+
+    return self;
+}
+
+- (void) dealloc {
+    [_key release];
+    [_value release];
+    [super dealloc];
+}
+
+@end
+
+
+@interface TRLRUCache (Private)
+- (void) unlinkEntry: (TRLRUCacheEntry *) entry;
+- (void) linkEntry: (TRLRUCacheEntry *) entry;
+- (void) removeEntry: (TRLRUCacheEntry *) entry;
+@end
+
+@implementation TRLRUCache (Private)
+
+/* The following methods must be called with _lock held */
+
+/** Remove the entry from the LRU list. */
+- (void) unlinkEntry: (TRLRUCacheEntry *) entry {
+    if (entry->_prev)
+        entry->_prev->_next = entry->_next;
+    else
+        _head = entry->_next;
+
+    if (entry->_next)
+        entry->_next->_prev = entry->_prev;
+    else
+        _tail = entry->_prev;
+
+    entry->_prev = nil;
+    entry->_next = nil;
+}
+
+/** Insert the entry at the head (most recently used end) of the LRU list. */
+- (void) linkEntry: (TRLRUCacheEntry *) entry {
+    entry->_prev = nil;
+    entry->_next = _head;
+
+    if (_head)
+        _head->_prev = entry;
+    else
+        _tail = entry;
+
+    _head = entry;
+}
+
+/** Remove the entry from the cache entirely. */
+- (void) removeEntry: (TRLRUCacheEntry *) entry {
+    [self unlinkEntry: entry];
+    _count--;
+
+    /* The index holds the only reference to the entry */
+    [_index removeObjectForKey: entry->_key];
+}
+
+@end
+
+
+/**
+ * A thread-safe cache holding at most a fixed number of objects, each for a
+ * fixed time-to-live. When full, the least recently used object is evicted
+ * to make room for new additions.
+ */
+@implementation TRLRUCache
+
+/**
+ * Initialize a new cache.
+ * @param capacity Maximum number of cached objects.
+ * @param seconds Time, in seconds, for which an object remains valid.
+ */
+- (id) initWithCapacity: (unsigned int) capacity ttl: (unsigned int) seconds {
+    self = [self init];
+    if (!self)
+        return nil;
+
+    pthread_mutex_init(&_lock, NULL);
+
+    _index = [[TRHash alloc] initWithCapacity: capacity];
+    _head = nil;
+    _tail = nil;
+    _count = 0;
+    _capacity = capacity;
+    _ttl = seconds;
+
+    return self;
+}
+
+- (void) dealloc {
+    /* Releases all entries */
+    [_index release];
+    pthread_mutex_destroy(&_lock);
+    [super dealloc];
+}
+
+/**
+ * Returns the object cached for key, or nil if there is no
+ * cached object, or the object has expired.
+ */
+- (id) objectForKey: (TRString *) key {
+    TRLRUCacheEntry *entry;
+    id value = nil;
+
+    pthread_mutex_lock(&_lock);
+
+    entry = [_index valueForKey: key];
+    if (entry) {
+        if (cache_now() >= entry->_expires) {
+            /* Expired */
+            [self removeEntry: entry];
+        } else {
+            /* Mark as most recently used */
+            [self unlinkEntry: entry];
+            [self linkEntry: entry];
+
+            /* Keep the value alive past any concurrent eviction */
+            value = [[entry->_value retain] autorelease];
+        }
+    }
+
+    pthread_mutex_unlock(&_lock);
+
+    return value;
+}
+
+/**
+ * Cache object for key, replacing any existing object, and evicting
+ * the least recently used object if the cache is full.
+ * Both the key and object are retained.
+ */
+- (void) setObject: (id) object forKey: (TRString *) key {
+    TRLRUCacheEntry *entry;
+
+    pthread_mutex_lock(&_lock);
+
+    /* Drop any existing entry */
+    entry = [_index valueForKey: key];
+    if (entry)
+        [self removeEntry: entry];
+
+    if (_capacity > 0) {
+        /* Make room */
+        while (_count >= _capacity)
+            [self removeEntry: _tail];
+
+        entry = [[TRLRUCacheEntry alloc] initWithKey: key value: object expires: cache_now() + _ttl];
+        [_index setObject: entry forKey: key];
+        [self linkEntry: entry];
+        _count++;
+        [entry release];
+    }
+
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Remove the object cached for key, if any.
+ */
+- (void) removeObjectForKey: (TRString *) key {
+    TRLRUCacheEntry *entry;
+
+    pthread_mutex_lock(&_lock);
+
+    entry = [_index valueForKey: key];
+    if (entry)
+        [self removeEntry: entry];
+
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Remove all cached objects.
+ */
+- (void) removeAllObjects {
+    pthread_mutex_lock(&_lock);
+
+    while (_tail)
+        [self removeEntry: _tail];
+
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Remove every cached object for which predicate returns YES.
+ * The predicate is called with the cache locked, and must not
+ * access the cache.
+ */
+- (void) removeObjectsMatching: (TRLRUCachePredicate) predicate context: (void *) context {
+    TRLRUCacheEntry *entry;
+    TRLRUCacheEntry *next;
+
+    pthread_mutex_lock(&_lock);
+
+    for (entry = _head; entry != nil; entry = next) {
+        next = entry->_next;
+        if (predicate(entry->_value, context))
+            [self removeEntry: entry];
+    }
+
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Returns the number of cached objects, including any
+ * that have expired but not yet been removed.
+ */
+- (unsigned int) count {
+    unsigned int count;
+
+    pthread_mutex_lock(&_lock);
+    count = _count;
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+@end
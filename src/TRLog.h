@@ -32,6 +32,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#import <stdarg.h>
+
 #import "TRObject.h"
 
 typedef enum {
@@ -41,9 +43,16 @@ typedef enum {
     TRLOG_DEBUG
 } loglevel_t;
 
+/**
+ * Log handler function. A registered handler receives all log messages in
+ * place of the default syslog and stderr output.
+ */
+typedef void (*TRLogHandler)(loglevel_t level, const char *message, va_list args);
+
 @interface TRLog : TRObject
 
 + (void) _quiesceLogging: (BOOL) quiesce;
++ (void) setHandler: (TRLogHandler) handler;
 
 #define DO_LOG_DECL(logName) \
     /** Log a logname message */ \
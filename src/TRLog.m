@@ -39,6 +39,7 @@
 #import "TRLog.h"
 
 static BOOL _quiesce = NO;
+static TRLogHandler _handler = NULL;
 
 /** Log a message to stderr. */
 static void log_stderr(const char *message, va_list args) {
@@ -64,12 +65,25 @@ static void log_syslog(int priority, const char *message, va_list args) {
     _quiesce = quiesce;
 }
 
-#define DO_LOG(logName, priority) \
+/**
+ * Register a handler to receive all log messages, in place of
+ * syslog and stderr. Pass NULL to restore the default behavior.
+ */
++ (void) setHandler: (TRLogHandler) handler {
+    _handler = handler;
+}
+
+#define DO_LOG(logName, priority, level) \
     /** Log a priority message. */ \
     + (void) logName: (const char *) message, ... { \
         va_list ap; \
         if (_quiesce) return; \
         va_start(ap, message); \
+        if (_handler) { \
+            _handler(level, message, ap); \
+            va_end(ap); \
+            return; \
+        } \
         log_syslog(priority, message, ap); \
         va_end(ap); \
         va_start(ap, message); \
@@ -77,10 +91,10 @@ static void log_syslog(int priority, const char *message, va_list args) {
         va_end(ap); \
     }
 
-DO_LOG(error, LOG_ERR);
-DO_LOG(warning, LOG_WARNING);
-DO_LOG(info, LOG_INFO);
-DO_LOG(debug, LOG_DEBUG);
+DO_LOG(error, LOG_ERR, TRLOG_ERR);
+DO_LOG(warning, LOG_WARNING, TRLOG_WARNING);
+DO_LOG(info, LOG_INFO, TRLOG_INFO);
+DO_LOG(debug, LOG_DEBUG, TRLOG_DEBUG);
 
 #undef DO_LOG
 
@@ -94,6 +108,14 @@ DO_LOG(debug, LOG_DEBUG);
     /* Logging quiesced for debugging. */
     if (_quiesce) return;
 
+    /* Hand the message to the registered handler, if any */
+    if (_handler) {
+        va_start(ap, message);
+        _handler(level, message, ap);
+        va_end(ap);
+        return;
+    }
+
     /* Map the TRLog log level to a syslog priority. */
     switch (level) {
         case TRLOG_ERR:
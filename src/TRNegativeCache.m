@@ -0,0 +1,200 @@
+/*
+ * TRNegativeCache.m vi:ts=4:sw=4:expandtab:
+ * Cache of unknown users and failed authentication attempts
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <ctype.h>
+#import <string.h>
+
+#import "TRNegativeCache.h"
+
+#import "xmalloc.h"
+
+/**
+ * Failed bind cache entry. Records the number of failed binds for an
+ * existing user.
+ */
+@interface TRNegativeCacheEntry : TRObject {
+@public
+    unsigned int _failures;
+}
+@end
+
+@implementation TRNegativeCacheEntry
+@end
+
+/*
+ * Returns the cache key for a username. LDAP user searches are generally
+ * case-insensitive, so all spellings of a name share one entry.
+ */
+static TRString *cache_key (TRString *username) {
+    const char *name = [username cString];
+    size_t length = strlen(name);
+    char *key;
+    size_t i;
+
+    key = xmalloc(length + 1);
+    for (i = 0; i < length; i++)
+        key[i] = tolower((unsigned char) name[i]);
+    key[length] = '\0';
+
+    return [[[TRString alloc] initWithBytesNoCopy: key numBytes: length] autorelease];
+}
+
+
+/**
+ * Remembers usernames that do not exist in the directory, and users with
+ * repeated failed binds, for a short time. Requests for these users can be
+ * rejected without a round trip to the LDAP server, limiting the directory
+ * load generated by password guessing.
+ *
+ * Failures are counted from the first failed bind; the count is discarded
+ * when the entry expires. Usernames are compared case-insensitively.
+ *
+ * Unknown users and failed bind counts are held in separate caches, each
+ * of the given capacity, so that a flood of nonexistent usernames can not
+ * evict the failure counts of real users and reset their lockout.
+ */
+@implementation TRNegativeCache
+
+/**
+ * Initialize a new negative cache.
+ * @param capacity Maximum number of cached unknown users, and of
+ * users with failed binds.
+ * @param seconds Time, in seconds, for which a user is remembered.
+ * @param maxFailures Number of failed binds after which a user is rejected.
+ */
+- (id) initWithCapacity: (unsigned int) capacity ttl: (unsigned int) seconds maxFailures: (unsigned int) maxFailures {
+    self = [self init];
+    if (!self)
+        return nil;
+
+    pthread_mutex_init(&_lock, NULL);
+    _unknownUsers = [[TRLRUCache alloc] initWithCapacity: capacity ttl: seconds];
+    _failedBinds = [[TRLRUCache alloc] initWithCapacity: capacity ttl: seconds];
+    _maxFailures = maxFailures;
+
+    return self;
+}
+
+- (void) dealloc {
+    [_unknownUsers release];
+    [_failedBinds release];
+    pthread_mutex_destroy(&_lock);
+    [super dealloc];
+}
+
+/**
+ * Returns YES if the user is known not to exist, or has
+ * exceeded the maximum number of failed binds.
+ */
+- (BOOL) rejectsUser: (TRString *) username {
+    return [self isUnknownUser: username] || [self isLockedOut: username];
+}
+
+/**
+ * Returns YES if the user is known not to exist.
+ */
+- (BOOL) isUnknownUser: (TRString *) username {
+    return ([_unknownUsers objectForKey: cache_key(username)] != nil);
+}
+
+/**
+ * Returns YES if the user has exceeded the maximum number of failed binds.
+ */
+- (BOOL) isLockedOut: (TRString *) username {
+    TRNegativeCacheEntry *entry;
+    BOOL result = NO;
+
+    pthread_mutex_lock(&_lock);
+    entry = [_failedBinds objectForKey: cache_key(username)];
+    if (entry)
+        result = (entry->_failures >= _maxFailures);
+    pthread_mutex_unlock(&_lock);
+
+    return result;
+}
+
+/**
+ * Record that no such user exists.
+ */
+- (void) addUnknownUser: (TRString *) username {
+    TRString *key = cache_key(username);
+
+    /* Only the key's presence matters */
+    [_unknownUsers setObject: key forKey: key];
+}
+
+/**
+ * Record a failed bind for the user.
+ */
+- (void) addFailureForUser: (TRString *) username {
+    TRNegativeCacheEntry *entry;
+    TRString *key = cache_key(username);
+
+    /* Look up and insert atomically, so that concurrent first
+     * failures are not lost */
+    pthread_mutex_lock(&_lock);
+
+    entry = [_failedBinds objectForKey: key];
+    if (entry) {
+        entry->_failures++;
+    } else {
+        entry = [[TRNegativeCacheEntry alloc] init];
+        entry->_failures = 1;
+        [_failedBinds setObject: entry forKey: key];
+        [entry release];
+    }
+
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Forget the user, eg, after a successful authentication.
+ */
+- (void) removeUser: (TRString *) username {
+    TRString *key = cache_key(username);
+
+    [_unknownUsers removeObjectForKey: key];
+
+    pthread_mutex_lock(&_lock);
+    [_failedBinds removeObjectForKey: key];
+    pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Forget all unknown users, eg, after users have been added to the
+ * directory. Failed bind counts are kept.
+ */
+- (void) removeUnknownUsers {
+    [_unknownUsers removeAllObjects];
+}
+
+@end
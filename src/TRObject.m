@@ -118,7 +118,8 @@
 
 // from TRObject protocol
 - (id) retain {
-    _refCount++;
+    /* Objects may be shared with worker threads; the count must be updated atomically */
+    __sync_add_and_fetch(&_refCount, 1);
     return self;
 }
 
@@ -128,8 +129,7 @@
     assert(_refCount >= 1);
 
     /* Decrement refcount, if zero, dealloc */
-    _refCount--;
-    if (!_refCount)
+    if (__sync_sub_and_fetch(&_refCount, 1) == 0)
         [self dealloc];
 }
 
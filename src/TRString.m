@@ -141,6 +141,22 @@
     return (self);
 }
 
+/**
+ * Initialize with the provided buffer, without copying it. The string
+ * takes ownership of the buffer, which must have been allocated with
+ * malloc() and be NUL-terminated at data[length].
+ */
+- (id) initWithBytesNoCopy: (char *) data numBytes: (size_t) length {
+    self = [self init];
+    if (self != NULL) {
+        numBytes = length + 1;
+        bytes = data;
+    } else {
+        free(data);
+    }
+    return (self);
+}
+
 /**
  * Return the C string value.
  */
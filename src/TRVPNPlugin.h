@@ -48,6 +48,8 @@
 #import "TRArray.h"
 #import "TRAutoreleasePool.h"
 #import "TRHash.h"
+#import "TRLRUCache.h"
+#import "TRWorkQueue.h"
 #import "xmalloc.h"
 
 #import "TRAccountRepository.h"
@@ -59,10 +61,19 @@
 #import "TRAuthLDAPConfig.h"
 #import "TRConfigLexer.h"
 #import "TRLDAPGroupConfig.h"
+#import "TRCredentialCache.h"
+#import "TRNegativeCache.h"
 
 #import "TRLDAPConnection.h"
+#import "TRLDAPChangeMonitor.h"
+#import "TRLDAPConnectionPool.h"
 #import "TRLDAPEntry.h"
+#import "TRLDAPFilter.h"
+#import "TRLDAPGroupEvaluator.h"
+#import "TRLDAPGroupSnapshot.h"
+#import "TRLDAPSearchEnumerator.h"
 #import "TRLDAPSearchFilter.h"
+#import "TRLDAPServer.h"
 #import "TRLDAPAccountRepository.h"
 
 #import "TRPFAddress.h"
@@ -32,15 +32,40 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#import <pthread.h>
+
 #import "TRObject.h"
 #import "TRString.h"
+#import "TRLDAPGroupConfig.h"
 
 @interface TRVPNSession: TRObject {
 @private
     TRString *_username;
+    TRString *_dn;
+    TRLDAPGroupConfig *_groupConfig;
+    TRString *_pfTable;
+    TRString *_installedPFTable;
+    BOOL _authenticated;
+    pthread_mutex_t _lock;
 }
 
 - (id) initWithUsername: (TRString *) username;
 - (TRString *) username;
+- (void) setUsername: (TRString *) username;
+
+- (TRString *) dn;
+- (void) setDN: (TRString *) dn;
+
+- (TRLDAPGroupConfig *) groupConfig;
+- (void) setGroupConfig: (TRLDAPGroupConfig *) groupConfig;
+
+- (TRString *) pfTable;
+- (void) setPFTable: (TRString *) tableName;
+
+- (TRString *) installedPFTable;
+- (void) setInstalledPFTable: (TRString *) tableName;
+
+- (BOOL) isAuthenticated;
+- (void) setAuthenticated: (BOOL) authenticated;
 
 @end
@@ -34,11 +34,41 @@
 
 #import "TRVPNSession.h"
 
+/* Return an object field, retained and autoreleased, under the session lock */
+#define GET_FIELD(field) \
+    id value; \
+    pthread_mutex_lock(&_lock); \
+    value = [[field retain] autorelease]; \
+    pthread_mutex_unlock(&_lock); \
+    return (value);
+
+/* Replace an object field under the session lock */
+#define SET_FIELD(field, value) \
+    id old; \
+    [value retain]; \
+    pthread_mutex_lock(&_lock); \
+    old = field; \
+    field = value; \
+    pthread_mutex_unlock(&_lock); \
+    [old release];
+
 /**
  * VPN session state.
+ *
+ * Sessions are updated by the deferred authentication worker threads,
+ * and read by OpenVPN's thread; all access is serialized.
  */
 @implementation TRVPNSession
 
+- (id) init {
+    self = [super init];
+    if (!self)
+        return nil;
+
+    pthread_mutex_init(&_lock, NULL);
+    return (self);
+}
+
 - (id) initWithUsername: (TRString *) username {
     self = [self init];
     if (!self)
@@ -50,11 +80,80 @@
 
 - (void) dealloc {
     [_username release];
+    [_dn release];
+    [_groupConfig release];
+    [_pfTable release];
+    [_installedPFTable release];
+    pthread_mutex_destroy(&_lock);
     [super dealloc];
 }
 
 - (TRString *) username {
-    return (_username);
+    GET_FIELD(_username);
+}
+
+- (void) setUsername: (TRString *) username {
+    SET_FIELD(_username, username);
+}
+
+/** The authenticated user's LDAP DN. */
+- (TRString *) dn {
+    GET_FIELD(_dn);
+}
+
+- (void) setDN: (TRString *) dn {
+    SET_FIELD(_dn, dn);
+}
+
+/** The group configuration matched at authentication time, if any. */
+- (TRLDAPGroupConfig *) groupConfig {
+    GET_FIELD(_groupConfig);
+}
+
+- (void) setGroupConfig: (TRLDAPGroupConfig *) groupConfig {
+    SET_FIELD(_groupConfig, groupConfig);
+}
+
+/** The packet filter table the client's address is to be placed in, if any. */
+- (TRString *) pfTable {
+    GET_FIELD(_pfTable);
+}
+
+- (void) setPFTable: (TRString *) tableName {
+    SET_FIELD(_pfTable, tableName);
+}
+
+/**
+ * The packet filter table the client's address was added to when the
+ * client connected, if any. Unlike -pfTable, this is not changed by
+ * re-authentication, and is where the address must be removed from.
+ */
+- (TRString *) installedPFTable {
+    GET_FIELD(_installedPFTable);
 }
 
+- (void) setInstalledPFTable: (TRString *) tableName {
+    SET_FIELD(_installedPFTable, tableName);
+}
+
+/** Returns YES if the client has successfully authenticated. */
+- (BOOL) isAuthenticated {
+    BOOL authenticated;
+
+    pthread_mutex_lock(&_lock);
+    authenticated = _authenticated;
+    pthread_mutex_unlock(&_lock);
+
+    return (authenticated);
+}
+
+- (void) setAuthenticated: (BOOL) authenticated {
+    pthread_mutex_lock(&_lock);
+    _authenticated = authenticated;
+    pthread_mutex_unlock(&_lock);
+}
+
+#undef GET_FIELD
+#undef SET_FIELD
+
 @end
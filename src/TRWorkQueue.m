@@ -0,0 +1,210 @@
+/*
+ * TRWorkQueue.m vi:ts=4:sw=4:expandtab:
+ * Bounded work queue serviced by a pool of threads
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <stdlib.h>
+
+#import "TRWorkQueue.h"
+#import "TRAutoreleasePool.h"
+#import "TRLog.h"
+
+#import "xmalloc.h"
+
+@interface TRWorkQueue (Private)
+- (void) runWorker;
+@end
+
+/* Worker thread entry point */
+static void *work_queue_thread (void *arg) {
+    TRWorkQueue *queue = arg;
+    [queue runWorker];
+    return NULL;
+}
+
+@implementation TRWorkQueue (Private)
+
+/**
+ * Worker thread main loop. Runs jobs until the queue is shut down.
+ */
+- (void) runWorker {
+    id job;
+
+    for (;;) {
+        TRAutoreleasePool *pool;
+
+        /* Wait for a job */
+        pthread_mutex_lock(&_lock);
+        while (_count == 0 && !_shutdown)
+            pthread_cond_wait(&_cond, &_lock);
+
+        if (_shutdown) {
+            pthread_mutex_unlock(&_lock);
+            return;
+        }
+
+        job = _jobs[_head];
+        _jobs[_head] = nil;
+        _head = (_head + 1) % _capacity;
+        _count--;
+        pthread_mutex_unlock(&_lock);
+
+        /* Run it */
+        pool = [[TRAutoreleasePool alloc] init];
+        [job run];
+        [job release];
+        [pool release];
+    }
+}
+
+@end
+
+/**
+ * A fixed-size pool of threads servicing a bounded FIFO queue of jobs.
+ *
+ * Jobs are added with -addJob:, which fails immediately (rather than
+ * blocking the caller) if the queue is full.
+ */
+@implementation TRWorkQueue
+
+/**
+ * Initialize a new work queue, starting its worker threads.
+ * @param numThreads Number of worker threads.
+ * @param maxQueued Maximum number of jobs waiting to be run.
+ */
+- (id) initWithThreads: (unsigned int) numThreads maxQueued: (unsigned int) maxQueued {
+    unsigned int i;
+
+    self = [self init];
+    if (!self)
+        return nil;
+
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_cond, NULL);
+
+    _capacity = maxQueued;
+    _jobs = xmalloc(sizeof(id) * _capacity);
+    _head = 0;
+    _count = 0;
+    _shutdown = NO;
+
+    _threads = xmalloc(sizeof(pthread_t) * numThreads);
+    _numThreads = 0;
+    for (i = 0; i < numThreads; i++) {
+        if (pthread_create(&_threads[i], NULL, work_queue_thread, self) != 0) {
+            [TRLog error: "Unable to start worker thread %u of %u.", i + 1, numThreads];
+            break;
+        }
+        _numThreads++;
+    }
+
+    if (_numThreads == 0) {
+        [self release];
+        return nil;
+    }
+
+    return self;
+}
+
+- (void) dealloc {
+    [self shutdown];
+
+    free(_threads);
+    free(_jobs);
+
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_lock);
+
+    [super dealloc];
+}
+
+/**
+ * Enqueue a job for execution. The job is retained until it has run.
+ * @return NO if the queue is full or has been shut down.
+ */
+- (BOOL) addJob: (id<TRWorkQueueJob>) job {
+    pthread_mutex_lock(&_lock);
+    if (_shutdown || _count == _capacity) {
+        pthread_mutex_unlock(&_lock);
+        return NO;
+    }
+
+    _jobs[(_head + _count) % _capacity] = [job retain];
+    _count++;
+
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_lock);
+
+    return YES;
+}
+
+/**
+ * Return the number of jobs waiting to be run.
+ */
+- (unsigned int) pendingCount {
+    unsigned int count;
+
+    pthread_mutex_lock(&_lock);
+    count = _count;
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+/**
+ * Stop accepting jobs, discard any jobs that have not yet started, and
+ * wait for running jobs to complete.
+ */
+- (void) shutdown {
+    unsigned int i;
+
+    pthread_mutex_lock(&_lock);
+    if (_shutdown) {
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+    _shutdown = YES;
+
+    /* Drop pending jobs */
+    while (_count > 0) {
+        [_jobs[_head] release];
+        _jobs[_head] = nil;
+        _head = (_head + 1) % _capacity;
+        _count--;
+    }
+
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_lock);
+
+    for (i = 0; i < _numThreads; i++)
+        pthread_join(_threads[i], NULL);
+}
+
+@end
@@ -34,8 +34,15 @@
 #import <err.h>
 #import <stdio.h>
 #import <stdlib.h>
+#import <string.h>
 #import <stdarg.h>
 #import <errno.h>
+#import <fcntl.h>
+#import <unistd.h>
+#import <time.h>
+#import <stddef.h>
+#import <syslog.h>
+#import <pthread.h>
 
 #import <ldap.h>
 
@@ -45,127 +52,133 @@
 
 #include "openvpn-cr.h"
 
+/* Plugin name, as reported in the OpenVPN log */
+#define PLUGIN_NAME "openvpn-auth-ldap"
+
+/* Minimum supported version of the v3 plugin argument structures */
+#define PLUGIN_MIN_STRUCTVER 1
+
+/* Time, in seconds, to wait before restarting a failed syncrepl session */
+#define SYNC_RETRY_INTERVAL 30
+
 /* Plugin Context */
 typedef struct ldap_ctx {
     TRAuthLDAPConfig *config;
+    TRLDAPConnectionPool *ldapPool;
+    TRLDAPConnectionPool *authPool;
+    TRWorkQueue *workQueue;
+    TRCredentialCache *authCache;
+    TRNegativeCache *negativeCache;
+    TRLDAPGroupSnapshot *groupSnapshot;
+    TRLDAPChangeMonitor *changeMonitor;
+
+    /* Group evaluation statistics */
+    unsigned long groupDecisions;
+    unsigned long groupOperations;
 #ifdef HAVE_PF
     id<TRPacketFilter> pf;
 #endif
 } ldap_ctx;
 
+/* OpenVPN's logging callback, used once the plugin has been opened,
+ * and the OpenVPN thread that opened the plugin */
+static plugin_vlog_t openvpn_vlog = NULL;
+static pthread_t openvpn_thread;
 
-static const char *get_env(const char *key, const char *env[]) {
-    int i;
-
-    if (!env)
-        return (NULL);
-
-    for (i = 0; env[i]; i++) {
-        size_t keylen = strlen(key);
-
-        if (keylen > strlen(env[i]))
-            continue;
-
-        if (!strncmp(key, env[i], keylen)) {
-            const char *p = env[i] + keylen;
-            if (*p == '=')
-                return (p + 1);
-        }
-    }
-
-    return (NULL);
-}
-
-static TRString *quoteForSearch(const char *string) {
-    const char specialChars[] = "*()\\"; /* RFC 2254. We don't care about NULL */
-    TRString *result = [[TRString alloc] init];
-    TRString *unquotedString, *part;
-    TRAutoreleasePool *pool = [[TRAutoreleasePool alloc] init];
-
-    /* Make a copy of the string */
-    unquotedString = [[TRString alloc] initWithCString: string];
-
-    /* Initialize the result */
-    result = [[TRString alloc] init];
-
-    /* Quote all occurrences of the special characters */
-    while ((part = [unquotedString substringToCharset: specialChars]) != NULL) {
-        TRString *temp;
-        size_t index;
-        char c;
-
-        /* Append everything until the first special character */
-        [result appendString: part];
-
-        /* Append the backquote */
-        [result appendCString: "\\"];
-
-        /* Get the special character */
-        index = [unquotedString indexToCharset: specialChars];
-        temp = [unquotedString substringFromIndex: index];
-        c = [temp charAtIndex: 0];
-
-        /* Append it, too! */
-        [result appendChar: c];
-
-        /* Move unquotedString past the special character */
-        temp = [[unquotedString substringFromCharset: specialChars] retain];
-
-        [unquotedString release];
-        unquotedString = temp;
+/**
+ * Forward a log message to the OpenVPN server log. OpenVPN's logging is
+ * not thread-safe, so messages from the plugin's worker and background
+ * threads are sent to syslog instead.
+ */
+static void openvpn_log_handler(loglevel_t level, const char *message, va_list args) {
+    openvpn_plugin_log_flags_t flags = PLOG_ERR;
+    int priority = LOG_ERR;
+    char buffer[1024];
+
+    switch (level) {
+        case TRLOG_ERR:
+            flags = PLOG_ERR;
+            priority = LOG_ERR;
+            break;
+        case TRLOG_WARNING:
+            flags = PLOG_WARN;
+            priority = LOG_WARNING;
+            break;
+        case TRLOG_INFO:
+            flags = PLOG_NOTE;
+            priority = LOG_INFO;
+            break;
+        case TRLOG_DEBUG:
+            flags = PLOG_DEBUG;
+            priority = LOG_DEBUG;
+            break;
     }
 
-    /* Append the remainder, if any */
-    if (unquotedString) {
-        [result appendString: unquotedString];
-        [unquotedString release];
+    if (pthread_equal(pthread_self(), openvpn_thread)) {
+        openvpn_vlog(flags, PLUGIN_NAME, message, args);
+        return;
     }
 
-    [pool release];
-
-    return (result);
+    vsnprintf(buffer, sizeof(buffer), message, args);
+    syslog(priority, "%s: %s", PLUGIN_NAME, buffer);
 }
 
-static TRString *createSearchFilter(TRString *template, const char *username) {
-    TRString *templateString;
-    TRString *result, *part;
-    TRString *quotedName;
-    const char userFormat[] = "%u";
-    TRAutoreleasePool *pool = [[TRAutoreleasePool alloc] init];
+/* The OpenVPN environment variables used to handle a single plugin call */
+typedef struct plugin_env {
+    const char *username;
+    const char *password;
+    const char *remoteAddress;
+    const char *authControlFile;
+} plugin_env;
 
-    /* Copy the template */
-    templateString = [[[TRString alloc] initWithString: template] autorelease];
-
-    /* Initialize the result */
-    result = [[TRString alloc] init];
-
-    /* Quote the username */
-    quotedName = quoteForSearch(username);
-
-    while ((part = [templateString substringToCString: userFormat]) != NULL) {
-        TRString *temp;
-
-        /* Append everything until the first %u */
-        [result appendString: part];
+/*
+ * Perfect hash of the variable names used by the plugin, computed from the
+ * name's length and its first and last characters. The table below must be
+ * updated if a variable is added.
+ */
+#define ENV_HASH_SIZE 8
+#define ENV_HASH(name, length) (((length) + (unsigned char) (name)[0] + (unsigned char) (name)[(length) - 1]) & (ENV_HASH_SIZE - 1))
+
+static const struct {
+    const char *name;
+    size_t length;
+    size_t offset;
+} env_variables[ENV_HASH_SIZE] = {
+    [0] = { "ifconfig_pool_remote_ip",  23, offsetof(plugin_env, remoteAddress) },
+    [2] = { "username",                 8,  offsetof(plugin_env, username) },
+    [4] = { "password",                 8,  offsetof(plugin_env, password) },
+    [7] = { "auth_control_file",        17, offsetof(plugin_env, authControlFile) },
+};
+
+/**
+ * Walk the OpenVPN environment once, recording the variables used by the
+ * plugin. As with getenv(), the first definition of a variable is used.
+ */
+static void parse_env(const char *envp[], plugin_env *env) {
+    const char **field;
+    const char *name, *value;
+    unsigned int hash;
+    size_t length;
+    int i;
 
-        /* Append the username */
-        [result appendString: quotedName];
+    memset(env, 0, sizeof(*env));
+    if (!envp)
+        return;
 
-        /* Move templateString past the %u */
-        temp = [templateString substringFromCString: userFormat];
-        templateString = temp;
-    }
+    for (i = 0; envp[i]; i++) {
+        name = envp[i];
+        if ((value = strchr(name, '=')) == NULL || value == name)
+            continue;
 
-    [quotedName release];
+        length = value - name;
+        hash = ENV_HASH(name, length);
+        if (env_variables[hash].length != length || memcmp(env_variables[hash].name, name, length) != 0)
+            continue;
 
-    /* Append the remainder, if any */
-    if (templateString) {
-        [result appendString: templateString];
+        field = (const char **) ((char *) env + env_variables[hash].offset);
+        if (*field == NULL)
+            *field = value + 1;
     }
-
-    [pool release];
-
-    return (result);
 }
 
 #ifdef HAVE_PF
@@ -213,15 +226,107 @@ static BOOL pf_open(struct ldap_ctx *ctx) {
 }
 #endif /* HAVE_PF */
 
-OPENVPN_EXPORT openvpn_plugin_handle_t
-openvpn_plugin_open_v1(unsigned int *type, const char *argv[], const char *envp[]) {
-    ldap_ctx *ctx = xmalloc(sizeof(ldap_ctx));
+/**
+ * Discards cached state as the directory changes, as reported by
+ * the plugin's TRLDAPChangeMonitor.
+ */
+@interface TRCacheInvalidator : TRObject <TRLDAPSyncDelegate> {
+@private
+    ldap_ctx *_ctx;
+}
+
+- (id) initWithContext: (ldap_ctx *) ctx;
+
+@end
+
+@implementation TRCacheInvalidator
+
+- (id) initWithContext: (ldap_ctx *) ctx {
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _ctx = ctx;
+
+    return self;
+}
+
+// from TRLDAPSyncDelegate protocol
+- (void) ldapSyncEntryChanged: (TRString *) dn {
+    TREnumerator *groupIter;
+    TRLDAPGroupConfig *groupConfig;
+
+    [TRLog debug: "LDAP entry \"%s\" changed.", [dn cString]];
+
+    /* The user's password or group may have changed */
+    if (_ctx->authCache)
+        [_ctx->authCache removeCredentialsForDN: dn];
+
+    /* A previously unknown user may now exist */
+    if (_ctx->negativeCache && [TRLDAPChangeMonitor isDN: dn withinBaseDN: [_ctx->config baseDN]])
+        [_ctx->negativeCache removeUnknownUsers];
+
+    /* A group's membership may have changed */
+    groupIter = [[_ctx->config ldapGroups] objectEnumerator];
+    while ((groupConfig = [groupIter nextObject]) != nil) {
+        if ([TRLDAPChangeMonitor isDN: dn withinBaseDN: [groupConfig baseDN]]) {
+            if (_ctx->authCache)
+                [_ctx->authCache removeAllCredentials];
+            if (_ctx->groupSnapshot)
+                [_ctx->groupSnapshot refreshSoon];
+            break;
+        }
+    }
+}
+
+// from TRLDAPSyncDelegate protocol
+- (void) ldapSyncLostTrack {
+    [TRLog debug: "Discarding cached LDAP state."];
+
+    if (_ctx->authCache)
+        [_ctx->authCache removeAllCredentials];
+    if (_ctx->negativeCache)
+        [_ctx->negativeCache removeUnknownUsers];
+    if (_ctx->groupSnapshot)
+        [_ctx->groupSnapshot refreshSoon];
+}
+
+@end
+
+OPENVPN_EXPORT int
+openvpn_plugin_min_version_required_v1(void) {
+    /* The v3 entry points are only used by plugin API version 3 and later */
+    return 3;
+}
+
+OPENVPN_EXPORT int
+openvpn_plugin_open_v3(const int version, struct openvpn_plugin_args_open_in const *args, struct openvpn_plugin_args_open_return *ret) {
+    ldap_ctx *ctx;
+
+    if (version < PLUGIN_MIN_STRUCTVER) {
+        [TRLog error: "Unsupported OpenVPN plugin API structure version %d.", version];
+        return OPENVPN_PLUGIN_FUNC_ERROR;
+    }
+
+    /* Log through the OpenVPN server, if it supplied a logging callback */
+    if (args->callbacks && args->callbacks->plugin_vlog) {
+        openvpn_vlog = args->callbacks->plugin_vlog;
+        openvpn_thread = pthread_self();
+        [TRLog setHandler: openvpn_log_handler];
+    }
+
+    if (!args->argv[1]) {
+        [TRLog error: "No configuration file supplied to OpenVPN LDAP Plugin."];
+        return OPENVPN_PLUGIN_FUNC_ERROR;
+    }
+
+    ctx = xmalloc(sizeof(ldap_ctx));
 
-/* Read the configuration */
-    ctx->config = [[TRAuthLDAPConfig alloc] initWithConfigFile: argv[1]];
+    /* Read the configuration */
+    ctx->config = [[TRAuthLDAPConfig alloc] initWithConfigFile: args->argv[1]];
     if (!ctx->config) {
         free(ctx);
-        return (NULL);
+        return OPENVPN_PLUGIN_FUNC_ERROR;
     }
 
 #ifdef HAVE_PF
@@ -230,16 +335,140 @@ openvpn_plugin_open_v1(unsigned int *type, const char *argv[], const char *envp[
     if ([ctx->config pfEnabled] && !pf_open(ctx)) {
         [ctx->config release];
         free(ctx);
-        return (NULL);
+        return OPENVPN_PLUGIN_FUNC_ERROR;
     }
 #endif
 
+    /* Persistent LDAP connections, shared across requests */
+    ctx->ldapPool = [[TRLDAPConnectionPool alloc] initWithConfig: ctx->config maxIdleConnections: [ctx->config poolSize]];
+
+    /* Unbound connections, re-bound as each user to verify their password */
+    ctx->authPool = [[TRLDAPConnectionPool alloc] initWithConfig: ctx->config maxIdleConnections: [ctx->config poolSize] serviceBind: NO];
+
+    /* Load the TLS certificates and keys shared by both pools once, up front.
+     * Reopening the plugin (eg, on SIGHUP) reloads them. */
+    if (![ctx->ldapPool applyGlobalOptions])
+        [TRLog warning: "Unable to apply LDAP TLS settings; will retry when connecting."];
+
+    /* Cache of recently verified credentials, if enabled */
+    ctx->authCache = nil;
+    if ([ctx->config cacheEnabled]) {
+        if ([ctx->config passWordIsCR]) {
+            /* Challenge/response passwords must not be replayable */
+            [TRLog warning: "The credential cache is not supported with PasswordIsCR, and has been disabled."];
+        } else {
+            ctx->authCache = [[TRCredentialCache alloc] initWithCapacity: [ctx->config cacheMaxEntries]
+                ttl: [ctx->config cacheTTL]
+                iterations: [ctx->config cacheHashIterations]];
+        }
+    }
+
+    /* Cache of unknown users and failed binds, if enabled */
+    ctx->negativeCache = nil;
+    if ([ctx->config cacheEnabled]) {
+        ctx->negativeCache = [[TRNegativeCache alloc] initWithCapacity: [ctx->config negativeCacheMaxEntries]
+            ttl: [ctx->config negativeCacheTTL]
+            maxFailures: [ctx->config maxFailedBinds]];
+    }
+
+    /* Periodically refreshed group membership, if enabled */
+    ctx->groupSnapshot = nil;
+    if ([ctx->config groupSnapshotRefresh] > 0 && [ctx->config ldapGroups]) {
+        ctx->groupSnapshot = [[TRLDAPGroupSnapshot alloc] initWithConnectionPool: ctx->ldapPool
+            groups: [ctx->config ldapGroups]
+            refreshInterval: [ctx->config groupSnapshotRefresh]];
+        if (![ctx->groupSnapshot start]) {
+            [TRLog warning: "Group membership will be checked at each login."];
+            [ctx->groupSnapshot release];
+            ctx->groupSnapshot = nil;
+        }
+    }
+
+    /* Invalidate cached state as the directory changes, if enabled */
+    ctx->changeMonitor = nil;
+    if ([ctx->config syncRepl]) {
+        if (!ctx->authCache && !ctx->negativeCache && !ctx->groupSnapshot) {
+            [TRLog warning: "SyncRepl has no effect without a <Cache> section or GroupSnapshotRefresh, and has been disabled."];
+        } else {
+            TRCacheInvalidator *invalidator;
+            TRArray *baseDNs;
+            TREnumerator *groupIter;
+            TRLDAPGroupConfig *groupConfig;
+
+            /* Follow the users, and each group */
+            baseDNs = [[TRArray alloc] init];
+            [baseDNs addObject: [ctx->config baseDN]];
+            groupIter = [[ctx->config ldapGroups] objectReverseEnumerator];
+            while ((groupConfig = [groupIter nextObject]) != nil)
+                [baseDNs addObject: [groupConfig baseDN]];
+
+            invalidator = [[TRCacheInvalidator alloc] initWithContext: ctx];
+            ctx->changeMonitor = [[TRLDAPChangeMonitor alloc] initWithConnectionPool: ctx->ldapPool
+                baseDNs: baseDNs
+                delegate: invalidator
+                retryInterval: SYNC_RETRY_INTERVAL];
+            [invalidator release];
+            [baseDNs release];
+
+            if (![ctx->changeMonitor start]) {
+                [TRLog warning: "Cached state will expire, but will not follow directory changes."];
+                [ctx->changeMonitor release];
+                ctx->changeMonitor = nil;
+            }
+        }
+    }
 
-    *type = OPENVPN_PLUGIN_MASK(OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY) |
+    ctx->groupDecisions = 0;
+    ctx->groupOperations = 0;
+
+    /* Worker threads for deferred authentication, if enabled */
+    ctx->workQueue = nil;
+    if ([ctx->config deferredAuth]) {
+        ctx->workQueue = [[TRWorkQueue alloc] initWithThreads: [ctx->config workerThreads] maxQueued: [ctx->config queueDepth]];
+        if (!ctx->workQueue) {
+            [TRLog error: "Unable to start deferred authentication worker threads."];
+            /* Stop the background threads before releasing the state they use */
+            if (ctx->changeMonitor)
+                [ctx->changeMonitor release];
+            if (ctx->groupSnapshot)
+                [ctx->groupSnapshot release];
+            if (ctx->authCache)
+                [ctx->authCache release];
+            if (ctx->negativeCache)
+                [ctx->negativeCache release];
+            [ctx->ldapPool release];
+            [ctx->authPool release];
+            [ctx->config release];
+#ifdef HAVE_PF
+            if (ctx->pf)
+                [ctx->pf release];
+#endif
+            free(ctx);
+            return OPENVPN_PLUGIN_FUNC_ERROR;
+        }
+    }
+
+    ret->type_mask = OPENVPN_PLUGIN_MASK(OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY) |
         OPENVPN_PLUGIN_MASK(OPENVPN_PLUGIN_CLIENT_CONNECT) |
         OPENVPN_PLUGIN_MASK(OPENVPN_PLUGIN_CLIENT_DISCONNECT);
+    ret->handle = (openvpn_plugin_handle_t *) ctx;
 
-    return (ctx);
+    return OPENVPN_PLUGIN_FUNC_SUCCESS;
+}
+
+/** Log TLS session resumption statistics for each of the pool's servers. */
+static void log_tls_statistics(TRLDAPConnectionPool *pool, const char *poolName) {
+    unsigned int i;
+
+    for (i = 0; i < [pool serverCount]; i++) {
+        TRLDAPServer *server = [pool serverAtIndex: i];
+
+        if ([server tlsHandshakes] == 0)
+            continue;
+
+        [TRLog info: "%s connections to %s: %lu TLS handshakes, %lu resumed, %lu full.", poolName, [[server url] cString],
+            [server tlsHandshakes], [server tlsResumptions], [server tlsHandshakes] - [server tlsResumptions]];
+    }
 }
 
 OPENVPN_EXPORT void
@@ -247,6 +476,34 @@ OPENVPN_EXPORT void
 {
     ldap_ctx *ctx = handle;
 
+    /* Wait for any in-progress deferred authentication to finish */
+    if (ctx->workQueue)
+        [ctx->workQueue release];
+
+    /* Stop following directory changes */
+    if (ctx->changeMonitor)
+        [ctx->changeMonitor release];
+
+    /* Stop refreshing group membership */
+    if (ctx->groupSnapshot)
+        [ctx->groupSnapshot release];
+
+    if (ctx->groupDecisions > 0)
+        [TRLog info: "%lu group membership decisions, averaging %.1f LDAP operations each.", ctx->groupDecisions, (double) ctx->groupOperations / ctx->groupDecisions];
+
+    log_tls_statistics(ctx->ldapPool, "Search");
+    log_tls_statistics(ctx->authPool, "Authentication");
+
+    /* Close any pooled LDAP connections */
+    [ctx->ldapPool release];
+    [ctx->authPool release];
+
+    /* Discard cached credentials */
+    if (ctx->authCache)
+        [ctx->authCache release];
+    if (ctx->negativeCache)
+        [ctx->negativeCache release];
+
     /* Clean up the configuration file */
     [ctx->config release];
 
@@ -258,174 +515,128 @@ OPENVPN_EXPORT void
 
     /* Finished */
     free(ctx);
-}
-
-TRLDAPConnection *connect_ldap(TRAuthLDAPConfig *config) {
-    TRLDAPConnection *ldap;
-    TRString *value;
-
-    /* Initialize our LDAP Connection */
-    ldap = [[TRLDAPConnection alloc] initWithURL: [config url] timeout: [config timeout]];
-    if (!ldap) {
-        [TRLog error: "Unable to open LDAP connection to %s\n", [[config url] cString]];
-        return nil;
-    }
-
-    /* Referrals */
-    if ([config referralEnabled]) {
-        if (![ldap setReferralEnabled: YES])
-            goto error;
-    } else {
-        if (![ldap setReferralEnabled: NO])
-            goto error;
-    }
 
-    /* Certificate file */
-    if ((value = [config tlsCACertFile])) 
-        if (![ldap setTLSCACertFile: value])
-            goto error;
-
-    /* Certificate directory */
-    if ((value = [config tlsCACertDir])) 
-        if (![ldap setTLSCACertDir: value])
-            goto error;
-
-    /* Client Certificate Pair */
-    if ([config tlsCertFile] && [config tlsKeyFile])
-        if(![ldap setTLSClientCert: [config tlsCertFile] keyFile: [config tlsKeyFile]])
-            goto error;
-
-    /* Cipher suite */
-    if ((value = [config tlsCipherSuite]))
-        if(![ldap setTLSCipherSuite: value])
-            goto error;
-
-    /* Start TLS */
-    if ([config tlsEnabled])
-        if (![ldap startTLS])
-            goto error;
-
-    /* Bind if requested */
-    if ([config bindDN]) {
-        if (![ldap bindWithDN: [config bindDN] password: [config bindPassword]]) {
-            [TRLog error: "Unable to bind as %s", [[config bindDN] cString]];
-            goto error;
-        }
-    }
-
-    return ldap;
-
-    error:
-    [ldap release];
-    return nil;
+    /* OpenVPN's logging callback is not valid once the plugin is closed */
+    [TRLog setHandler: NULL];
+    openvpn_vlog = NULL;
 }
 
-static TRLDAPEntry *find_ldap_user (TRLDAPConnection *ldap, TRAuthLDAPConfig *config, const char *username) {
-    TRString		*searchFilter;
-    TRArray			*ldapEntries;
-    TRLDAPEntry		*result = nil;
-
-    /* Assemble our search filter */
-    searchFilter = createSearchFilter([config searchFilter], username);
-
-    /* Search! */
-    ldapEntries = [ldap searchWithFilter: searchFilter
-        scope: LDAP_SCOPE_SUBTREE
-        baseDN: [config baseDN]
-        attributes: NULL];
-    [searchFilter release];
-    if (!ldapEntries)
-        return nil;
-    if ([ldapEntries count] < 1) {
-        return nil;
-    }
+OPENVPN_EXPORT void *
+openvpn_plugin_client_constructor_v1(openvpn_plugin_handle_t handle) {
+    /* Per-client state, handed back to us with each client event */
+    return [[TRVPNSession alloc] init];
+}
 
-    /* The specified search string may (but should not) return more than one entry.
-     * We ignore any extras. */
-    result = [[ldapEntries lastObject] retain];
+OPENVPN_EXPORT void
+openvpn_plugin_client_destructor_v1(openvpn_plugin_handle_t handle, void *per_client_context) {
+    TRVPNSession *session = per_client_context;
 
-    return result;
+    [session release];
 }
 
-
-static BOOL auth_ldap_user(TRLDAPConnection *ldap, TRAuthLDAPConfig *config, TRLDAPEntry *ldapUser, const char *password) {
-    TRLDAPConnection *authConn;
+static BOOL auth_ldap_user(ldap_ctx *ctx, TRLDAPEntry *ldapUser, const char *password) {
+    TRLDAPConnection *authConn = nil;
     TRString *passwordString;
     BOOL result = NO;
-
-    /* Create a second connection for binding */
-    authConn = connect_ldap(config);
-    if (!authConn) {
-        return NO;
-    }
+    BOOL valid = NO;
+    int attempt;
 
     /* Allocate the string to pass to bindWithDN */
     passwordString = [[TRString alloc] initWithCString: password];
 
-    if ([authConn bindWithDN: [ldapUser dn] password: passwordString]) {
-        result = YES;
+    /*
+     * Verify the password by re-binding a pooled connection as the user.
+     * If a reused connection turns out to have been dropped by the server,
+     * retry once on a fresh connection.
+     */
+    for (attempt = 0; attempt < 2; attempt++) {
+        authConn = [ctx->authPool checkout];
+        if (!authConn)
+            break;
+
+        if ([authConn bindWithDN: [ldapUser dn] password: passwordString])
+            result = YES;
+
+        /* Check the connection before returning it; once checked in, it
+         * may be leased to another thread */
+        valid = [authConn isValid];
+
+        /* Return the connection; it is discarded if no longer usable */
+        [ctx->authPool checkin: authConn];
+
+        if (result || valid)
+            break;
     }
 
+    /* The server rejected the bind over a working connection; count it
+     * against the user */
+    if (!result && ctx->negativeCache && valid)
+        [ctx->negativeCache addFailureForUser: [ldapUser rdn]];
+
     [passwordString release];
-    [authConn release];
 
     return result;
 }
 
-static TRLDAPGroupConfig *find_ldap_group(TRLDAPConnection *ldap, TRAuthLDAPConfig *config, TRLDAPEntry *ldapUser) {
-    TREnumerator *groupIter;
+/**
+ * Find the user's first matching group, logging the number of LDAP
+ * operations the decision cost and adding it to the plugin's statistics.
+ */
+static TRLDAPGroupConfig *find_ldap_group(ldap_ctx *ctx, TRLDAPConnection *ldap, TRLDAPEntry *ldapUser) {
+    TRLDAPGroupEvaluator *evaluator;
     TRLDAPGroupConfig *groupConfig;
-    TRArray *ldapEntries;
-    TREnumerator *entryIter;
-    TRLDAPEntry *entry;
-    TRLDAPGroupConfig *result = nil;
-    int userNameLength;
+    unsigned long operations;
 
-    /*
-     * Groups are loaded into the array in the order that they are listed
-     * in the configuration file, and we are expected to perform
-     * "first match". Thusly, we'll walk the stack from the bottom up.
-     */
-    groupIter = [[config ldapGroups] objectReverseEnumerator];
+    /* Use the group membership snapshot, if one is loaded */
+    if (ctx->groupSnapshot && [ctx->groupSnapshot findGroupForUser: ldapUser group: &groupConfig]) {
+        __sync_add_and_fetch(&ctx->groupDecisions, 1);
+        [TRLog debug: "Group membership of \"%s\" decided from the group membership snapshot.", [[ldapUser dn] cString]];
+        return groupConfig;
+    }
 
-    while ((groupConfig = [groupIter nextObject]) != nil) {
+    operations = [ldap operationCount];
 
-        /* Search for the group */
-        ldapEntries = [ldap searchWithFilter: [groupConfig searchFilter]
-            scope: LDAP_SCOPE_SUBTREE
-            baseDN: [groupConfig baseDN]
-            attributes: NULL];
+    evaluator = [[TRLDAPGroupEvaluator alloc] initWithConnection: ldap];
+    if ([ctx->config combinedGroupSearch])
+        groupConfig = [evaluator firstMatchingGroupWithCombinedSearch: [ctx->config ldapGroups] forUser: ldapUser];
+    else
+        groupConfig = [evaluator firstMatchingGroup: [ctx->config ldapGroups] forUser: ldapUser];
+    [evaluator release];
 
-        /* Error occured, all stop */
-        if (!ldapEntries)
-            break;
+    operations = [ldap operationCount] - operations;
+    __sync_add_and_fetch(&ctx->groupDecisions, 1);
+    __sync_add_and_fetch(&ctx->groupOperations, operations);
 
-        /* If RFC2307BIS flag is true, search for full DN, otherwise just search for uid */
-        TRString *searchValue = [groupConfig memberRFC2307BIS] ? [ldapUser dn] : [ldapUser rdn];
+    [TRLog debug: "Group membership of \"%s\" decided with %lu LDAP operations.", [[ldapUser dn] cString], operations];
 
-        /* This will be used if we're using the "search" operation instead of the "compare" operation */
-        TRString *searchFilter = [TRString stringWithFormat: "(%s=%s)", [[groupConfig memberAttribute] cString], [searchValue cString]];
+    return groupConfig;
+}
 
-        /* Iterate over the returned entries */
-        entryIter = [ldapEntries objectEnumerator];
-        while ((entry = [entryIter nextObject]) != nil) {
-            if ((![groupConfig useCompareOperation] && [ldap searchWithFilter: searchFilter scope: LDAP_SCOPE_SUBTREE baseDN: [entry dn] attributes: NULL]) ||
-                ([groupConfig useCompareOperation] && [ldap compareDN: [entry dn] withAttribute: [groupConfig memberAttribute] value: searchValue])) {
-                /* Group match! */
-                result = groupConfig;
-            }
-        }
+/**
+ * Record the authenticated user's DN, group and packet filter table with the
+ * client's session, for use by later connect and disconnect events.
+ */
+static void record_session(ldap_ctx *ctx, TRVPNSession *session, TRString *username, TRString *dn, TRLDAPGroupConfig *groupConfig) {
+    [session setUsername: username];
+    [session setDN: dn];
+    [session setGroupConfig: groupConfig];
 
-        if (result)
-            break;
+    /* Grab the requested PF table name, if any */
+    if (groupConfig) {
+        [session setPFTable: [groupConfig pfTable]];
+    } else {
+        [session setPFTable: [ctx->config pfTable]];
     }
 
-    return result;
+    [session setAuthenticated: YES];
 }
 
 /** Handle user authentication. */
-static int handle_auth_user_pass_verify(ldap_ctx *ctx, TRLDAPConnection *ldap, TRLDAPEntry *ldapUser, const char *password) {
-    TRLDAPGroupConfig *groupConfig;
+static int handle_auth_user_pass_verify(ldap_ctx *ctx, TRVPNSession *session, TRLDAPConnection *ldap, TRLDAPEntry *ldapUser, const char *password) {
+    TRLDAPGroupConfig *groupConfig = nil;
+
+    /* Forget any previous authentication (eg, on renegotiation) */
+    [session setAuthenticated: NO];
 
 	const char *auth_password = password;
 	if ([ctx->config passWordIsCR]) {
@@ -439,28 +650,223 @@ static int handle_auth_user_pass_verify(ldap_ctx *ctx, TRLDAPConnection *ldap, T
 	}
 
     /* Authenticate the user */
-    if (!auth_ldap_user(ldap, ctx->config, ldapUser, auth_password)) {
+    if (!auth_ldap_user(ctx, ldapUser, auth_password)) {
         [TRLog error: "Incorrect password supplied for LDAP DN \"%s\".", [[ldapUser dn] cString]];
         return (OPENVPN_PLUGIN_FUNC_ERROR);
     }
 
     /* User authenticated, find group, if any */
     if ([ctx->config ldapGroups]) {
-        groupConfig = find_ldap_group(ldap, ctx->config, ldapUser);
+        groupConfig = find_ldap_group(ctx, ldap, ldapUser);
         if (!groupConfig && [ctx->config requireGroup]) {
             /* No group match, and group membership is required */
+            [TRLog error: "No matching LDAP group found for user DN \"%s\", and group membership is required.", [[ldapUser dn] cString]];
             return OPENVPN_PLUGIN_FUNC_ERROR;
-        } else {
-            /* Group match! */
+        }
+    }
+
+    /* User OK, remember who they are for connect and disconnect */
+    record_session(ctx, session, [ldapUser rdn], [ldapUser dn], groupConfig);
+    return OPENVPN_PLUGIN_FUNC_SUCCESS;
+}
+
+/** Look up the user's LDAP entry. Returns a retained entry, or nil. */
+static TRLDAPEntry *lookup_user(ldap_ctx *ctx, TRLDAPConnection *ldap, const char *username) {
+    TRLDAPEntry *ldapUser;
+    TRString *userName;
+    BOOL notFound;
+
+    userName = [[TRString alloc] initWithCString: username];
+
+    /* Find the user's entry. The pool may hedge a slow search against another server. */
+    ldapUser = [ctx->ldapPool findUser: username withConnection: ldap notFound: &notFound];
+    if (!ldapUser) {
+        if (notFound) {
+            /* No such user. Remember that, rather than searching again. */
+            [TRLog warning: "LDAP user \"%s\" was not found.", username];
+            if (ctx->negativeCache)
+                [ctx->negativeCache addUnknownUser: userName];
+        }
+        [userName release];
+        return nil;
+    }
+
+    [ldapUser setRDN: userName];
+    [userName release];
+
+    return [ldapUser retain];
+}
+
+/** Look up the user and verify their password, recording the result with the session. */
+static int verify_user_pass(ldap_ctx *ctx, TRVPNSession *session, const char *username, const char *password) {
+    TRLDAPConnection *ldap;
+    TRLDAPEntry *ldapUser;
+    TRString *userName = nil;
+    TRCachedCredential *credential;
+    int ret = OPENVPN_PLUGIN_FUNC_ERROR;
+
+    userName = [[[TRString alloc] initWithCString: username] autorelease];
+
+    /* Reject unknown users */
+    if (ctx->negativeCache && [ctx->negativeCache isUnknownUser: userName]) {
+        [TRLog debug: "Rejected unknown LDAP user \"%s\" from the negative cache.", username];
+        return OPENVPN_PLUGIN_FUNC_ERROR;
+    }
+
+    /* Check for a recently verified credential. This precedes the failed
+     * bind limit, so that failed guesses can not lock out a user whose
+     * password is already known to be correct. */
+    if (ctx->authCache) {
+        credential = [ctx->authCache credentialForUser: userName password: password];
+        if (credential) {
+            [TRLog debug: "Authenticated LDAP user \"%s\" from the credential cache.", username];
+            record_session(ctx, session, userName, [credential dn], [credential groupConfig]);
+            if (ctx->negativeCache)
+                [ctx->negativeCache removeUser: userName];
             return OPENVPN_PLUGIN_FUNC_SUCCESS;
         }
-    } else {
-        // No groups, user OK
-        return OPENVPN_PLUGIN_FUNC_SUCCESS;
     }
 
-    /* Never reached */
-    return OPENVPN_PLUGIN_FUNC_ERROR;
+    /* Reject users with repeated failed binds */
+    if (ctx->negativeCache && [ctx->negativeCache isLockedOut: userName]) {
+        [TRLog debug: "Rejected LDAP user \"%s\" after repeated failed binds.", username];
+        return OPENVPN_PLUGIN_FUNC_ERROR;
+    }
+
+    /* Acquire an LDAP connection */
+    if (!(ldap = [ctx->ldapPool checkout])) {
+        [TRLog error: "LDAP connect failed."];
+        return OPENVPN_PLUGIN_FUNC_ERROR;
+    }
+
+    /* Find the user record */
+    ldapUser = lookup_user(ctx, ldap, username);
+    if (ldapUser) {
+        ret = handle_auth_user_pass_verify(ctx, session, ldap, ldapUser, password);
+        [ldapUser release];
+    }
+
+    /* Return the connection to the pool for reuse */
+    [ctx->ldapPool checkin: ldap];
+
+    /* A successful login clears any failed binds */
+    if (ctx->negativeCache && ret == OPENVPN_PLUGIN_FUNC_SUCCESS)
+        [ctx->negativeCache removeUser: userName];
+
+    /* Remember a verified password, and forget a stale one */
+    if (ctx->authCache) {
+        if (ret == OPENVPN_PLUGIN_FUNC_SUCCESS) {
+            [ctx->authCache setCredentialForUser: userName dn: [session dn] groupConfig: [session groupConfig] password: password];
+        } else {
+            [ctx->authCache removeCredentialForUser: userName];
+        }
+    }
+
+    return ret;
+}
+
+/** Report a deferred authentication result to OpenVPN. */
+static void write_auth_control_file(const char *path, BOOL success) {
+    int fd;
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) == -1) {
+        [TRLog error: "Unable to open auth_control_file \"%s\": %s", path, strerror(errno)];
+        return;
+    }
+
+    if (write(fd, success ? "1" : "0", 1) != 1)
+        [TRLog error: "Unable to write auth_control_file \"%s\": %s", path, strerror(errno)];
+
+    close(fd);
+}
+
+/**
+ * A deferred password authentication request. Runs on a worker thread, and
+ * reports its result through the auth_control_file supplied by OpenVPN.
+ */
+@interface TRDeferredAuthJob : TRObject <TRWorkQueueJob> {
+@private
+    ldap_ctx *_ctx;
+    TRVPNSession *_session;
+    TRString *_username;
+    TRString *_password;
+    TRString *_authControlFile;
+    time_t _queued;
+}
+
+- (id) initWithContext: (ldap_ctx *) ctx session: (TRVPNSession *) session username: (const char *) username password: (const char *) password authControlFile: (const char *) authControlFile;
+
+@end
+
+@implementation TRDeferredAuthJob
+
+/**
+ * Initialize a new request. The environment strings are copied, as they
+ * are only valid for the duration of the plugin call.
+ */
+- (id) initWithContext: (ldap_ctx *) ctx session: (TRVPNSession *) session username: (const char *) username password: (const char *) password authControlFile: (const char *) authControlFile {
+    self = [self init];
+    if (!self)
+        return nil;
+
+    _ctx = ctx;
+    _session = [session retain];
+    _username = [[TRString alloc] initWithCString: username];
+    _password = [[TRString alloc] initWithCString: password];
+    _authControlFile = [[TRString alloc] initWithCString: authControlFile];
+    _queued = time(NULL);
+
+    return self;
+}
+
+- (void) dealloc {
+    /* Don't leave the password lying around in freed memory */
+    memset((char *) [_password cString], 0, [_password length]);
+
+    [_session release];
+    [_username release];
+    [_password release];
+    [_authControlFile release];
+    [super dealloc];
+}
+
+// from TRWorkQueueJob protocol
+- (void) run {
+    int ret;
+
+    /* Don't spend directory time on a request OpenVPN has likely given up on */
+    if ([_ctx->config failFast] && time(NULL) - _queued > [_ctx->config timeout]) {
+        [TRLog error: "Deferred authentication request for LDAP user \"%s\" expired in the queue.", [_username cString]];
+        write_auth_control_file([_authControlFile cString], NO);
+        return;
+    }
+
+    ret = verify_user_pass(_ctx, _session, [_username cString], [_password cString]);
+    write_auth_control_file([_authControlFile cString], ret == OPENVPN_PLUGIN_FUNC_SUCCESS);
+}
+
+@end
+
+/** Queue a password authentication request for a worker thread. */
+static int defer_auth_user_pass_verify(ldap_ctx *ctx, TRVPNSession *session, const char *username, const char *password, const char *authControlFile) {
+    TRDeferredAuthJob *job;
+    BOOL queued;
+
+    /* With every server failing, answer immediately; only the caches
+     * can accept the user */
+    if ([ctx->config failFast] && ![ctx->ldapPool hasAvailableServer])
+        return verify_user_pass(ctx, session, username, password);
+
+    job = [[TRDeferredAuthJob alloc] initWithContext: ctx session: session username: username password: password authControlFile: authControlFile];
+    queued = [ctx->workQueue addJob: job];
+    [job release];
+
+    if (!queued) {
+        [TRLog error: "Deferred authentication queue is full, rejecting LDAP user \"%s\".", username];
+        return OPENVPN_PLUGIN_FUNC_ERROR;
+    }
+
+    return OPENVPN_PLUGIN_FUNC_DEFERRED;
 }
 
 #ifdef HAVE_PF
@@ -497,34 +903,41 @@ static BOOL pf_client_connect_disconnect(struct ldap_ctx *ctx, TRString *tableNa
 #endif /* HAVE_PF */
 
 
-/** Handle both connection and disconnection events. */
-static int handle_client_connect_disconnect(ldap_ctx *ctx, TRLDAPConnection *ldap, TRLDAPEntry *ldapUser, const char *remoteAddress, BOOL connecting) {
-    TRLDAPGroupConfig *groupConfig = nil;
+/**
+ * Handle both connection and disconnection events. The user's DN and group
+ * were resolved at authentication time, so no LDAP requests are required.
+ */
+static int handle_client_connect_disconnect(ldap_ctx *ctx, TRVPNSession *session, const char *remoteAddress, BOOL connecting) {
 #ifdef HAVE_PF
     TRString *tableName = nil;
 #endif
 
-    /* Locate the group (config), if any */
-    if ([ctx->config ldapGroups]) {
-        groupConfig = find_ldap_group(ldap, ctx->config, ldapUser);
-        if (!groupConfig && [ctx->config requireGroup]) {
-            [TRLog error: "No matching LDAP group found for user DN \"%s\", and group membership is required.", [[ldapUser dn] cString]];
-            /* No group match, and group membership is required */
-            return OPENVPN_PLUGIN_FUNC_ERROR;
+    if (!connecting) {
+#ifdef HAVE_PF
+        /* Remove the address from the table it was added to on connect,
+         * whatever the outcome of any later re-authentication */
+        tableName = [session installedPFTable];
+        if (tableName) {
+            [session setInstalledPFTable: nil];
+            if (!pf_client_connect_disconnect(ctx, tableName, remoteAddress, NO))
+                return OPENVPN_PLUGIN_FUNC_ERROR;
         }
+#endif /* HAVE_PF */
+        return OPENVPN_PLUGIN_FUNC_SUCCESS;
     }
 
-#ifdef HAVE_PF
-    /* Grab the requested PF table name, if any */
-    if (groupConfig) {
-        tableName = [groupConfig pfTable];
-    } else {
-        tableName = [ctx->config pfTable];
+    if (![session isAuthenticated]) {
+        [TRLog error: "Client connected without successful LDAP authentication."];
+        return OPENVPN_PLUGIN_FUNC_ERROR;
     }
 
-    if (tableName)
-        if (!pf_client_connect_disconnect(ctx, tableName, remoteAddress, connecting))
-        return OPENVPN_PLUGIN_FUNC_ERROR;
+#ifdef HAVE_PF
+    tableName = [session pfTable];
+    if (tableName) {
+        if (!pf_client_connect_disconnect(ctx, tableName, remoteAddress, YES))
+            return OPENVPN_PLUGIN_FUNC_ERROR;
+        [session setInstalledPFTable: tableName];
+    }
 #endif /* HAVE_PF */
 
     return OPENVPN_PLUGIN_FUNC_SUCCESS;
@@ -533,66 +946,48 @@ static int handle_client_connect_disconnect(ldap_ctx *ctx, TRLDAPConnection *lda
 
 
 OPENVPN_EXPORT int
-openvpn_plugin_func_v1(openvpn_plugin_handle_t handle, const int type, const char *argv[], const char *envp[]) {
-    const char *username, *password, *remoteAddress;
-    ldap_ctx *ctx = handle;
-    TRLDAPConnection *ldap = nil;
-    TRLDAPEntry *ldapUser = nil;
+openvpn_plugin_func_v3(const int version, struct openvpn_plugin_args_func_in const *args, struct openvpn_plugin_args_func_return *retptr) {
+    plugin_env env;
+    const char **envp = (const char **) args->envp;
+    const int type = args->type;
+    ldap_ctx *ctx = (ldap_ctx *) args->handle;
+    TRVPNSession *session = args->per_client_context;
     TRAutoreleasePool *pool = nil;
     int ret = OPENVPN_PLUGIN_FUNC_ERROR;
 
     /* Per-request allocation pool. */
     pool = [[TRAutoreleasePool alloc] init];
 
-    username = get_env("username", envp);
-    TRString *userName=[[TRString alloc]initWithCString: username];
-    password = get_env("password", envp);
-    remoteAddress = get_env("ifconfig_pool_remote_ip", envp);
-
-
-    /* At the very least, we need a username to work with */
-    if (!username) {
-        [TRLog debug: "No remote username supplied to OpenVPN LDAP Plugin."];
-        goto cleanup;
-    }
-
-    /* Create an LDAP connection */
-    if (!(ldap = connect_ldap(ctx->config))) {
-        [TRLog error: "LDAP connect failed."];
-        goto cleanup;
-    }
-
-    /* Find the user record */
-    ldapUser = find_ldap_user(ldap, ctx->config, username);
-    [ldapUser setRDN: userName];
-    if (!ldapUser) {
-        /* No such user. */
-        [TRLog warning: "LDAP user \"%s\" was not found.", username];
-        goto cleanup;
-    }
+    parse_env(envp, &env);
 
     switch (type) {
         /* Password Authentication */
         case OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY:
-            if (!password) {
+            if (!env.username) {
+                [TRLog debug: "No remote username supplied to OpenVPN LDAP Plugin."];
+            } else if (!env.password) {
                 [TRLog debug: "No remote password supplied to OpenVPN LDAP Plugin (OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY)."];
+            } else if (ctx->workQueue && env.authControlFile) {
+                /* Hand password authentication off to a worker thread, if
+                 * enabled and supported by OpenVPN */
+                ret = defer_auth_user_pass_verify(ctx, session, env.username, env.password, env.authControlFile);
             } else {
-                ret = handle_auth_user_pass_verify(ctx, ldap, ldapUser, password);
+                ret = verify_user_pass(ctx, session, env.username, env.password);
             }
             break;
         /* New connection established */
         case OPENVPN_PLUGIN_CLIENT_CONNECT:
-            if (!remoteAddress) {
+            if (!env.remoteAddress) {
                 [TRLog debug: "No remote address supplied to OpenVPN LDAP Plugin (OPENVPN_PLUGIN_CLIENT_CONNECT)."];
             } else {
-                ret = handle_client_connect_disconnect(ctx, ldap, ldapUser, remoteAddress, YES);
+                ret = handle_client_connect_disconnect(ctx, session, env.remoteAddress, YES);
             }
             break;
         case OPENVPN_PLUGIN_CLIENT_DISCONNECT:
-            if (!remoteAddress) {
+            if (!env.remoteAddress) {
                 [TRLog debug: "No remote address supplied to OpenVPN LDAP Plugin (OPENVPN_PLUGIN_CLIENT_DISCONNECT)."];
             } else {
-                ret = handle_client_connect_disconnect(ctx, ldap, ldapUser, remoteAddress, NO);
+                ret = handle_client_connect_disconnect(ctx, session, env.remoteAddress, NO);
             }
             break;
         default:
@@ -600,13 +995,6 @@ openvpn_plugin_func_v1(openvpn_plugin_handle_t handle, const int type, const cha
             break;
     }
 
-cleanup:
-    if (ldapUser != nil)
-        [ldapUser release];
-
-    if (ldap != nil)
-        [ldap release];
-
     if (pool != nil)
         [pool release];
 
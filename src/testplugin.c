@@ -35,6 +35,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdarg.h>
 #include <errno.h>
 
 #include <openvpn-plugin.h>
@@ -119,6 +120,36 @@ static plugin_data *plugin_data_init (const char *config_file) {
     return data;
 }
 
+/** Plugin logging callback -- log to stderr */
+static void plugin_vlog (openvpn_plugin_log_flags_t flags, const char *plugin_name, const char *format, va_list args) {
+    fprintf(stderr, "%s: ", plugin_name);
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+}
+
+static void plugin_log (openvpn_plugin_log_flags_t flags, const char *plugin_name, const char *format, ...) {
+    va_list ap;
+
+    va_start(ap, format);
+    plugin_vlog(flags, plugin_name, format, ap);
+    va_end(ap);
+}
+
+/** Call the plugin's v3 function entry point */
+static int plugin_func (openvpn_plugin_handle_t handle, void *client, const int type, const char **argv, const char **envp) {
+    struct openvpn_plugin_args_func_in args = {
+        .type = type,
+        .argv = argv,
+        .envp = envp,
+        .handle = handle,
+        .per_client_context = client
+    };
+    struct openvpn_plugin_args_func_return ret;
+
+    memset(&ret, 0, sizeof(ret));
+    return openvpn_plugin_func_v3(OPENVPN_PLUGINv3_STRUCTVER, &args, &ret);
+}
+
 static void plugin_data_free (plugin_data *data) {
     if (data->username)
         free(data->username);
@@ -139,10 +170,15 @@ static void plugin_data_free (plugin_data *data) {
 }
 
 int main(int argc, const char *argv[]) {
-    openvpn_plugin_handle_t handle;
+    struct openvpn_plugin_callbacks callbacks = {
+        .plugin_log = plugin_log,
+        .plugin_vlog = plugin_vlog
+    };
+    struct openvpn_plugin_args_open_return open_ret;
+    openvpn_plugin_handle_t handle = NULL;
+    void *client = NULL;
     plugin_data *data;
     const char *config_file;
-    unsigned int plugin_type;
     int retval = 1;
     int err;
 
@@ -155,15 +191,28 @@ int main(int argc, const char *argv[]) {
     /* Configure the plugin environment */
     data = plugin_data_init(config_file);
 
-    handle = openvpn_plugin_open_v1(&plugin_type, data->argp, data->envp);
+    struct openvpn_plugin_args_open_in open_args = {
+        .type_mask = 0,
+        .argv = data->argp,
+        .envp = data->envp,
+        .callbacks = &callbacks
+    };
+
+    memset(&open_ret, 0, sizeof(open_ret));
+    err = openvpn_plugin_open_v3(OPENVPN_PLUGINv3_STRUCTVER, &open_args, &open_ret);
 
-    if (!handle) {
+    if (err != OPENVPN_PLUGIN_FUNC_SUCCESS) {
         printf("Initialization Failed!\n");
-        goto cleanup;
+        plugin_data_free(data);
+        exit(retval);
     }
+    handle = (openvpn_plugin_handle_t) open_ret.handle;
+
+    /* Per-client context */
+    client = openvpn_plugin_client_constructor_v1(handle);
 
     /* Authenticate */
-    err = openvpn_plugin_func_v1(handle, OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY, data->argp_script, data->envp);
+    err = plugin_func(handle, client, OPENVPN_PLUGIN_AUTH_USER_PASS_VERIFY, data->argp_script, data->envp);
     if (err != OPENVPN_PLUGIN_FUNC_SUCCESS) {
         printf("Authorization Failed!\n");
         goto cleanup;
@@ -172,7 +221,7 @@ int main(int argc, const char *argv[]) {
     }
 
     /* Client Connect */
-    err = openvpn_plugin_func_v1(handle, OPENVPN_PLUGIN_CLIENT_CONNECT, data->argp_script, data->envp);
+    err = plugin_func(handle, client, OPENVPN_PLUGIN_CLIENT_CONNECT, data->argp_script, data->envp);
     if (err != OPENVPN_PLUGIN_FUNC_SUCCESS) {
         printf("client-connect failed!\n");
         goto cleanup;
@@ -181,7 +230,7 @@ int main(int argc, const char *argv[]) {
     }
 
     /* Client Disconnect */
-    err = openvpn_plugin_func_v1(handle, OPENVPN_PLUGIN_CLIENT_DISCONNECT, data->argp, data->envp);
+    err = plugin_func(handle, client, OPENVPN_PLUGIN_CLIENT_DISCONNECT, data->argp, data->envp);
     if (err != OPENVPN_PLUGIN_FUNC_SUCCESS) {
         printf("client-disconnect failed!\n");
         goto cleanup;
@@ -193,6 +242,7 @@ int main(int argc, const char *argv[]) {
     retval = 0;
 
 cleanup:
+    openvpn_plugin_client_destructor_v1(handle, client);
     openvpn_plugin_close_v1(handle);
     plugin_data_free(data);
 
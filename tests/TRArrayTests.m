@@ -164,4 +164,57 @@
     [string2 release];
 }
 
+- (void) test_objectAtIndex {
+    TRArray *array = [[TRArray alloc] init];
+    TRString *string1 = [[TRString alloc] initWithCString: "String 1"];
+    TRString *string2 = [[TRString alloc] initWithCString: "String 2"];
+
+    /* Indices are in insertion order */
+    [array addObject: string1];
+    [array addObject: string2];
+    fail_unless([array objectAtIndex: 0] == string1);
+    fail_unless([array objectAtIndex: 1] == string2);
+
+    /* Out of range */
+    fail_unless([array objectAtIndex: 2] == nil);
+
+    [array release];
+    [string1 release];
+    [string2 release];
+}
+
+- (void) test_initWithCapacity {
+    TRArray *array = [[TRArray alloc] initWithCapacity: 2];
+    TRString *string = [[TRString alloc] initWithCString: "String"];
+    TREnumerator *iter;
+    unsigned int i;
+
+    /* Grow well past the initial capacity */
+    for (i = 0; i < 100; i++)
+        [array addObject: string];
+
+    fail_unless([array count] == 100);
+    fail_unless([string retainCount] == 101);
+
+    /* Every object survives the reallocation */
+    i = 0;
+    iter = [array objectReverseEnumerator];
+    while ([iter nextObject] == string)
+        i++;
+    fail_unless(i == 100);
+
+    /* Shrink and regrow */
+    for (i = 0; i < 50; i++)
+        [array removeObject];
+    fail_unless([array count] == 50);
+    fail_unless([string retainCount] == 51);
+
+    [array reserveCapacity: 200];
+    fail_unless([array count] == 50);
+
+    [array release];
+    fail_unless([string retainCount] == 1);
+    [string release];
+}
+
 @end
\ No newline at end of file
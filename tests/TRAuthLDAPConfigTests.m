@@ -45,8 +45,25 @@
 
 /* Data Constants */
 #define TEST_LDAP_URL    "ldap://ldap1.example.org"
+#define TEST_LDAP_URL2    "ldap://ldap2.example.org"
 #define TEST_LDAP_TIMEOUT    15
+#define TEST_LDAP_POOL_SIZE    8
+#define TEST_LDAP_HEDGE_DELAY    50
+#define TEST_LDAP_MAX_IN_FLIGHT    16
+#define TEST_WORKER_THREADS    2
+#define TEST_QUEUE_DEPTH    32
+#define TEST_GROUP_SNAPSHOT_REFRESH    600
+#define TEST_CACHE_TTL    300
+#define TEST_CACHE_MAX_ENTRIES    512
+#define TEST_CACHE_HASH_ITERATIONS    1000
+#define TEST_NEGATIVE_CACHE_TTL    60
+#define TEST_NEGATIVE_CACHE_MAX_ENTRIES    2048
+#define TEST_MAX_FAILED_BINDS    3
 #define TEST_LDAP_BASEDN "ou=People,dc=example,dc=com"
+#define TEST_SIZE_LIMIT    10
+#define TEST_TIME_LIMIT    5
+#define TEST_GROUP_SIZE_LIMIT    5000
+#define TEST_GROUP_PAGE_SIZE    500
 
 @interface TRAuthLDAPConfigTests : PXTestCase @end
 
@@ -54,6 +71,7 @@
 
 - (void) test_initWithConfigFile {
     TRAuthLDAPConfig *config;
+    TRLDAPGroupConfig *group;
     TRString *string;
 
     config = [[TRAuthLDAPConfig alloc] initWithConfigFile: AUTH_LDAP_CONF];
@@ -64,13 +82,47 @@
     fail_if(!string, "-[TRAuthLDAPConfig url] returned NULL");
     fail_unless(strcmp([string cString], TEST_LDAP_URL) == 0, "-[TRAuthLDAPConfig url] returned incorrect value. (Expected %s, Got %s)", TEST_LDAP_URL, [string cString]);
 
+    fail_unless([[config urls] count] == 2, "-[TRAuthLDAPConfig urls] returned %u URLs", [[config urls] count]);
+    string = [[[config urls] objectReverseEnumerator] nextObject];
+    fail_unless(strcmp([string cString], TEST_LDAP_URL) == 0);
+    string = [[config urls] lastObject];
+    fail_unless(strcmp([string cString], TEST_LDAP_URL2) == 0);
+
     fail_unless([config timeout] == TEST_LDAP_TIMEOUT);
 
+    fail_unless([config poolSize] == TEST_LDAP_POOL_SIZE);
+
+    fail_unless([config hedgeDelay] == TEST_LDAP_HEDGE_DELAY);
+    fail_unless([config maxInFlight] == TEST_LDAP_MAX_IN_FLIGHT);
+
     fail_unless([config tlsEnabled]);
 
+    fail_unless([config deferredAuth]);
+    fail_unless([config workerThreads] == TEST_WORKER_THREADS);
+    fail_unless([config queueDepth] == TEST_QUEUE_DEPTH);
+    fail_unless([config failFast]);
+    fail_unless([config combinedGroupSearch]);
+    fail_unless([config groupSnapshotRefresh] == TEST_GROUP_SNAPSHOT_REFRESH);
+    fail_unless([config syncRepl]);
+    fail_unless([config sizeLimit] == TEST_SIZE_LIMIT);
+    fail_unless([config timeLimit] == TEST_TIME_LIMIT);
+
+    fail_unless([config cacheEnabled]);
+    fail_unless([config cacheTTL] == TEST_CACHE_TTL);
+    fail_unless([config cacheMaxEntries] == TEST_CACHE_MAX_ENTRIES);
+    fail_unless([config cacheHashIterations] == TEST_CACHE_HASH_ITERATIONS);
+    fail_unless([config negativeCacheTTL] == TEST_NEGATIVE_CACHE_TTL);
+    fail_unless([config negativeCacheMaxEntries] == TEST_NEGATIVE_CACHE_MAX_ENTRIES);
+    fail_unless([config maxFailedBinds] == TEST_MAX_FAILED_BINDS);
+
     fail_if([config ldapGroups] == nil);
     fail_if([[config ldapGroups] lastObject] == nil);
 
+    group = [[config ldapGroups] lastObject];
+    fail_unless([group sizeLimit] == TEST_GROUP_SIZE_LIMIT);
+    fail_unless([group timeLimit] == 0);
+    fail_unless([group pageSize] == TEST_GROUP_PAGE_SIZE);
+
 #ifdef HAVE_PF
     fail_unless([config pfEnabled]);
 #endif
@@ -0,0 +1,117 @@
+/*
+ * TRCredentialCacheTests.m vi:ts=4:sw=4:expandtab:
+ * TRCredentialCache Unit Tests
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import "PXTestCase.h"
+
+#import "TRCredentialCache.h"
+
+/* Keep the tests fast */
+#define TEST_ITERATIONS 10
+
+@interface TRCredentialCacheTests : PXTestCase @end
+
+@implementation TRCredentialCacheTests
+
+- (void) test_credentialForUser {
+    TRCredentialCache *cache = [[TRCredentialCache alloc] initWithCapacity: 4 ttl: 60 iterations: TEST_ITERATIONS];
+    TRString *username = [[TRString alloc] initWithCString: "user"];
+    TRString *dn = [[TRString alloc] initWithCString: "uid=user,ou=People,dc=example,dc=com"];
+    TRLDAPGroupConfig *groupConfig = [[TRLDAPGroupConfig alloc] init];
+    TRCachedCredential *credential;
+
+    [cache setCredentialForUser: username dn: dn groupConfig: groupConfig password: "secret"];
+
+    credential = [cache credentialForUser: username password: "secret"];
+    fail_if(credential == nil, "-[TRCredentialCache credentialForUser:password:] rejected the cached password");
+    fail_unless([credential dn] == dn);
+    fail_unless([credential groupConfig] == groupConfig);
+
+    fail_unless([cache credentialForUser: username password: "wrong"] == nil);
+
+    [cache removeCredentialForUser: username];
+    fail_unless([cache credentialForUser: username password: "secret"] == nil);
+
+    [username release];
+    [dn release];
+    [groupConfig release];
+    [cache release];
+}
+
+- (void) test_removeCredentialsForDN {
+    TRCredentialCache *cache = [[TRCredentialCache alloc] initWithCapacity: 4 ttl: 60 iterations: TEST_ITERATIONS];
+    TRString *user = [[TRString alloc] initWithCString: "user"];
+    TRString *other = [[TRString alloc] initWithCString: "other"];
+    TRString *userDN = [[TRString alloc] initWithCString: "uid=user,ou=People,dc=example,dc=com"];
+    TRString *otherDN = [[TRString alloc] initWithCString: "uid=other,ou=People,dc=example,dc=com"];
+    TRString *changedDN = [[TRString alloc] initWithCString: "UID=user,ou=People,dc=example,dc=com"];
+
+    [cache setCredentialForUser: user dn: userDN groupConfig: nil password: "secret"];
+    [cache setCredentialForUser: other dn: otherDN groupConfig: nil password: "secret"];
+
+    /* DNs are compared case-insensitively */
+    [cache removeCredentialsForDN: changedDN];
+    fail_unless([cache credentialForUser: user password: "secret"] == nil);
+    fail_if([cache credentialForUser: other password: "secret"] == nil);
+
+    [cache removeAllCredentials];
+    fail_unless([cache credentialForUser: other password: "secret"] == nil);
+
+    [user release];
+    [other release];
+    [userDN release];
+    [otherDN release];
+    [changedDN release];
+    [cache release];
+}
+
+- (void) test_matchesPassword {
+    TRString *dn = [[TRString alloc] initWithCString: "uid=user,ou=People,dc=example,dc=com"];
+    TRCachedCredential *first;
+    TRCachedCredential *second;
+
+    first = [[TRCachedCredential alloc] initWithDN: dn groupConfig: nil password: "secret" iterations: TEST_ITERATIONS];
+    second = [[TRCachedCredential alloc] initWithDN: dn groupConfig: nil password: "secret" iterations: TEST_ITERATIONS];
+
+    fail_unless([first matchesPassword: "secret"]);
+    fail_unless([second matchesPassword: "secret"]);
+    fail_if([first matchesPassword: "Secret"]);
+
+    [first release];
+    [second release];
+    [dn release];
+}
+
+@end
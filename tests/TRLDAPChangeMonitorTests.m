@@ -0,0 +1,87 @@
+/*
+ * TRLDAPChangeMonitorTests.m vi:ts=4:sw=4:expandtab:
+ * TRLDAPChangeMonitor Unit Tests
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import "PXTestCase.h"
+
+#import "TRLDAPChangeMonitor.h"
+#import "TRAuthLDAPConfig.h"
+
+#import "tests.h"
+
+@interface TRLDAPChangeMonitorTests : PXTestCase @end
+
+@implementation TRLDAPChangeMonitorTests
+
+- (void) test_isDNWithinBaseDN {
+    TRString *base = [TRString stringWithCString: "dc=example,dc=com"];
+
+    fail_unless([TRLDAPChangeMonitor isDN: [TRString stringWithCString: "dc=example,dc=com"] withinBaseDN: base]);
+    fail_unless([TRLDAPChangeMonitor isDN: [TRString stringWithCString: "uid=user,ou=People,DC=Example,DC=com"] withinBaseDN: base]);
+    fail_unless([TRLDAPChangeMonitor isDN: [TRString stringWithCString: "dc=example,dc=com"] withinBaseDN: [TRString stringWithCString: ""]]);
+
+    /* Suffixes must fall on an RDN boundary */
+    fail_if([TRLDAPChangeMonitor isDN: [TRString stringWithCString: "dc=badexample,dc=com"] withinBaseDN: base]);
+    fail_if([TRLDAPChangeMonitor isDN: [TRString stringWithCString: "dc=com"] withinBaseDN: base]);
+}
+
+- (void) test_baseDNs {
+    TRAuthLDAPConfig *config;
+    TRLDAPConnectionPool *pool;
+    TRLDAPChangeMonitor *monitor;
+    TRArray *baseDNs;
+
+    config = [[TRAuthLDAPConfig alloc] initWithConfigFile: AUTH_LDAP_CONF];
+    fail_if(config == NULL, "-[[TRAuthLDAPConfig alloc] initWithConfigFile:] returned NULL");
+
+    pool = [[TRLDAPConnectionPool alloc] initWithConfig: config maxIdleConnections: 1];
+
+    baseDNs = [[TRArray alloc] init];
+    [baseDNs addObject: [TRString stringWithCString: "ou=People,dc=example,dc=com"]];
+    [baseDNs addObject: [TRString stringWithCString: "ou=Groups,dc=example,dc=com"]];
+    [baseDNs addObject: [TRString stringWithCString: "ou=Groups,dc=example,dc=com"]];
+    [baseDNs addObject: [TRString stringWithCString: "cn=admins,ou=Groups,dc=example,dc=com"]];
+
+    /* Nested and duplicate bases share a session */
+    monitor = [[TRLDAPChangeMonitor alloc] initWithConnectionPool: pool baseDNs: baseDNs delegate: nil retryInterval: 30];
+    fail_unless([[monitor baseDNs] count] == 2, "Expected 2 base DNs, got %u", [[monitor baseDNs] count]);
+
+    [monitor release];
+    [baseDNs release];
+    [pool release];
+    [config release];
+}
+
+@end
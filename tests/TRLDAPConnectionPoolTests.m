@@ -0,0 +1,179 @@
+/*
+ * TRLDAPConnectionPoolTests.m vi:ts=4:sw=4:expandtab:
+ * TRLDAPConnectionPool Unit Tests
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import <string.h>
+
+#import "PXTestCase.h"
+
+#import "TRLDAPConnectionPool.h"
+#import "TRAuthLDAPConfig.h"
+
+#import "mockldap.h"
+#import "tests.h"
+
+@interface TRLDAPConnectionPoolTests : PXTestCase @end
+
+@implementation TRLDAPConnectionPoolTests
+
+- (void) test_initWithConfig {
+    TRAuthLDAPConfig *config;
+    TRLDAPConnectionPool *pool;
+
+    config = [[TRAuthLDAPConfig alloc] initWithConfigFile: AUTH_LDAP_CONF];
+    fail_if(config == NULL, "-[[TRAuthLDAPConfig alloc] initWithConfigFile:] returned NULL");
+
+    pool = [[TRLDAPConnectionPool alloc] initWithConfig: config maxIdleConnections: [config poolSize]];
+    fail_if(pool == nil, "-[[TRLDAPConnectionPool alloc] initWithConfig:maxIdleConnections:] returned nil");
+
+    /* No connections are opened until one is requested */
+    fail_unless([pool idleCount] == 0);
+
+    /* One server per configured URL, in configuration order */
+    fail_unless([pool serverCount] == 2, "-[TRLDAPConnectionPool serverCount] returned %u", [pool serverCount]);
+    fail_unless(strcmp([[[pool serverAtIndex: 0] url] cString], [[config url] cString]) == 0);
+
+    [pool release];
+    [config release];
+}
+
+- (void) test_checkinNil {
+    TRAuthLDAPConfig *config;
+    TRLDAPConnectionPool *pool;
+
+    config = [[TRAuthLDAPConfig alloc] initWithConfigFile: AUTH_LDAP_CONF];
+    pool = [[TRLDAPConnectionPool alloc] initWithConfig: config maxIdleConnections: 1];
+
+    /* Returning a failed (nil) checkout must be harmless */
+    [pool checkin: nil];
+    fail_unless([pool idleCount] == 0);
+
+    [pool release];
+    [config release];
+}
+
+- (void) test_findUser {
+    TRAuthLDAPConfig *config;
+    TRLDAPConnectionPool *pool;
+    MockLDAPConnection *conn;
+    TRLDAPEntry *user;
+    TRArray *entries;
+    TRString *dn;
+    BOOL notFound;
+
+    config = [[TRAuthLDAPConfig alloc] initWithConfigFile: AUTH_LDAP_CONF];
+    pool = [[TRLDAPConnectionPool alloc] initWithConfig: config maxIdleConnections: 1];
+    conn = [[MockLDAPConnection alloc] init];
+
+    dn = [[TRString alloc] initWithCString: "uid=user,ou=People,dc=example,dc=com"];
+    user = [[TRLDAPEntry alloc] initWithDN: dn attributes: nil];
+    entries = [[TRArray alloc] init];
+    [entries addObject: user];
+
+    [conn setEntries: entries
+        forSearchWithFilter: [TRString stringWithCString: "(&(uid=user)(accountStatus=active))"]
+        baseDN: [config baseDN]];
+    [conn setFailureForSearchWithFilter: [TRString stringWithCString: "(&(uid=broken)(accountStatus=active))"]
+        baseDN: [config baseDN]];
+
+    /* A known user */
+    fail_unless([pool findUser: "user" withConnection: conn notFound: &notFound] == user);
+    fail_if(notFound);
+
+    /* A search that succeeds, but finds nobody */
+    fail_unless([pool findUser: "nobody" withConnection: conn notFound: &notFound] == nil);
+    fail_unless(notFound, "-[TRLDAPConnectionPool findUser:withConnection:notFound:] did not report an unknown user");
+
+    /* A failed search says nothing about the user */
+    fail_unless([pool findUser: "broken" withConnection: conn notFound: &notFound] == nil);
+    fail_if(notFound);
+
+    [entries release];
+    [user release];
+    [dn release];
+    [conn release];
+    [pool release];
+    [config release];
+}
+
+- (void) test_hedgeLoserResponseTime {
+    TRAuthLDAPConfig *config;
+    TRLDAPConnectionPool *pool;
+    TRLDAPServer *server;
+    MockLDAPConnection *primary;
+    MockLDAPConnection *hedge;
+    TRString *filter;
+    BOOL succeeded;
+    int i;
+
+    config = [[TRAuthLDAPConfig alloc] initWithConfigFile: AUTH_LDAP_CONF];
+    pool = [[TRLDAPConnectionPool alloc] initWithConfig: config maxIdleConnections: 1];
+    filter = [[TRString alloc] initWithCString: "(uid=user)"];
+
+    /* A primary server that has stopped answering */
+    server = [pool serverAtIndex: 0];
+    primary = [[MockLDAPConnection alloc] init];
+    [primary setServer: server];
+    [primary setUnresponsive: YES];
+
+    /* An idle connection to the second server, for the hedged request */
+    hedge = [[MockLDAPConnection alloc] init];
+    [hedge setServer: [pool serverAtIndex: 1]];
+    [hedge beginLease];
+    [pool checkin: hedge];
+
+    /* Until now, the primary server has answered quickly */
+    for (i = 0; i < 20; i++)
+        [server addResponseTime: 1];
+
+    /* Each search is hedged, and the hedge wins */
+    for (i = 0; i < 5; i++) {
+        [pool searchWithConnection: primary filter: filter scope: LDAP_SCOPE_SUBTREE baseDN: [config baseDN] attributes: nil sizeLimit: 0 timeLimit: 0 succeeded: &succeeded];
+        fail_unless(succeeded);
+    }
+    fail_unless([primary abandonedCount] == 5, "Expected 5 abandoned requests, got %u", [primary abandonedCount]);
+
+    /* The abandoned primaries each waited at least HedgeDelay, which the
+     * server's percentile must reflect */
+    fail_unless([server responseTimePercentile: 95] >= [config hedgeDelay], "95th percentile response time did not rise");
+
+    [hedge release];
+    [primary release];
+    [filter release];
+    [pool release];
+    [config release];
+}
+
+@end
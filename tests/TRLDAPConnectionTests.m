@@ -86,4 +86,19 @@
     [conn release];
 }
 
+- (void) testInvalidate {
+    TRLDAPConnection *conn;
+
+    conn = [[TRLDAPConnection alloc] initWithURL: [TRString stringWithCString: TEST_LDAP_URL] timeout: TEST_LDAP_TIMEOUT];
+    fail_if(conn == nil, "-[[TRLDAPConnection alloc] initWithURL:] returned nil");
+
+    /* Not yet connected */
+    fail_unless([conn isValid]);
+
+    [conn invalidate];
+    fail_if([conn isValid]);
+
+    [conn release];
+}
+
 @end
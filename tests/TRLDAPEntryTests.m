@@ -36,6 +36,8 @@
 #import <config.h>
 #endif
 
+#import <string.h>
+
 #import "PXTestCase.h"
 #import "TRLDAPEntry.h"
 
@@ -55,7 +57,8 @@
 
     entry = [[TRLDAPEntry alloc] initWithDN: dn attributes: attributes];
 
-    fail_unless([entry attributes] == attributes);
+    fail_unless([entry attributeCount] == 1);
+    fail_unless([[entry attributes] valueForKey: dn] == dn);
     fail_unless([entry dn] == dn);
 
     [entry release];
@@ -63,4 +66,62 @@
     [attributes release];
 }
 
+- (void) testValuesForAttribute {
+    TRLDAPEntry *entry;
+    TRString *dn;
+    TRString *name;
+    TRArray *pairs;
+    TRArray *values;
+    const char *names[] = { "uid", "objectClass", "cn", "memberOf" };
+    int i;
+
+    dn = [[TRString alloc] initWithCString: "uid=jdoe,ou=People,dc=example,dc=com"];
+    pairs = [[TRArray alloc] init];
+    for (i = 0; i < 4; i++) {
+        name = [[TRString alloc] initWithCString: names[i]];
+        values = [[TRArray alloc] init];
+        [values addObject: name];
+        [pairs addObject: name];
+        [pairs addObject: values];
+        [name release];
+        [values release];
+    }
+
+    entry = [[TRLDAPEntry alloc] initWithDN: dn attributePairs: pairs];
+    fail_unless([entry attributeCount] == 4);
+
+    /* Attribute names are case-insensitive */
+    for (i = 0; i < 4; i++) {
+        values = [entry valuesForAttributeCString: names[i]];
+        fail_if(values == nil);
+        fail_unless(strcmp([[values lastObject] cString], names[i]) == 0);
+    }
+    fail_if([entry valuesForAttributeCString: "OBJECTCLASS"] == nil);
+    fail_unless([entry valuesForAttributeCString: "description"] == nil);
+
+    [entry release];
+    [pairs release];
+    [dn release];
+}
+
+- (void) testNormalizedDN {
+    TRString *dn;
+    TRString *expected;
+
+    expected = [TRLDAPEntry normalizedDN: [TRString stringWithCString: "uid=jdoe,ou=People,dc=example,dc=com"]];
+    fail_unless(strcmp([expected cString], "uid=jdoe,ou=people,dc=example,dc=com") == 0, "Unexpected normalized DN: %s", [expected cString]);
+
+    /* Spacing and case */
+    dn = [TRLDAPEntry normalizedDN: [TRString stringWithCString: "UID=jdoe, ou=People,  dc=example,dc=com"]];
+    fail_unless(strcmp([dn cString], [expected cString]) == 0, "Unexpected normalized DN: %s", [dn cString]);
+
+    /* Escaping */
+    dn = [TRLDAPEntry normalizedDN: [TRString stringWithCString: "uid=\\6adoe,ou=People,dc=example,dc=com"]];
+    fail_unless(strcmp([dn cString], [expected cString]) == 0, "Unexpected normalized DN: %s", [dn cString]);
+
+    /* Not a DN */
+    dn = [TRLDAPEntry normalizedDN: [TRString stringWithCString: "JDoe"]];
+    fail_unless(strcmp([dn cString], "jdoe") == 0);
+}
+
 @end
\ No newline at end of file
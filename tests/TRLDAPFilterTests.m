@@ -0,0 +1,187 @@
+/*
+ * TRLDAPFilterTests.m vi:ts=4:sw=4:expandtab:
+ * TRLDAPFilter Unit Tests
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import "PXTestCase.h"
+
+#import "TRLDAPFilter.h"
+#import "TRHash.h"
+
+@interface TRLDAPFilterTests : PXTestCase @end
+
+/* Add a single-valued attribute to an attribute hash */
+static void add_attribute (TRHash *attributes, const char *name, const char *value) {
+    TRString *key = [[TRString alloc] initWithCString: name];
+    TRString *string = [[TRString alloc] initWithCString: value];
+    TRArray *values = [[TRArray alloc] init];
+
+    [values addObject: string];
+    [attributes setObject: values forKey: key];
+
+    [key release];
+    [string release];
+    [values release];
+}
+
+/* Returns YES if the filter string can be evaluated locally against the entry */
+static BOOL filter_can_evaluate (const char *filterString, TRLDAPEntry *entry) {
+    TRString *string = [[TRString alloc] initWithCString: filterString];
+    TRLDAPFilter *filter = [[TRLDAPFilter alloc] initWithString: string];
+    BOOL result;
+
+    [string release];
+    if (!filter)
+        return NO;
+
+    result = [filter canEvaluateEntry: entry];
+    [filter release];
+
+    return result;
+}
+
+/* Returns YES if the filter string matches the entry */
+static BOOL filter_matches (const char *filterString, TRLDAPEntry *entry) {
+    TRString *string = [[TRString alloc] initWithCString: filterString];
+    TRLDAPFilter *filter = [[TRLDAPFilter alloc] initWithString: string];
+    BOOL result;
+
+    [string release];
+    if (!filter)
+        return NO;
+
+    result = [filter matchesEntry: entry];
+    [filter release];
+
+    return result;
+}
+
+@implementation TRLDAPFilterTests
+
+- (void) test_matchesEntry {
+    TRHash *attributes = [[TRHash alloc] initWithCapacity: 4];
+    TRString *dn = [[TRString alloc] initWithCString: "cn=developers,ou=Groups,dc=example,dc=com"];
+    TRLDAPEntry *entry;
+
+    add_attribute(attributes, "cn", "developers");
+    add_attribute(attributes, "objectClass", "groupOfUniqueNames");
+    add_attribute(attributes, "gidNumber", "1000");
+    entry = [[TRLDAPEntry alloc] initWithDN: dn attributes: attributes];
+
+    fail_unless(filter_matches("(cn=developers)", entry));
+    fail_unless(filter_matches("(CN=Developers)", entry));
+    fail_if(filter_matches("(cn=artists)", entry));
+
+    fail_unless(filter_matches("(|(cn=developers)(cn=artists))", entry));
+    fail_unless(filter_matches("(&(cn=developers)(objectClass=groupOfUniqueNames))", entry));
+    fail_if(filter_matches("(&(cn=developers)(objectClass=posixGroup))", entry));
+    fail_unless(filter_matches("(!(cn=artists))", entry));
+
+    fail_unless(filter_matches("(cn=*)", entry));
+    fail_if(filter_matches("(description=*)", entry));
+    fail_unless(filter_matches("(cn=dev*)", entry));
+    fail_unless(filter_matches("(cn=*lop*)", entry));
+    fail_unless(filter_matches("(cn=d*l*rs)", entry));
+    fail_if(filter_matches("(cn=*art*)", entry));
+    fail_unless(filter_matches("(cn=\\64evelopers)", entry));
+
+    fail_unless(filter_matches("(gidNumber>=999)", entry));
+    fail_if(filter_matches("(gidNumber<=999)", entry));
+
+    [entry release];
+    [attributes release];
+    [dn release];
+}
+
+- (void) test_attributes {
+    TRString *string = [[TRString alloc] initWithCString: "(|(cn=developers)(CN=artists)(objectClass=*))"];
+    TRLDAPFilter *filter = [[TRLDAPFilter alloc] initWithString: string];
+
+    fail_if(filter == nil);
+    fail_unless([[filter attributes] count] == 2);
+
+    [filter release];
+    [string release];
+}
+
+- (void) test_initWithInvalidFilter {
+    const char *invalid[] = {
+        "cn=developers",
+        "(cn=developers",
+        "(cn:dn:=developers)",
+        "(&(cn=developers)",
+        "(cn>=dev*)",
+        NULL
+    };
+    const char **p;
+
+    for (p = invalid; *p; p++) {
+        TRString *string = [[TRString alloc] initWithCString: *p];
+        TRLDAPFilter *filter = [[TRLDAPFilter alloc] initWithString: string];
+        fail_unless(filter == nil, "-[TRLDAPFilter initWithString:] accepted \"%s\"", *p);
+        [string release];
+    }
+}
+
+- (void) test_canEvaluateEntry {
+    TRHash *attributes = [[TRHash alloc] initWithCapacity: 4];
+    TRString *dn = [[TRString alloc] initWithCString: "cn=developers,ou=Groups,dc=example,dc=com"];
+    TRLDAPEntry *entry;
+
+    add_attribute(attributes, "cn", "developers");
+    add_attribute(attributes, "objectClass", "groupOfUniqueNames");
+    entry = [[TRLDAPEntry alloc] initWithDN: dn attributes: attributes];
+
+    fail_unless(filter_can_evaluate("(cn=developers)", entry));
+    fail_unless(filter_can_evaluate("(&(cn=dev*)(objectClass=groupOfUniqueNames))", entry));
+
+    /* The entry may have been returned for a value it does not show,
+     * so a negation over an absent attribute must not claim it */
+    fail_unless(filter_matches("(!(ou=contractors))", entry));
+    fail_if(filter_can_evaluate("(!(ou=contractors))", entry));
+    fail_if(filter_can_evaluate("(!(cn=artists))", entry));
+
+    /* Approximate matching is left to the server */
+    fail_if(filter_can_evaluate("(cn~=developers)", entry));
+
+    /* Absent attributes */
+    fail_if(filter_can_evaluate("(ou=contractors)", entry));
+    fail_if(filter_can_evaluate("(|(cn=developers)(ou=contractors))", entry));
+
+    [entry release];
+    [attributes release];
+    [dn release];
+}
+
+@end
@@ -0,0 +1,345 @@
+/*
+ * TRLDAPGroupEvaluatorTests.m vi:ts=4:sw=4:expandtab:
+ * TRLDAPGroupEvaluator Unit Tests
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import "PXTestCase.h"
+
+#import "TRLDAPGroupEvaluator.h"
+#import "TRAuthLDAPConfig.h"
+
+#import "mockldap.h"
+#import "tests.h"
+
+/* Base DN of the test groups, and the test user's DN */
+#define GROUP_BASE_DN "ou=Groups,dc=example,dc=com"
+#define USER_DN "uid=test,ou=People,dc=example,dc=com"
+
+/**
+ * Add a group with the given filter, and a single group entry, cn=name,
+ * to groups, and script its search. If member is YES, the test user is
+ * a member of the group.
+ */
+static void add_group_with_filter(TRArray *groups, MockLDAPConnection *conn, const char *filter, const char *name, BOOL member) {
+    TRLDAPGroupConfig *groupConfig;
+    TRLDAPEntry *entry;
+    TRArray *entries;
+    TRString *dn;
+
+    groupConfig = [[TRLDAPGroupConfig alloc] init];
+    [groupConfig setBaseDN: [TRString stringWithCString: GROUP_BASE_DN]];
+    [groupConfig setSearchFilter: [TRString stringWithCString: filter]];
+    [groupConfig setMemberAttribute: [TRString stringWithCString: "uniqueMember"]];
+    [groups addObject: groupConfig];
+
+    dn = [TRString stringWithFormat: "cn=%s,%s", name, GROUP_BASE_DN];
+    entry = [[TRLDAPEntry alloc] initWithDN: dn attributes: nil];
+    entries = [[TRArray alloc] init];
+    [entries addObject: entry];
+    [conn setEntries: entries forSearchWithFilter: [groupConfig searchFilter] baseDN: [groupConfig baseDN]];
+
+    if (member)
+        [conn addMember: [TRString stringWithCString: USER_DN] ofEntry: dn];
+
+    [entries release];
+    [entry release];
+    [groupConfig release];
+}
+
+/** Add a group with the filter (cn=name); see add_group_with_filter(). */
+static void add_group(TRArray *groups, MockLDAPConnection *conn, const char *name, BOOL member) {
+    add_group_with_filter(groups, conn, [[TRString stringWithFormat: "(cn=%s)", name] cString], name, member);
+}
+
+/**
+ * Script the combined search for the given filters, answering with the
+ * group entry cn=name, which includes only its cn attribute.
+ */
+static void set_combined_result(MockLDAPConnection *conn, const char *filters, const char *name) {
+    TRHash *attributes;
+    TRLDAPEntry *entry;
+    TRArray *entries;
+    TRArray *values;
+    TRString *filter;
+    TRString *dn;
+
+    values = [[TRArray alloc] init];
+    [values addObject: [TRString stringWithCString: name]];
+    attributes = [[TRHash alloc] initWithCapacity: 1];
+    [attributes setObject: values forKey: [TRString stringWithCString: "cn"]];
+
+    dn = [TRString stringWithFormat: "cn=%s,%s", name, GROUP_BASE_DN];
+    entry = [[TRLDAPEntry alloc] initWithDN: dn attributes: attributes];
+    entries = [[TRArray alloc] init];
+    [entries addObject: entry];
+
+    filter = [TRString stringWithFormat: "(&(|%s)(uniqueMember=%s))", filters, USER_DN];
+    [conn setEntries: entries forSearchWithFilter: filter baseDN: [TRString stringWithCString: GROUP_BASE_DN]];
+
+    [entries release];
+    [entry release];
+    [attributes release];
+    [values release];
+}
+
+/** Returns the name of a group added with add_group(), or "(none)". */
+static const char *group_name(TRLDAPGroupConfig *groupConfig) {
+    if (!groupConfig)
+        return "(none)";
+    return [[groupConfig searchFilter] cString];
+}
+
+@interface TRLDAPGroupEvaluatorTests : PXTestCase @end
+
+@implementation TRLDAPGroupEvaluatorTests
+
+- (void) test_noGroups {
+    TRAuthLDAPConfig *config;
+    TRLDAPConnection *conn;
+    TRLDAPGroupEvaluator *evaluator;
+    TRLDAPEntry *user;
+    TRString *dn;
+    TRArray *groups;
+
+    config = [[TRAuthLDAPConfig alloc] initWithConfigFile: AUTH_LDAP_CONF];
+    fail_if(config == NULL, "-[[TRAuthLDAPConfig alloc] initWithConfigFile:] returned NULL");
+
+    conn = [[TRLDAPConnection alloc] initWithURL: [config url] timeout: [config timeout]];
+    evaluator = [[TRLDAPGroupEvaluator alloc] initWithConnection: conn];
+
+    dn = [[TRString alloc] initWithCString: "uid=test,ou=People,dc=example,dc=com"];
+    user = [[TRLDAPEntry alloc] initWithDN: dn attributes: nil];
+    groups = [[TRArray alloc] init];
+
+    /* No groups can be decided without any LDAP traffic */
+    fail_unless([evaluator firstMatchingGroup: groups forUser: user] == nil);
+    fail_unless([conn operationCount] == 0, "Expected no LDAP operations, got %lu", [conn operationCount]);
+
+    [groups release];
+    [user release];
+    [dn release];
+    [evaluator release];
+    [conn release];
+    [config release];
+}
+
+- (void) test_firstMatchInConfigurationOrder {
+    MockLDAPConnection *conn = [[MockLDAPConnection alloc] init];
+    TRLDAPGroupEvaluator *evaluator = [[TRLDAPGroupEvaluator alloc] initWithConnection: conn];
+    TRString *dn = [[TRString alloc] initWithCString: USER_DN];
+    TRLDAPEntry *user = [[TRLDAPEntry alloc] initWithDN: dn attributes: nil];
+    TRArray *groups = [[TRArray alloc] init];
+    TRLDAPGroupConfig *result;
+
+    add_group(groups, conn, "a", NO);
+    add_group(groups, conn, "b", YES);
+    add_group(groups, conn, "c", YES);
+
+    /* The later group matches first, but the earlier group wins */
+    [conn setAnswersInReverseOrder: YES];
+
+    result = [evaluator firstMatchingGroup: groups forUser: user];
+    fail_unless(result == [groups objectAtIndex: 1], "Expected (cn=b), got %s", group_name(result));
+
+    [groups release];
+    [user release];
+    [dn release];
+    [evaluator release];
+    [conn release];
+}
+
+- (void) test_abandonLaterRequests {
+    MockLDAPConnection *conn = [[MockLDAPConnection alloc] init];
+    TRLDAPGroupEvaluator *evaluator = [[TRLDAPGroupEvaluator alloc] initWithConnection: conn];
+    TRString *dn = [[TRString alloc] initWithCString: USER_DN];
+    TRLDAPEntry *user = [[TRLDAPEntry alloc] initWithDN: dn attributes: nil];
+    TRArray *groups = [[TRArray alloc] init];
+    TRLDAPGroupConfig *result;
+
+    add_group(groups, conn, "a", YES);
+    add_group(groups, conn, "b", NO);
+    add_group(groups, conn, "c", YES);
+
+    result = [evaluator firstMatchingGroup: groups forUser: user];
+    fail_unless(result == [groups objectAtIndex: 0], "Expected (cn=a), got %s", group_name(result));
+
+    /* Three group searches, and a compare for each group's entry. Once
+     * the first group matched, the compares for the later groups could
+     * not change the result, and were abandoned. */
+    fail_unless([conn sentCount] == 6, "Expected 6 requests, got %u", [conn sentCount]);
+    fail_unless([conn abandonedCount] == 2, "Expected 2 abandoned requests, got %u", [conn abandonedCount]);
+
+    [groups release];
+    [user release];
+    [dn release];
+    [evaluator release];
+    [conn release];
+}
+
+- (void) test_errorStopsEvaluation {
+    MockLDAPConnection *conn = [[MockLDAPConnection alloc] init];
+    TRLDAPGroupEvaluator *evaluator = [[TRLDAPGroupEvaluator alloc] initWithConnection: conn];
+    TRString *dn = [[TRString alloc] initWithCString: USER_DN];
+    TRLDAPEntry *user = [[TRLDAPEntry alloc] initWithDN: dn attributes: nil];
+    TRArray *groups = [[TRArray alloc] init];
+    TRLDAPGroupConfig *result;
+
+    add_group(groups, conn, "a", NO);
+    add_group(groups, conn, "b", NO);
+    add_group(groups, conn, "c", YES);
+    [conn setFailureForSearchWithFilter: [[groups objectAtIndex: 1] searchFilter] baseDN: [[groups objectAtIndex: 1] baseDN]];
+
+    /* The user is a member of a group after the failed group */
+    result = [evaluator firstMatchingGroup: groups forUser: user];
+    fail_unless(result == nil, "Expected no group, got %s", group_name(result));
+
+    /* The later group's search was abandoned, and no compare was sent for it */
+    fail_unless([conn abandonedCount] == 1, "Expected 1 abandoned request, got %u", [conn abandonedCount]);
+    fail_unless([conn sentCount] == 4, "Expected 4 requests, got %u", [conn sentCount]);
+
+    [groups release];
+    [user release];
+    [dn release];
+    [evaluator release];
+    [conn release];
+}
+
+- (void) test_errorAfterMatch {
+    MockLDAPConnection *conn = [[MockLDAPConnection alloc] init];
+    TRLDAPGroupEvaluator *evaluator = [[TRLDAPGroupEvaluator alloc] initWithConnection: conn];
+    TRString *dn = [[TRString alloc] initWithCString: USER_DN];
+    TRLDAPEntry *user = [[TRLDAPEntry alloc] initWithDN: dn attributes: nil];
+    TRArray *groups = [[TRArray alloc] init];
+    TRLDAPGroupConfig *result;
+
+    add_group(groups, conn, "a", YES);
+    add_group(groups, conn, "b", NO);
+    [conn setFailureForSearchWithFilter: [[groups objectAtIndex: 1] searchFilter] baseDN: [[groups objectAtIndex: 1] baseDN]];
+
+    /* A failure after the first matching group does not change the result */
+    result = [evaluator firstMatchingGroup: groups forUser: user];
+    fail_unless(result == [groups objectAtIndex: 0], "Expected (cn=a), got %s", group_name(result));
+
+    [groups release];
+    [user release];
+    [dn release];
+    [evaluator release];
+    [conn release];
+}
+
+- (void) test_combinedSearch {
+    MockLDAPConnection *conn = [[MockLDAPConnection alloc] init];
+    TRLDAPGroupEvaluator *evaluator = [[TRLDAPGroupEvaluator alloc] initWithConnection: conn];
+    TRString *dn = [[TRString alloc] initWithCString: USER_DN];
+    TRLDAPEntry *user = [[TRLDAPEntry alloc] initWithDN: dn attributes: nil];
+    TRArray *groups = [[TRArray alloc] init];
+    TRLDAPGroupConfig *result;
+
+    add_group(groups, conn, "a", NO);
+    add_group(groups, conn, "b", YES);
+    set_combined_result(conn, "(cn=a)(cn=b)", "b");
+
+    result = [evaluator firstMatchingGroup: groups forUser: user];
+    fail_unless(result == [groups objectAtIndex: 1], "Expected (cn=b), got %s", group_name(result));
+
+    result = [evaluator firstMatchingGroupWithCombinedSearch: groups forUser: user];
+    fail_unless(result == [groups objectAtIndex: 1], "Expected (cn=b), got %s", group_name(result));
+
+    [groups release];
+    [user release];
+    [dn release];
+    [evaluator release];
+    [conn release];
+}
+
+- (void) test_combinedSearchEmptyGroup {
+    MockLDAPConnection *conn = [[MockLDAPConnection alloc] init];
+    TRLDAPGroupEvaluator *evaluator = [[TRLDAPGroupEvaluator alloc] initWithConnection: conn];
+    TRString *dn = [[TRString alloc] initWithCString: USER_DN];
+    TRLDAPEntry *user = [[TRLDAPEntry alloc] initWithDN: dn attributes: nil];
+    TRArray *groups = [[TRArray alloc] init];
+    TRArray *empty = [[TRArray alloc] init];
+    TRLDAPGroupConfig *result;
+
+    add_group(groups, conn, "a", NO);
+    add_group(groups, conn, "b", YES);
+    set_combined_result(conn, "(cn=a)(cn=b)", "b");
+
+    /* The first group's search finds nothing */
+    [conn setEntries: empty forSearchWithFilter: [[groups objectAtIndex: 0] searchFilter] baseDN: [[groups objectAtIndex: 0] baseDN]];
+
+    /* Evaluation stops at the empty group, with or without the combined search */
+    result = [evaluator firstMatchingGroup: groups forUser: user];
+    fail_unless(result == nil, "Expected no group, got %s", group_name(result));
+
+    result = [evaluator firstMatchingGroupWithCombinedSearch: groups forUser: user];
+    fail_unless(result == nil, "Expected no group, got %s", group_name(result));
+
+    [empty release];
+    [groups release];
+    [user release];
+    [dn release];
+    [evaluator release];
+    [conn release];
+}
+
+- (void) test_combinedSearchNegatedFilter {
+    MockLDAPConnection *conn = [[MockLDAPConnection alloc] init];
+    TRLDAPGroupEvaluator *evaluator = [[TRLDAPGroupEvaluator alloc] initWithConnection: conn];
+    TRString *dn = [[TRString alloc] initWithCString: USER_DN];
+    TRLDAPEntry *user = [[TRLDAPEntry alloc] initWithDN: dn attributes: nil];
+    TRArray *groups = [[TRArray alloc] init];
+    TRLDAPGroupConfig *result;
+
+    add_group_with_filter(groups, conn, "(!(ou=contractors))", "staff", NO);
+    add_group(groups, conn, "b", YES);
+
+    /* The returned entry does not show its ou, so the negation can not
+     * be evaluated locally, and must not claim it */
+    set_combined_result(conn, "(!(ou=contractors))(cn=b)", "b");
+
+    result = [evaluator firstMatchingGroupWithCombinedSearch: groups forUser: user];
+    fail_unless(result == [groups objectAtIndex: 1], "Expected (cn=b), got %s", group_name(result));
+
+    result = [evaluator firstMatchingGroup: groups forUser: user];
+    fail_unless(result == [groups objectAtIndex: 1], "Expected (cn=b), got %s", group_name(result));
+
+    [groups release];
+    [user release];
+    [dn release];
+    [evaluator release];
+    [conn release];
+}
+
+@end
@@ -0,0 +1,79 @@
+/*
+ * TRLDAPGroupSnapshotTests.m vi:ts=4:sw=4:expandtab:
+ * TRLDAPGroupSnapshot Unit Tests
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import "PXTestCase.h"
+
+#import "TRLDAPGroupSnapshot.h"
+#import "TRAuthLDAPConfig.h"
+
+#import "tests.h"
+
+@interface TRLDAPGroupSnapshotTests : PXTestCase @end
+
+@implementation TRLDAPGroupSnapshotTests
+
+- (void) test_notLoaded {
+    TRAuthLDAPConfig *config;
+    TRLDAPConnectionPool *pool;
+    TRLDAPGroupSnapshot *snapshot;
+    TRLDAPGroupConfig *group = nil;
+    TRLDAPEntry *user;
+    TRString *dn;
+
+    config = [[TRAuthLDAPConfig alloc] initWithConfigFile: AUTH_LDAP_CONF];
+    fail_if(config == NULL, "-[[TRAuthLDAPConfig alloc] initWithConfigFile:] returned NULL");
+
+    pool = [[TRLDAPConnectionPool alloc] initWithConfig: config maxIdleConnections: 1];
+    snapshot = [[TRLDAPGroupSnapshot alloc] initWithConnectionPool: pool
+        groups: [config ldapGroups]
+        refreshInterval: [config groupSnapshotRefresh]];
+
+    dn = [[TRString alloc] initWithCString: "uid=test,ou=People,dc=example,dc=com"];
+    user = [[TRLDAPEntry alloc] initWithDN: dn attributes: nil];
+
+    /* Until the first refresh completes, membership must be checked against the directory */
+    fail_if([snapshot isLoaded]);
+    fail_if([snapshot findGroupForUser: user group: &group], "-[TRLDAPGroupSnapshot findGroupForUser:group:] returned YES with no snapshot loaded");
+    fail_unless(group == nil);
+
+    [user release];
+    [dn release];
+    [snapshot release];
+    [pool release];
+    [config release];
+}
+
+@end
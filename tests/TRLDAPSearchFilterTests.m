@@ -63,9 +63,21 @@
     [filter release];
 }
 
+- (void) test_getFilterWithSpecifier {
+    TRLDAPSearchFilter *filter = [[TRLDAPSearchFilter alloc] initWithFormat: [TRString stringWithCString: "%u(&(uid=%u)(mail=%u@example.com))%s"] specifier: "%u"];
+    const char *expected = "fred(&(uid=fred)(mail=fred@example.com))%s";
+    TRString *result = [filter getFilterWithCString: "fred"];
+
+    fail_unless(strcmp([result cString], expected) == 0,
+        "-[TRLDAPSearchFilter getFilterWithCString:] returned incorrect string. (Expected %s, got %s)", expected, [result cString]);
+    fail_unless([result length] == strlen(expected) + 1);
+
+    [filter release];
+}
+
 - (void) test_ldapEscaping {
     TRLDAPSearchFilter *filter = [[TRLDAPSearchFilter alloc] initWithFormat: [TRString stringWithCString: "(%s)"]];
-    const char *expected = "(\\(foo\\*\\)\\\\)";
+    const char *expected = "(\\28foo\\2a\\29\\5c)";
     
     /* Pass in something containing all the special characters */
     TRString *result = [filter getFilter: [TRString stringWithCString: "(foo*)\\"]];
@@ -76,4 +88,20 @@
     [filter release];
 }
 
+- (void) test_escape {
+    const char value[] = "a\0b*";
+    const char *expected = "a\\00b\\2a";
+    char buffer[sizeof(value) * 3];
+    size_t length;
+
+    /* Embedded NULs are escaped when the length is given */
+    length = [TRLDAPSearchFilter escapedLength: value length: sizeof(value) - 1];
+    fail_unless(length == strlen(expected));
+    fail_unless([TRLDAPSearchFilter escape: value length: sizeof(value) - 1 buffer: buffer] == length);
+    fail_unless(memcmp(buffer, expected, length) == 0);
+
+    /* Values without special characters are copied unchanged */
+    fail_unless(strcmp([[TRLDAPSearchFilter escapeString: [TRString stringWithCString: "fred"]] cString], "fred") == 0);
+}
+
 @end
\ No newline at end of file
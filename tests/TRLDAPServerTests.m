@@ -0,0 +1,161 @@
+/*
+ * TRLDAPServerTests.m vi:ts=4:sw=4:expandtab:
+ * TRLDAPServer Unit Tests
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import "PXTestCase.h"
+
+#import "TRLDAPServer.h"
+
+@interface TRLDAPServerTests : PXTestCase @end
+
+@implementation TRLDAPServerTests
+
+- (void) test_load {
+    TRString *url = [[TRString alloc] initWithCString: "ldap://ldap1.example.org"];
+    TRLDAPServer *fast = [[TRLDAPServer alloc] initWithURL: url];
+    TRLDAPServer *slow = [[TRLDAPServer alloc] initWithURL: url];
+
+    /* Without latency samples, load is the number of outstanding requests */
+    fail_unless([fast load] == [slow load]);
+    [slow acquire];
+    fail_unless([slow outstanding] == 1);
+    fail_unless([fast load] < [slow load]);
+    [slow relinquish];
+    fail_unless([slow outstanding] == 0);
+
+    /* Latency weights the load */
+    [fast recordSuccessWithLatency: 5];
+    [slow recordSuccessWithLatency: 50];
+    fail_unless([fast latency] == 5);
+    [fast acquire];
+    fail_unless([fast load] < [slow load]);
+    [fast relinquish];
+
+    [slow release];
+    [fast release];
+    [url release];
+}
+
+- (void) test_ejection {
+    TRString *url = [[TRString alloc] initWithCString: "ldap://ldap1.example.org"];
+    TRLDAPServer *server = [[TRLDAPServer alloc] initWithURL: url];
+    int i;
+
+    fail_unless([server isAvailable]);
+    fail_unless([server admitRequest]);
+
+    /* Isolated failures, eg, a connection reset while idle, are tolerated */
+    for (i = 1; i < TRLDAPSERVER_EJECTION_THRESHOLD; i++)
+        [server recordFailure];
+    fail_unless([server isAvailable], "-[TRLDAPServer recordFailure] ejected the server below the failure threshold");
+
+    /* A success resets the count */
+    [server recordSuccessWithLatency: 10];
+    [server recordFailure];
+    fail_unless([server isAvailable]);
+
+    for (i = 1; i < TRLDAPSERVER_EJECTION_THRESHOLD; i++)
+        [server recordFailure];
+    fail_if([server isAvailable], "-[TRLDAPServer recordFailure] did not eject the server");
+    fail_if([server admitRequest], "-[TRLDAPServer admitRequest] admitted a request to an ejected server");
+    fail_unless([server ejectedUntil] > 0);
+
+    /* A successful request reinstates the server */
+    [server recordSuccessWithLatency: 10];
+    fail_unless([server isAvailable]);
+    fail_unless([server ejectedUntil] == 0);
+
+    [server release];
+    [url release];
+}
+
+- (void) test_probeFailure {
+    TRString *url = [[TRString alloc] initWithCString: "ldap://ldap1.example.org"];
+    TRLDAPServer *server = [[TRLDAPServer alloc] initWithURL: url];
+    time_t until;
+    int i;
+
+    for (i = 0; i < TRLDAPSERVER_EJECTION_THRESHOLD; i++)
+        [server recordFailure];
+    until = [server ejectedUntil];
+    fail_unless(until > 0);
+
+    /* Until reinstated, any further failure ejects the server again, for longer */
+    [server recordFailure];
+    fail_unless([server ejectedUntil] > until);
+
+    [server release];
+    [url release];
+}
+
+- (void) test_recordTLSHandshake {
+    TRString *url = [[TRString alloc] initWithCString: "ldaps://ldap1.example.org"];
+    TRLDAPServer *server = [[TRLDAPServer alloc] initWithURL: url];
+
+    fail_unless([server copyTLSSession] == NULL);
+
+    [server recordTLSHandshake: NO];
+    [server recordTLSHandshake: YES];
+    [server recordTLSHandshake: YES];
+    fail_unless([server tlsHandshakes] == 3);
+    fail_unless([server tlsResumptions] == 2);
+
+    [server release];
+    [url release];
+}
+
+- (void) test_responseTimePercentile {
+    TRString *url = [[TRString alloc] initWithCString: "ldap://ldap1.example.org"];
+    TRLDAPServer *server = [[TRLDAPServer alloc] initWithURL: url];
+    int i;
+
+    fail_unless([server responseTimePercentile: 95] == 0);
+
+    for (i = 100; i > 0; i--)
+        [server addResponseTime: i];
+    fail_unless([server responseTimePercentile: 0] == 1);
+    fail_unless([server responseTimePercentile: 95] == 95, "-[TRLDAPServer responseTimePercentile:] returned %f", [server responseTimePercentile: 95]);
+    fail_unless([server responseTimePercentile: 100] == 100);
+
+    /* Only the most recent samples are retained */
+    for (i = 0; i < TRLDAPSERVER_RESPONSE_SAMPLES; i++)
+        [server addResponseTime: 1000];
+    fail_unless([server responseTimePercentile: 0] == 1000);
+
+    [server release];
+    [url release];
+}
+
+@end
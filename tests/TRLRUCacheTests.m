@@ -0,0 +1,130 @@
+/*
+ * TRLRUCacheTests.m vi:ts=4:sw=4:expandtab:
+ * TRLRUCache Unit Tests
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import "PXTestCase.h"
+
+#import "TRLRUCache.h"
+
+#import <string.h>
+
+/* Match objects equal to the C string context */
+static BOOL matches_cstring (id object, void *context) {
+    return (strcmp([(TRString *) object cString], context) == 0);
+}
+
+@interface TRLRUCacheTests : PXTestCase @end
+
+@implementation TRLRUCacheTests
+
+- (void) test_setObject {
+    TRLRUCache *cache = [[TRLRUCache alloc] initWithCapacity: 2 ttl: 60];
+    TRString *key = [[TRString alloc] initWithCString: "key"];
+    TRString *value = [[TRString alloc] initWithCString: "value"];
+
+    fail_unless([cache objectForKey: key] == nil);
+
+    [cache setObject: value forKey: key];
+    fail_unless([cache objectForKey: key] == value);
+    fail_unless([cache count] == 1);
+
+    [cache removeObjectForKey: key];
+    fail_unless([cache objectForKey: key] == nil);
+    fail_unless([cache count] == 0);
+
+    [key release];
+    [value release];
+    [cache release];
+}
+
+- (void) test_evictLeastRecentlyUsed {
+    TRLRUCache *cache = [[TRLRUCache alloc] initWithCapacity: 2 ttl: 60];
+    TRString *first = [[TRString alloc] initWithCString: "first"];
+    TRString *second = [[TRString alloc] initWithCString: "second"];
+    TRString *third = [[TRString alloc] initWithCString: "third"];
+
+    [cache setObject: first forKey: first];
+    [cache setObject: second forKey: second];
+
+    /* Touch the first entry, leaving the second least recently used */
+    fail_unless([cache objectForKey: first] == first);
+
+    [cache setObject: third forKey: third];
+    fail_unless([cache count] == 2);
+    fail_unless([cache objectForKey: first] == first);
+    fail_unless([cache objectForKey: second] == nil);
+    fail_unless([cache objectForKey: third] == third);
+
+    [cache removeAllObjects];
+    fail_unless([cache count] == 0);
+
+    [first release];
+    [second release];
+    [third release];
+    [cache release];
+}
+
+- (void) test_removeObjectsMatching {
+    TRLRUCache *cache = [[TRLRUCache alloc] initWithCapacity: 4 ttl: 60];
+    TRString *first = [[TRString alloc] initWithCString: "first"];
+    TRString *second = [[TRString alloc] initWithCString: "second"];
+
+    [cache setObject: first forKey: first];
+    [cache setObject: second forKey: second];
+
+    [cache removeObjectsMatching: matches_cstring context: "second"];
+    fail_unless([cache count] == 1);
+    fail_unless([cache objectForKey: first] == first);
+    fail_unless([cache objectForKey: second] == nil);
+
+    [first release];
+    [second release];
+    [cache release];
+}
+
+- (void) test_expire {
+    TRLRUCache *cache = [[TRLRUCache alloc] initWithCapacity: 2 ttl: 0];
+    TRString *key = [[TRString alloc] initWithCString: "key"];
+
+    /* With a zero TTL, entries expire immediately */
+    [cache setObject: key forKey: key];
+    fail_unless([cache objectForKey: key] == nil);
+    fail_unless([cache count] == 0);
+
+    [key release];
+    [cache release];
+}
+
+@end
@@ -0,0 +1,151 @@
+/*
+ * TRNegativeCacheTests.m vi:ts=4:sw=4:expandtab:
+ * TRNegativeCache Unit Tests
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import "PXTestCase.h"
+
+#import "TRNegativeCache.h"
+
+@interface TRNegativeCacheTests : PXTestCase @end
+
+@implementation TRNegativeCacheTests
+
+- (void) test_addUnknownUser {
+    TRNegativeCache *cache = [[TRNegativeCache alloc] initWithCapacity: 4 ttl: 60 maxFailures: 3];
+    TRString *username = [[TRString alloc] initWithCString: "nobody"];
+
+    fail_if([cache rejectsUser: username]);
+
+    [cache addUnknownUser: username];
+    fail_unless([cache rejectsUser: username]);
+
+    [cache removeUser: username];
+    fail_if([cache rejectsUser: username]);
+
+    [username release];
+    [cache release];
+}
+
+- (void) test_addFailureForUser {
+    TRNegativeCache *cache = [[TRNegativeCache alloc] initWithCapacity: 4 ttl: 60 maxFailures: 3];
+    TRString *username = [[TRString alloc] initWithCString: "user"];
+
+    [cache addFailureForUser: username];
+    [cache addFailureForUser: username];
+    fail_if([cache rejectsUser: username], "-[TRNegativeCache rejectsUser:] rejected a user below the failure limit");
+
+    [cache addFailureForUser: username];
+    fail_unless([cache rejectsUser: username]);
+
+    [username release];
+    [cache release];
+}
+
+- (void) test_lockoutAndUnknownUser {
+    TRNegativeCache *cache = [[TRNegativeCache alloc] initWithCapacity: 4 ttl: 60 maxFailures: 1];
+    TRString *unknown = [[TRString alloc] initWithCString: "nobody"];
+    TRString *failed = [[TRString alloc] initWithCString: "user"];
+
+    [cache addUnknownUser: unknown];
+    [cache addFailureForUser: failed];
+
+    fail_unless([cache isUnknownUser: unknown]);
+    fail_if([cache isLockedOut: unknown]);
+
+    fail_unless([cache isLockedOut: failed]);
+    fail_if([cache isUnknownUser: failed]);
+
+    [unknown release];
+    [failed release];
+    [cache release];
+}
+
+- (void) test_caseInsensitive {
+    TRNegativeCache *cache = [[TRNegativeCache alloc] initWithCapacity: 4 ttl: 60 maxFailures: 2];
+    TRString *lower = [[TRString alloc] initWithCString: "alice"];
+    TRString *mixed = [[TRString alloc] initWithCString: "Alice"];
+
+    /* Failures under either spelling count against the same user */
+    [cache addFailureForUser: lower];
+    [cache addFailureForUser: mixed];
+    fail_unless([cache isLockedOut: lower]);
+    fail_unless([cache isLockedOut: mixed]);
+
+    [cache removeUser: mixed];
+    fail_if([cache rejectsUser: lower]);
+
+    [lower release];
+    [mixed release];
+    [cache release];
+}
+
+- (void) test_unknownUsersDoNotEvictFailures {
+    TRNegativeCache *cache = [[TRNegativeCache alloc] initWithCapacity: 4 ttl: 60 maxFailures: 2];
+    TRString *failed = [[TRString alloc] initWithCString: "user"];
+    int i;
+
+    [cache addFailureForUser: failed];
+
+    /* Fill the cache with nonexistent usernames */
+    for (i = 0; i < 8; i++)
+        [cache addUnknownUser: [TRString stringWithFormat: "nobody%d", i]];
+
+    /* The first failure still counts */
+    [cache addFailureForUser: failed];
+    fail_unless([cache isLockedOut: failed]);
+
+    [failed release];
+    [cache release];
+}
+
+- (void) test_removeUnknownUsers {
+    TRNegativeCache *cache = [[TRNegativeCache alloc] initWithCapacity: 4 ttl: 60 maxFailures: 1];
+    TRString *unknown = [[TRString alloc] initWithCString: "nobody"];
+    TRString *failed = [[TRString alloc] initWithCString: "user"];
+
+    [cache addUnknownUser: unknown];
+    [cache addFailureForUser: failed];
+
+    /* Failed binds are kept */
+    [cache removeUnknownUsers];
+    fail_if([cache rejectsUser: unknown]);
+    fail_unless([cache rejectsUser: failed]);
+
+    [unknown release];
+    [failed release];
+    [cache release];
+}
+
+@end
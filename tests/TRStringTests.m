@@ -40,6 +40,7 @@
 
 #import "TRString.h"
 #import "TRAutoreleasePool.h"
+#import "xmalloc.h"
 
 #import <string.h>
 #import <limits.h>
@@ -99,6 +100,18 @@
     [str release];
 }
 
+- (void) test_initWithBytesNoCopy {
+    TRString *str;
+    char *data;
+
+    data = xstrdup(TEST_STRING);
+    str = [[TRString alloc] initWithBytesNoCopy: data numBytes: sizeof(TEST_STRING) - 1];
+    fail_unless([str cString] == data);
+    fail_unless([str length] == sizeof(TEST_STRING));
+
+    [str release];
+}
+
 
 - (void) test_stringWithFormat {
     TRAutoreleasePool *pool = [[TRAutoreleasePool alloc] init];
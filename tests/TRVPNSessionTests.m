@@ -57,4 +57,69 @@
     [session release];
 }
 
+- (void) test_setUsername {
+    TRVPNSession *session;
+    TRString *username = [[TRString alloc] initWithCString: "user"];
+
+    /* Sessions created by the plugin start out without a user */
+    session = [[TRVPNSession alloc] init];
+    fail_unless([session username] == nil);
+
+    [session setUsername: username];
+    fail_unless([session username] == username);
+
+    [username release];
+    [session release];
+}
+
+- (void) test_authenticatedState {
+    TRVPNSession *session;
+    TRLDAPGroupConfig *groupConfig = [[TRLDAPGroupConfig alloc] init];
+    TRString *dn = [[TRString alloc] initWithCString: "uid=user,ou=People,dc=example,dc=com"];
+    TRString *table = [[TRString alloc] initWithCString: "ips_vpn_users"];
+
+    session = [[TRVPNSession alloc] init];
+    fail_if([session isAuthenticated]);
+
+    [session setDN: dn];
+    [session setGroupConfig: groupConfig];
+    [session setPFTable: table];
+    [session setAuthenticated: YES];
+
+    fail_unless([session isAuthenticated]);
+    fail_unless([session dn] == dn);
+    fail_unless([session groupConfig] == groupConfig);
+    fail_unless([session pfTable] == table);
+
+    [dn release];
+    [table release];
+    [groupConfig release];
+    [session release];
+}
+
+- (void) test_installedPFTable {
+    TRVPNSession *session;
+    TRString *table = [[TRString alloc] initWithCString: "ips_vpn_users"];
+    TRString *newTable = [[TRString alloc] initWithCString: "ips_vpn_admins"];
+
+    session = [[TRVPNSession alloc] init];
+    fail_unless([session installedPFTable] == nil);
+
+    [session setPFTable: table];
+    [session setInstalledPFTable: table];
+
+    /* Re-authentication into another group does not move the client */
+    [session setAuthenticated: NO];
+    [session setPFTable: newTable];
+    fail_unless([session installedPFTable] == table);
+    fail_unless([session pfTable] == newTable);
+
+    [session setInstalledPFTable: nil];
+    fail_unless([session installedPFTable] == nil);
+
+    [table release];
+    [newTable release];
+    [session release];
+}
+
 @end
\ No newline at end of file
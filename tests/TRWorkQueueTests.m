@@ -0,0 +1,125 @@
+/*
+ * TRWorkQueueTests.m vi:ts=4:sw=4:expandtab:
+ * TRWorkQueue Unit Tests
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import <pthread.h>
+
+#import "PXTestCase.h"
+
+#import "TRWorkQueue.h"
+
+/* Number of jobs run by test_addJob */
+#define TEST_JOB_COUNT 32
+
+/**
+ * Test job; counts the number of times it has been run.
+ */
+@interface TRWorkQueueTestJob : TRObject <TRWorkQueueJob> {
+@public
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int runCount;
+}
+@end
+
+@implementation TRWorkQueueTestJob
+
+- (id) init {
+    self = [super init];
+    if (!self)
+        return nil;
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+    runCount = 0;
+
+    return self;
+}
+
+- (void) dealloc {
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&lock);
+    [super dealloc];
+}
+
+- (void) run {
+    pthread_mutex_lock(&lock);
+    runCount++;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+@end
+
+@interface TRWorkQueueTests : PXTestCase @end
+
+@implementation TRWorkQueueTests
+
+- (void) test_addJob {
+    TRWorkQueue *queue = [[TRWorkQueue alloc] initWithThreads: 4 maxQueued: TEST_JOB_COUNT];
+    TRWorkQueueTestJob *job = [[TRWorkQueueTestJob alloc] init];
+    int i;
+
+    fail_if(queue == nil, "-[[TRWorkQueue alloc] initWithThreads:maxQueued:] returned nil");
+
+    for (i = 0; i < TEST_JOB_COUNT; i++)
+        fail_unless([queue addJob: job], "-[TRWorkQueue addJob:] rejected a job with space available");
+
+    /* Wait for all jobs to run */
+    pthread_mutex_lock(&job->lock);
+    while (job->runCount < TEST_JOB_COUNT)
+        pthread_cond_wait(&job->cond, &job->lock);
+    pthread_mutex_unlock(&job->lock);
+
+    [queue release];
+
+    /* The queue must have released every reference it held */
+    fail_unless([job retainCount] == 1);
+    [job release];
+}
+
+- (void) test_shutdown {
+    TRWorkQueue *queue = [[TRWorkQueue alloc] initWithThreads: 1 maxQueued: 1];
+    TRWorkQueueTestJob *job = [[TRWorkQueueTestJob alloc] init];
+
+    [queue shutdown];
+    fail_if([queue addJob: job], "-[TRWorkQueue addJob:] accepted a job after shutdown");
+    fail_unless([queue pendingCount] == 0);
+
+    [queue release];
+    [job release];
+}
+
+@end
@@ -0,0 +1,73 @@
+/*
+ * mockldap.h vi:ts=4:sw=4:expandtab:
+ * Scripted TRLDAPConnection for testing LDAP clients without a server
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "TRLDAPConnection.h"
+#import "TRArray.h"
+#import "TRHash.h"
+
+/**
+ * A TRLDAPConnection that answers searches and compares from scripted
+ * results, rather than sending them to a server. Unscripted searches
+ * succeed, and return no entries; unscripted compares are false.
+ *
+ * Asynchronous requests are answered, one per -receiveResult:, in the
+ * order they were sent, or in reverse order if requested.
+ */
+@interface MockLDAPConnection : TRLDAPConnection {
+@private
+    /* Scripted results, keyed by base DN and filter */
+    TRHash *_results;
+    TRHash *_failures;
+
+    /* Scripted compares, keyed by DN and value */
+    TRHash *_members;
+
+    /* Asynchronous requests, in the order sent */
+    TRArray *_requests;
+    int _nextMsgid;
+    BOOL _reverseOrder;
+    BOOL _unresponsive;
+    unsigned int _abandonedCount;
+}
+
+- (id) init;
+
+- (void) setEntries: (TRArray *) entries forSearchWithFilter: (TRString *) filter baseDN: (TRString *) base;
+- (void) setFailureForSearchWithFilter: (TRString *) filter baseDN: (TRString *) base;
+- (void) addMember: (TRString *) value ofEntry: (TRString *) dn;
+- (void) setAnswersInReverseOrder: (BOOL) reverse;
+- (void) setUnresponsive: (BOOL) unresponsive;
+
+- (unsigned int) sentCount;
+- (unsigned int) abandonedCount;
+
+@end
@@ -0,0 +1,279 @@
+/*
+ * mockldap.m vi:ts=4:sw=4:expandtab:
+ * Scripted TRLDAPConnection for testing LDAP clients without a server
+ *
+ * Copyright (c) 2007 Three Rings Design, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#import <config.h>
+#endif
+
+#import <unistd.h>
+
+#import "mockldap.h"
+
+/* Maximum number of scripted results */
+#define MOCKLDAP_MAX_RESULTS 64
+
+/* Returns the key identifying a search's scripted result */
+static TRString *search_key (TRString *filter, TRString *base) {
+    return [TRString stringWithFormat: "%s\n%s", [base cString], [filter cString]];
+}
+
+/* Returns the key identifying a compare's scripted result */
+static TRString *compare_key (TRString *dn, TRString *value) {
+    return [TRString stringWithFormat: "%s\n%s", [dn cString], [value cString]];
+}
+
+/**
+ * An asynchronous request, and its scripted result. The request itself
+ * stands in for the LDAPMessage handed back by -receiveResult:.
+ */
+@interface MockLDAPRequest : TRObject {
+@public
+    int _msgid;
+    BOOL _outstanding;
+    BOOL _failed;
+    BOOL _compareTrue;
+    TRArray *_entries;
+}
+@end
+
+@implementation MockLDAPRequest
+
+- (void) dealloc {
+    [_entries release];
+    [super dealloc];
+}
+
+@end
+
+@implementation MockLDAPConnection
+
+- (id) init {
+    self = [super initWithURL: [TRString stringWithCString: "ldap://mock.example.org"] timeout: 15];
+    if (!self)
+        return nil;
+
+    _results = [[TRHash alloc] initWithCapacity: MOCKLDAP_MAX_RESULTS];
+    _failures = [[TRHash alloc] initWithCapacity: MOCKLDAP_MAX_RESULTS];
+    _members = [[TRHash alloc] initWithCapacity: MOCKLDAP_MAX_RESULTS];
+    _requests = [[TRArray alloc] init];
+    _nextMsgid = 1;
+
+    return self;
+}
+
+- (void) dealloc {
+    [_results release];
+    [_failures release];
+    [_members release];
+    [_requests release];
+    [super dealloc];
+}
+
+/**
+ * Answer searches with the given filter and base DN with entries.
+ */
+- (void) setEntries: (TRArray *) entries forSearchWithFilter: (TRString *) filter baseDN: (TRString *) base {
+    [_results setObject: entries forKey: search_key(filter, base)];
+}
+
+/**
+ * Fail searches with the given filter and base DN.
+ */
+- (void) setFailureForSearchWithFilter: (TRString *) filter baseDN: (TRString *) base {
+    [_failures setObject: filter forKey: search_key(filter, base)];
+}
+
+/**
+ * Answer compares of the entry with the given DN against value with true.
+ */
+- (void) addMember: (TRString *) value ofEntry: (TRString *) dn {
+    [_members setObject: value forKey: compare_key(dn, value)];
+}
+
+/**
+ * Answer the most recently sent request first.
+ */
+- (void) setAnswersInReverseOrder: (BOOL) reverse {
+    _reverseOrder = reverse;
+}
+
+/**
+ * Never answer asynchronous requests; -pollResult:waitMilliseconds: waits
+ * out its timeout, as it would for a hung server.
+ */
+- (void) setUnresponsive: (BOOL) unresponsive {
+    _unresponsive = unresponsive;
+}
+
+/** Returns the number of asynchronous requests sent. */
+- (unsigned int) sentCount {
+    return [_requests count];
+}
+
+/** Returns the number of asynchronous requests abandoned. */
+- (unsigned int) abandonedCount {
+    return _abandonedCount;
+}
+
+- (TRArray *)
+    searchWithFilter: (TRString *) filter
+    scope: (int) scope
+    baseDN: (TRString *) base
+    attributes: (TRArray *) attributes
+    sizeLimit: (int) sizeLimit
+    timeLimit: (int) timeLimit
+    succeeded: (BOOL *) succeeded
+{
+    TRString *key = search_key(filter, base);
+    TRArray *entries;
+
+    if (succeeded)
+        *succeeded = NO;
+
+    if ([_failures valueForKey: key])
+        return nil;
+
+    if (succeeded)
+        *succeeded = YES;
+
+    /* As with a server, no entries is reported as nil */
+    entries = [_results valueForKey: key];
+    if ([entries count] == 0)
+        return nil;
+
+    return entries;
+}
+
+- (BOOL) compareDN: (TRString *) dn withAttribute: (TRString *) attribute value: (TRString *) value {
+    return ([_members valueForKey: compare_key(dn, value)] != nil);
+}
+
+- (int)
+    sendSearchWithFilter: (TRString *) filter
+    scope: (int) scope
+    baseDN: (TRString *) base
+    attributes: (TRArray *) attributes
+    sizeLimit: (int) sizeLimit
+    timeLimit: (int) timeLimit
+{
+    MockLDAPRequest *request;
+    TRString *key = search_key(filter, base);
+
+    request = [[MockLDAPRequest alloc] init];
+    request->_msgid = _nextMsgid++;
+    request->_outstanding = YES;
+    request->_failed = ([_failures valueForKey: key] != nil);
+    request->_entries = [[_results valueForKey: key] retain];
+    [_requests addObject: request];
+    [request release];
+
+    return request->_msgid;
+}
+
+- (int) sendCompareDN: (TRString *) dn withAttribute: (TRString *) attribute value: (TRString *) value {
+    MockLDAPRequest *request;
+
+    request = [[MockLDAPRequest alloc] init];
+    request->_msgid = _nextMsgid++;
+    request->_outstanding = YES;
+    request->_compareTrue = ([_members valueForKey: compare_key(dn, value)] != nil);
+    [_requests addObject: request];
+    [request release];
+
+    return request->_msgid;
+}
+
+- (LDAPMessage *) receiveResult: (int *) msgid {
+    MockLDAPRequest *request;
+    unsigned int count = [_requests count];
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        request = [_requests objectAtIndex: _reverseOrder ? count - i - 1 : i];
+        if (request->_outstanding) {
+            request->_outstanding = NO;
+            *msgid = request->_msgid;
+            return (LDAPMessage *) request;
+        }
+    }
+
+    /* Nothing outstanding; a server would time out */
+    return NULL;
+}
+
+- (int) pollResult: (LDAPMessage **) result waitMilliseconds: (int) milliseconds {
+    int msgid;
+
+    if (!_unresponsive && (*result = [self receiveResult: &msgid]) != NULL)
+        return 1;
+
+    usleep(milliseconds * 1000);
+    return 0;
+}
+
+/* No socket; the pool must poll for results */
+- (int) descriptor {
+    return -1;
+}
+
+- (TRArray *) entriesFromSearchResult: (LDAPMessage *) result succeeded: (BOOL *) succeeded {
+    MockLDAPRequest *request = (MockLDAPRequest *) result;
+
+    if (succeeded)
+        *succeeded = !request->_failed;
+
+    if (request->_failed || [request->_entries count] == 0)
+        return nil;
+
+    return request->_entries;
+}
+
+- (BOOL) compareResult: (LDAPMessage *) result {
+    MockLDAPRequest *request = (MockLDAPRequest *) result;
+
+    return request->_compareTrue;
+}
+
+- (void) abandon: (int) msgid {
+    MockLDAPRequest *request;
+    unsigned int i;
+
+    for (i = 0; i < [_requests count]; i++) {
+        request = [_requests objectAtIndex: i];
+        if (request->_msgid == msgid && request->_outstanding) {
+            request->_outstanding = NO;
+            _abandonedCount++;
+        }
+    }
+}
+
+@end